@@ -1,7 +1,13 @@
-from typing import List, Tuple
+from typing import List, Optional, Sequence, Tuple
 import math
+import random
 
-def k_means_clusters(k: int, iterations: int, EPS: float, dim: int, points: List[Tuple[float, ...]]) -> List[List[Tuple[int ,Tuple[float, ...]]]]:
+INIT_METHODS = ("first", "kmeans++", "kmeans||")
+KPAR_ROUNDS = 5 # k-means|| sampling rounds
+KPAR_OVERSAMPLE = 2.0 # k-means|| expected picks per round, times k
+RECLUSTER_ITERS = 100 # max weighted Lloyd iterations when reducing the k-means|| candidates to k
+
+def k_means_clusters(k: int, iterations: int, EPS: float, dim: int, points: List[Tuple[float, ...]], init: str = "first", seed: int = 0) -> List[List[Tuple[int ,Tuple[float, ...]]]]:
     """Run the K-means algorithm.
 
     Args:
@@ -9,6 +15,8 @@ def k_means_clusters(k: int, iterations: int, EPS: float, dim: int, points: List
         iterations (int): Maximum iterations (default 400 if not provided by caller).
         dim (int): Point dimensionality.
         points (list[tuple[float, ...], ...]): Points as a list of length-n tuples, each of length `dim`.
+        init (str, optional): Seeding - "first" (the first k points, default), "kmeans++" or "kmeans||".
+        seed (int, optional): Seed of the k-means++ / k-means|| draws (same seed, same clusters). Defaults to 0.
 
     Returns:
         clusters (List[List[Tuple[int ,Tuple[float, ...]]]]): Clusters as a list of length-k lists, containing points as tuples of (point_idx, tuple of point coordinates)
@@ -17,7 +25,11 @@ def k_means_clusters(k: int, iterations: int, EPS: float, dim: int, points: List
         ValueError: If inputs are invalid."""
     
     # Step 1: initialize centroids
-    centroids = [list(points[i]) for i in range(k)]
+    if init not in INIT_METHODS: raise ValueError("An Error Has Occurred")
+    rng = random.Random(seed)
+    if init == "kmeans++": centroids = kmeans_pp_seeds(points, k, dim, rng)
+    elif init == "kmeans||": centroids = kmeans_par_seeds(points, k, dim, rng)
+    else: centroids = [list(points[i]) for i in range(k)]
  
     # Step 2: Repeat algorithm until convergence or until reaching the max iterations.
     for i in range(iterations):
@@ -88,4 +100,111 @@ def calculate_cluster_centroid(cluster: List[List[float]], dim: int, last_centro
         total = 0
         for point in cluster: total += point[coordinate]
         centroid.append((1/len(cluster)) * total)
-    return centroid
\ No newline at end of file
+    return centroid
+
+def kmeans_pp_seeds(points: Sequence[Sequence[float]], k: int, dim: int, rng: random.Random, weights: Optional[List[float]] = None) -> List[List[float]]:
+    """Pick k seeds by (weighted) k-means++.
+
+    The first seed is drawn with probability proportional to its weight, each next one proportional to
+    weight * squared distance to the nearest seed drawn so far.
+
+    Args:
+        points (Sequence[Sequence[float]]): Candidate points (k <= len(points)).
+        k (int): Number of seeds.
+        dim (int): Dimensionality of the points.
+        rng (random.Random): Source of the draws.
+        weights (list[float] | None): Weight per point, or None for all 1.
+
+    Returns:
+        list[list[float]]: The k seeds.
+    """
+    m = len(points)
+    w = weights if weights is not None else [1.0] * m
+    d2 = [1.0] * m # first draw: by weight alone
+    seeds = []
+
+    for _ in range(k):
+        scores = [w[i] * d2[i] for i in range(m)]
+        total = sum(scores)
+        pick = rng.randrange(m)
+        if total > 0: # all zero -> every point is a seed already, take any
+            target, run = rng.random() * total, 0.0
+            for i in range(m):
+                if scores[i] <= 0: continue
+                pick = i # last positive point, in case rounding leaves target past the end
+                run += scores[i]
+                if run > target: break
+        seeds.append(list(points[pick]))
+
+        for i in range(m): # distances to the nearest seed so far
+            dist = sum((points[i][j] - seeds[-1][j]) ** 2 for j in range(dim))
+            if len(seeds) == 1 or dist < d2[i]: d2[i] = dist
+    return seeds
+
+def kmeans_par_seeds(points: List[Tuple[float, ...]], k: int, dim: int, rng: random.Random) -> List[List[float]]:
+    """Pick k seeds by k-means|| (Bahmani et al.).
+
+    Starts from one uniform point, then for KPAR_ROUNDS rounds keeps every point independently with probability
+    KPAR_OVERSAMPLE * k * d2(x) / phi (phi = total squared distance to the candidates). The candidates are weighted
+    by how many points they are nearest to and reduced to k by weighted k-means++ and weighted Lloyd.
+
+    Args:
+        points (list[tuple[float, ...]]): Input points.
+        k (int): Number of seeds.
+        dim (int): Dimensionality of the points.
+        rng (random.Random): Source of the draws.
+
+    Returns:
+        list[list[float]]: The k seeds.
+    """
+    n = len(points)
+    cand = [rng.randrange(n)]
+    d2 = [sum((points[i][j] - points[cand[0]][j]) ** 2 for j in range(dim)) for i in range(n)]
+    closest = [0] * n
+
+    for _ in range(KPAR_ROUNDS):
+        phi = sum(d2)
+        if phi <= 0: break
+        new = [i for i in range(n) if d2[i] > 0 and rng.random() * phi < KPAR_OVERSAMPLE * k * d2[i]]
+        for c in range(len(cand), len(cand) + len(new)): # fold the new candidates into d2 / closest
+            p = points[new[c - len(cand)]]
+            for i in range(n):
+                dist = sum((points[i][j] - p[j]) ** 2 for j in range(dim))
+                if dist < d2[i]: d2[i], closest[i] = dist, c
+        cand += new
+
+    weights = [0.0] * len(cand)
+    for i in range(n): weights[closest[i]] += 1.0
+    cand_points = [points[c] for c in cand]
+    if len(cand) <= k: # too few distinct candidates: pad with the first points
+        return [list(cand_points[c]) if c < len(cand) else list(points[c - len(cand)]) for c in range(k)]
+    seeds = kmeans_pp_seeds(cand_points, k, dim, rng, weights)
+    return weighted_lloyd(cand_points, weights, k, dim, seeds)
+
+def weighted_lloyd(points: List[Tuple[float, ...]], weights: List[float], k: int, dim: int, centroids: List[List[float]]) -> List[List[float]]:
+    """Weighted Lloyd on a small point set, until no label moves or RECLUSTER_ITERS.
+
+    Args:
+        points (list[tuple[float, ...]]): Input points.
+        weights (list[float]): Weight per point.
+        k (int): Number of clusters.
+        dim (int): Dimensionality of the points.
+        centroids (list[list[float]]): Seeds.
+
+    Returns:
+        list[list[float]]: The weighted means (an empty cluster keeps its centroid).
+    """
+    labels = [-1] * len(points)
+    for _ in range(RECLUSTER_ITERS):
+        moved = False
+        mass = [0.0] * k
+        sums = [[0.0] * dim for _ in range(k)]
+        for i, p in enumerate(points):
+            c = min_squared_distance_idx(p, dim, k, centroids)
+            if c != labels[i]: moved = True
+            labels[i] = c
+            mass[c] += weights[i]
+            for j in range(dim): sums[c][j] += weights[i] * p[j]
+        centroids = [[sums[c][j] / mass[c] for j in range(dim)] if mass[c] > 0 else centroids[c] for c in range(k)]
+        if not moved: break
+    return centroids
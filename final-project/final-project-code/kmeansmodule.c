@@ -0,0 +1,304 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "kmeans.h"
+
+/* Functions prototype declarations */
+static int points_get(PyObject *obj, Py_buffer *view, int *have_view, double **copy, const double **points, Py_ssize_t *n, Py_ssize_t *dim);
+static void points_release(Py_buffer *view, int have_view, double *copy);
+static int labels_from_sequence(PyObject *obj, Py_ssize_t n, size_t **out_labels, size_t *k);
+static int points_from_buffer(PyObject *obj, Py_buffer *view, Py_ssize_t *n, Py_ssize_t *dim);
+static int points_from_sequence(PyObject *obj, Py_ssize_t *n, Py_ssize_t *dim, double **out_points);
+static PyObject* build_py_labels(Py_ssize_t n, const size_t *labels);
+static PyObject* build_py_centroids(Py_ssize_t k, Py_ssize_t dim, const double *centroids);
+static PyObject* py_fit(PyObject *self, PyObject *args);
+static PyObject* py_silhouette(PyObject *self, PyObject *args);
+
+/**
+ * @brief Python wrapper: k-means from the first k points with kmeans.py's EPS/iterations semantics (see kmeans_fit).
+ * @param self CPython module/self (unused).
+ * @param args Python tuple: (points, k[, iterations=300[, eps=1e-4]]). points is either a C-contiguous 2-D buffer of
+ *             doubles (e.g. a memoryview cast to shape (n, dim)), read in place, or a sequence of n rows of length dim.
+ * @return New (labels, centroids) tuple: list[int] of length n and k×dim list of lists; NULL on error (sets exception).
+ */
+static PyObject* py_fit(PyObject *self, PyObject *args) {
+    /* Step 1: parse args and get an n×dim C view of the points */
+    PyObject *points_obj, *py_labels, *py_centroids, *result;
+    Py_ssize_t n, dim, k, iterations = 300;
+    double eps = 1e-4;
+    Py_buffer view;
+    int have_view = 0, status;
+    double *copy = NULL, *centroids;
+    const double *points;
+    size_t *labels;
+
+    (void)self; /* silence unused parameter under -Wall -Wextra -Werror */
+
+    if (!PyArg_ParseTuple(args, "On|nd", &points_obj, &k, &iterations, &eps)) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    if (points_get(points_obj, &view, &have_view, &copy, &points, &n, &dim) == -1) {return NULL;}
+    if (!(1 < k && k < n) || iterations < 1) {points_release(&view, have_view, copy); PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+
+    /* Step 2: seed with the first k points (as kmeans.py) and run without the GIL */
+    centroids = malloc((size_t)k * (size_t)dim * sizeof *centroids);
+    labels = malloc((size_t)n * sizeof *labels);
+    if (!centroids || !labels) {points_release(&view, have_view, copy); free(centroids); free(labels); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    memcpy(centroids, points, (size_t)k * (size_t)dim * sizeof *centroids);
+    Py_BEGIN_ALLOW_THREADS
+    status = kmeans_fit((size_t)n, (size_t)k, (int)(iterations > INT_MAX ? INT_MAX : iterations), eps, (size_t)dim,
+                        (const double (*)[dim])points, (double (*)[dim])centroids, labels);
+    Py_END_ALLOW_THREADS
+    points_release(&view, have_view, copy);
+    if (status != 1) {free(centroids); free(labels); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+
+    /* Step 3: build the python (labels, centroids) tuple */
+    py_labels = build_py_labels(n, labels);
+    py_centroids = build_py_centroids(k, dim, centroids);
+    free(labels); free(centroids);
+    if (!py_labels || !py_centroids) {Py_XDECREF(py_labels); Py_XDECREF(py_centroids); return NULL;}
+    result = PyTuple_Pack(2, py_labels, py_centroids);
+    Py_DECREF(py_labels); Py_DECREF(py_centroids);
+    return result;
+}
+
+/**
+ * @brief Python wrapper: mean silhouette of a labeling (Euclidean, as sklearn's silhouette_score), exact or sampled.
+ * @param self CPython module/self (unused).
+ * @param args Python tuple: (points, labels[, samples=0[, seed=0[, threads=0]]]). points as for py_fit; labels are n
+ *             non-negative ints; samples=0 scores every point, otherwise that many uniformly drawn points.
+ * @return New (score, halfwidth) tuple of floats (halfwidth: 95% confidence bound, 0.0 when exact); NULL on error.
+ */
+static PyObject* py_silhouette(PyObject *self, PyObject *args) {
+    /* Step 1: parse args: points view, labels and the label count k */
+    PyObject *points_obj, *labels_obj;
+    Py_ssize_t n, dim, samples = 0;
+    unsigned long seed = 0;
+    int threads = 0, have_view = 0, status;
+    Py_buffer view;
+    double *copy = NULL, score = 0.0, halfwidth = 0.0;
+    const double *points;
+    size_t *labels, k;
+
+    (void)self; /* silence unused parameter under -Wall -Wextra -Werror */
+
+    if (!PyArg_ParseTuple(args, "OO|nki", &points_obj, &labels_obj, &samples, &seed, &threads) || samples < 0 || threads < 0) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    if (points_get(points_obj, &view, &have_view, &copy, &points, &n, &dim) == -1) {return NULL;}
+    if (labels_from_sequence(labels_obj, n, &labels, &k) == -1) {points_release(&view, have_view, copy); return NULL;}
+
+    /* Step 2: score without the GIL */
+    Py_BEGIN_ALLOW_THREADS
+    status = silhouette((size_t)n, (size_t)dim, (const double (*)[dim])points, labels, k, (size_t)samples, seed, threads, &score, &halfwidth);
+    Py_END_ALLOW_THREADS
+    points_release(&view, have_view, copy);
+    free(labels);
+    if (status == 0) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;} /* fewer than 2 clusters */
+    if (status != 1) {PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    return Py_BuildValue("(dd)", score, halfwidth);
+}
+
+/**
+ * @brief Method table for kmeans_c_api.
+ */
+static PyMethodDef kmeansMethods[] = {
+    {"py_fit", (PyCFunction) py_fit, METH_VARARGS, PyDoc_STR("fit(points, k, iterations=300, eps=1e-4) -> (list[int], list[list[float]])\nK-means from the first k points until no centroid moves more than eps; return labels and centroids.")},
+    {"py_silhouette", (PyCFunction) py_silhouette, METH_VARARGS, PyDoc_STR("silhouette(points, labels, samples=0, seed=0, threads=0) -> (float, float)\nMean silhouette score and the 95% half-width of a sampled estimate (0.0 when exact).")},
+
+    {NULL, NULL, 0, NULL} /* end of array */
+};
+
+/**
+ * @brief Module definition for kmeans_c_api.
+ * @details Exposes the Python wrappers py_fit and py_silhouette.
+ */
+static struct PyModuleDef kmeansmodule = {
+    PyModuleDef_HEAD_INIT,
+    "kmeans_c_api",
+    NULL,
+    -1,
+    kmeansMethods
+};
+
+/**
+ * @brief Module initialization for kmeans_c_api.
+ * @return New PyObject* module on success, NULL on failure.
+ */
+PyMODINIT_FUNC PyInit_kmeans_c_api(void) {
+    PyObject *m;
+    kmeans_isa_select(); /* kernel set for this CPU, once per process */
+    m = PyModule_Create(&kmeansmodule);
+    if (!m) {
+        return NULL;
+    }
+    return m;
+}
+
+/**
+ * @brief Get an n×dim C view of points: a C-contiguous 2-D double buffer is used in place; anything else (lists,
+ *        Fortran-ordered or integer arrays) is copied row by row.
+ * @param obj Input points object.
+ * @param view Out: buffer view (valid when *have_view).
+ * @param have_view Out: 1 if the points come from view.
+ * @param copy Out: malloc'ed copy, or NULL.
+ * @param points Out: the n×dim points.
+ * @param n Out: number of rows.
+ * @param dim Out: number of columns.
+ * @return 1 on success (release with points_release), -1 on error (sets Python exception).
+ */
+static int points_get(PyObject *obj, Py_buffer *view, int *have_view, double **copy, const double **points, Py_ssize_t *n, Py_ssize_t *dim) {
+    *have_view = 0;
+    *copy = NULL;
+    if (PyObject_CheckBuffer(obj)) { /* buffer: no copy */
+        if (points_from_buffer(obj, view, n, dim) == 1) {
+            *have_view = 1;
+            *points = view->buf;
+            return 1;
+        }
+        PyErr_Clear(); /* not a C-contiguous 2-D double buffer: copy it as a sequence */
+    }
+    if (points_from_sequence(obj, n, dim, copy) == -1) {return -1;}
+    *points = *copy;
+    return 1;
+}
+
+/**
+ * @brief Release what points_get acquired.
+ * @param view Buffer view.
+ * @param have_view 1 if view must be released.
+ * @param copy Copy to free (may be NULL).
+ */
+static void points_release(Py_buffer *view, int have_view, double *copy) {
+    if (have_view) {PyBuffer_Release(view);}
+    free(copy);
+}
+
+/**
+ * @brief Copy a Python sequence of n non-negative ints to C labels.
+ * @param obj Input sequence.
+ * @param n Expected length.
+ * @param out_labels Out: receives malloc'ed n labels; caller must free().
+ * @param k Out: largest label + 1.
+ * @return 1 on success, -1 on error (sets Python exception).
+ */
+static int labels_from_sequence(PyObject *obj, Py_ssize_t n, size_t **out_labels, size_t *k) {
+    PyObject *py_val;
+    size_t *labels;
+    Py_ssize_t i;
+    long val;
+
+    if (!PySequence_Check(obj) || PySequence_Size(obj) != n) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return -1;}
+    labels = malloc((size_t)n * sizeof *labels);
+    if (!labels) {PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return -1;}
+    *k = 0;
+    for (i = 0; i < n; i++) {
+        py_val = PySequence_GetItem(obj, i);
+        val = py_val ? PyLong_AsLong(py_val) : -1;
+        Py_XDECREF(py_val);
+        if (val < 0 || PyErr_Occurred()) {free(labels); PyErr_Clear(); PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return -1;}
+        labels[i] = (size_t)val;
+        if (labels[i] + 1 > *k) {*k = labels[i] + 1;}
+    }
+    *out_labels = labels;
+    return 1;
+}
+
+/**
+ * @brief Get a read-only, C-contiguous 2-D view of doubles.
+ * @param obj Object exporting the buffer protocol.
+ * @param view Out: the view; caller must PyBuffer_Release() it on success.
+ * @param n Out: number of rows.
+ * @param dim Out: number of columns.
+ * @return 1 on success, -1 on error (sets Python exception).
+ */
+static int points_from_buffer(PyObject *obj, Py_buffer *view, Py_ssize_t *n, Py_ssize_t *dim) {
+    if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) == -1) {PyErr_Clear(); PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return -1;}
+    if (view->ndim != 2 || !view->format || strcmp(view->format, "d") != 0 || view->shape[0] <= 0 || view->shape[1] <= 0) {
+        PyBuffer_Release(view); PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return -1;
+    }
+    *n = view->shape[0];
+    *dim = view->shape[1];
+    return 1;
+}
+
+/**
+ * @brief Copy a Python sequence of equal-length rows (list/tuple of numbers) to a C n×dim matrix.
+ * @param obj Input sequence of n rows.
+ * @param n Out: number of rows.
+ * @param dim Out: row length.
+ * @param out_points Out: receives malloc'ed n×dim matrix; caller must free().
+ * @return 1 on success, -1 on error (sets Python exception).
+ */
+static int points_from_sequence(PyObject *obj, Py_ssize_t *n, Py_ssize_t *dim, double **out_points) {
+    PyObject *row, *py_val;
+    double *points;
+    Py_ssize_t i, j;
+
+    if (!PySequence_Check(obj) || (*n = PySequence_Size(obj)) <= 0) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return -1;}
+    row = PySequence_GetItem(obj, 0);
+    if (!row || !PySequence_Check(row) || (*dim = PySequence_Size(row)) <= 0) {Py_XDECREF(row); PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return -1;}
+    Py_DECREF(row);
+    if ((size_t)*n > (size_t)-1 / sizeof(double) / (size_t)*dim) {PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return -1;}
+
+    points = malloc((size_t)*n * (size_t)*dim * sizeof *points);
+    if (!points) {PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return -1;}
+    for (i = 0; i < *n; i++) {
+        row = PySequence_GetItem(obj, i);
+        if (!row || !PySequence_Check(row) || PySequence_Size(row) != *dim) {Py_XDECREF(row); free(points); PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return -1;}
+        for (j = 0; j < *dim; j++) {
+            py_val = PySequence_GetItem(row, j);
+            if (!py_val) {Py_DECREF(row); free(points); PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return -1;}
+            points[i * *dim + j] = PyFloat_AsDouble(py_val);
+            Py_DECREF(py_val);
+            if (PyErr_Occurred()) {Py_DECREF(row); free(points); PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return -1;}
+        }
+        Py_DECREF(row);
+    }
+    *out_points = points;
+    return 1;
+}
+
+/**
+ * @brief Build a Python list of ints from C labels.
+ * @param n Number of labels.
+ * @param labels Input labels.
+ * @return New list, or NULL on error (sets Python exception).
+ */
+static PyObject* build_py_labels(Py_ssize_t n, const size_t *labels) {
+    PyObject *py_list, *num;
+    Py_ssize_t i;
+
+    py_list = PyList_New(n);
+    if (!py_list) {PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    for (i = 0; i < n; i++) {
+        num = PyLong_FromSize_t(labels[i]);
+        if (!num) {Py_DECREF(py_list); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+        PyList_SET_ITEM(py_list, i, num);
+    }
+    return py_list;
+}
+
+/**
+ * @brief Build a Python list-of-lists from a C k×dim matrix.
+ * @param k Number of rows.
+ * @param dim Number of columns.
+ * @param centroids Input k×dim matrix.
+ * @return New list of lists, or NULL on error (sets Python exception).
+ */
+static PyObject* build_py_centroids(Py_ssize_t k, Py_ssize_t dim, const double *centroids) {
+    PyObject *py_mat, *row, *num;
+    Py_ssize_t i, j;
+
+    py_mat = PyList_New(k);
+    if (!py_mat) {PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    for (i = 0; i < k; i++) {
+        row = PyList_New(dim);
+        if (!row) {Py_DECREF(py_mat); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+        for (j = 0; j < dim; j++) {
+            num = PyFloat_FromDouble(centroids[i * dim + j]);
+            if (!num) {Py_DECREF(row); Py_DECREF(py_mat); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+            PyList_SET_ITEM(row, j, num);
+        }
+        PyList_SET_ITEM(py_mat, i, row);
+    }
+    return py_mat;
+}
@@ -1,8 +1,14 @@
 from setuptools import Extension, setup
 
-module = Extension("symnmf_c_api", sources=['symnmf.c', 'symnmfmodule.c'])
+KMEANS_DIR = '../../kmeans/c_implementation' # the C k-means (kmeans.c / kmeans.h) is built into kmeans_c_api as a library (KMEANS_LIBRARY drops its CLI)
+
+module = Extension("symnmf_c_api", sources=['symnmf.c', 'symnmfmodule.c'],
+                   extra_compile_args=['-pthread'], extra_link_args=['-pthread']) # the "mu-par" engine runs a pthread pool
+kmeans_module = Extension("kmeans_c_api", sources=['kmeansmodule.c', KMEANS_DIR + '/kmeans.c'],
+                          include_dirs=[KMEANS_DIR], define_macros=[('KMEANS_LIBRARY', None)],
+                          extra_compile_args=['-std=c99', '-pthread'], extra_link_args=['-pthread'])
 setup(
     name='symnmf_c_api',
      version='1.0',
      description='Python wrapper for SymNMF C extension',
-     ext_modules=[module])
\ No newline at end of file
+     ext_modules=[module, kmeans_module])
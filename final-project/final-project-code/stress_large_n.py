@@ -0,0 +1,95 @@
+import symnmf_c_api
+import ctypes
+import os
+import sys
+import tempfile
+import time
+import numpy as np
+from symnmf import init_decomp_mat
+
+DEFAULT_N = 46342 # smallest n with n*n > 2^31 - 1: every i*n + j index of W past row 46341 would overflow an int
+DIM = 2
+K = 2
+BLOCK = 5000 # rows of W per mini-batch step (about 1.9 GB at the default n)
+EPOCHS = 1
+SEED = 1234
+CHECKED_COLS = 1000 # entries per checked row of W compared against a direct computation
+
+def check_mat_alloc() -> None:
+    """Call mat_alloc in the extension directly: products that wrap size_t must fail, a small one must not.
+
+    Raises:
+        AssertionError: If an overflowing size is accepted or a valid one is refused."""
+    lib = ctypes.CDLL(symnmf_c_api.__file__)
+    lib.mat_alloc.argtypes = [ctypes.c_size_t, ctypes.c_size_t, ctypes.c_size_t, ctypes.c_int]
+    lib.mat_alloc.restype = ctypes.c_void_p
+    libc = ctypes.CDLL(None)
+    libc.free.argtypes = [ctypes.c_void_p]
+
+    for rows, cols, elem in [(1 << 32, 1 << 32, 8), (1 << 31, 1 << 30, 8), (1 << 61, 1, 8), (3, (1 << 63) // 3 + 1, 2)]:
+        assert lib.mat_alloc(rows, cols, elem, 0) is None and lib.mat_alloc(rows, cols, elem, 1) is None, (rows, cols, elem)
+    ptr = lib.mat_alloc(DEFAULT_N, K, 8, 1)
+    assert ptr is not None
+    libc.free(ptr)
+    print("mat_alloc: overflowing sizes rejected")
+
+def check_norm_rows(points: np.ndarray, norm_path: str) -> None:
+    """Compare a few rows of the W file (the last one lies past byte 2^34 at the default n) with W computed in numpy.
+
+    Args:
+        points (np.ndarray): The n×dim points written by py_norm_to_file.
+        norm_path (str): Path of its output.
+
+    Raises:
+        AssertionError: If a row differs."""
+    n = len(points)
+    def affinity_row(i: int) -> np.ndarray: # row i of sym: exp(-||x_i - x_j||^2 / 2), 0 on the diagonal
+        row = np.exp(-np.sum((points - points[i]) ** 2, axis=1) / 2)
+        row[i] = 0.0
+        return row
+    cols = np.arange(0, n, max(1, n // CHECKED_COLS))
+    col_degrees = np.array([affinity_row(j).sum() for j in cols])
+    with open(norm_path, "rb") as f:
+        for i in [0, n // 2, n - 1]:
+            f.seek(i * n * 8)
+            row = np.frombuffer(f.read(n * 8), dtype=np.float64)
+            a = affinity_row(i)
+            expected = a[cols] / np.sqrt(a.sum() * col_degrees)
+            assert np.allclose(row[cols], expected, rtol=1e-9, atol=0.0), f"row {i} of W"
+    print(f"norm_to_file: rows 0, {n // 2} and {n - 1} match")
+
+def main() -> None:
+    """Usage: python3 stress_large_n.py [n] [dir]. Writes the n×n W to a temporary file in dir (default: the system
+    temporary directory), checks it, runs one mini-batch epoch from it and checks H; the file is removed at exit."""
+    try:
+        n = int(sys.argv[1]) if len(sys.argv) > 1 else DEFAULT_N
+        work_dir = sys.argv[2] if len(sys.argv) > 2 else tempfile.gettempdir()
+        check_mat_alloc()
+
+        need = n * n * 8
+        free = os.statvfs(work_dir).f_bavail * os.statvfs(work_dir).f_frsize
+        if need > free: raise OSError(f"W needs {need / 2**30:.1f} GiB, {work_dir} has {free / 2**30:.1f} GiB free")
+
+        rng = np.random.default_rng(SEED)
+        points = rng.uniform(0, 30, size=(n, DIM))
+        with tempfile.TemporaryDirectory(dir=work_dir) as tmp_dir:
+            norm_path = os.path.join(tmp_dir, "norm.bin")
+            start = time.time()
+            norm_mean = symnmf_c_api.py_norm_to_file(points.tolist(), norm_path)
+            print(f"norm_to_file: n={n}, {os.path.getsize(norm_path) / 2**30:.1f} GiB in {time.time() - start:.1f} s")
+            assert os.path.getsize(norm_path) == need
+            check_norm_rows(points, norm_path)
+
+            decomp_mat = init_decomp_mat(n, K, norm_mean)
+            start = time.time()
+            H = np.array(symnmf_c_api.py_decomp_minibatch(norm_path, decomp_mat, BLOCK, EPOCHS, SEED))
+            print(f"decomp_mat_minibatch: {EPOCHS} epoch(s) of {BLOCK}-row blocks in {time.time() - start:.1f} s")
+            assert H.shape == (n, K) and np.all(np.isfinite(H)) and np.all(H >= 0)
+            assert not np.allclose(H[-BLOCK:], np.array(decomp_mat[-BLOCK:])) # rows past 46341 were updated too
+        print("OK")
+    except (ValueError, OSError, MemoryError, AssertionError) as e:
+        print(f"FAILED: {e!r}")
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
@@ -1,11 +1,24 @@
+#define _POSIX_C_SOURCE 200809L /* mmap, mkstemp, fsync for the W cache; fseeko for streamed W */
+#define _FILE_OFFSET_BITS 64 /* 64-bit off_t even on 32-bit hosts */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <errno.h>
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
 #include <math.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "symnmf.h"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SYMNMF_X86 /* AVX2 / AVX-512 kernel variants, each compiled for its level by a target attribute */
+#include <immintrin.h>
+#endif
 
 /**
  * @brief Linked-list node for an n-D point.
@@ -20,70 +33,416 @@ static const double EPS = 1e-4; /* stop condition */
 static const double BETA = 0.5; /* the constant beta */
 static const int MAX_ITERS = 300; /* max num of iterations */
 
+/* params for projecting a new point on a fitted model */
+static const int PROJ_ITERS = 100; /* max coordinate-descent sweeps of the k-dim NNLS */
+static const double PROJ_EPS = 1e-12; /* stop when a sweep moves h less than this (squared) */
+
+/* params for the low-rank (Nyström) factor */
+static const int JACOBI_SWEEPS = 50; /* max sweeps of the landmark-block eigen solver */
+static const double NYSTROM_RCOND = 1e-10; /* drop landmark eigenvalues below this fraction of the largest */
+static const double LOWRANK_DEG_FLOOR = 0.1; /* approximate degrees are raised to at least this fraction of their mean */
+static const double PI = 3.14159265358979323846;
+
+/* params for the mini-batch solver */
+static const int MINIBATCH_INNER = 10; /* updates of a row block per visit (W·H refreshed for the block's own columns) */
+
+/* params for the tiled affinity builder (sym_pruned) and the "mu-sparse" engine */
+static const size_t SYM_TILE = 64; /* points (rows of W) per tile */
+static const double SYM_ZERO_D2 = 1500.0; /* exp(-d2/2) is exactly 0.0 in double once d2 > ~1490.3; the margin covers rounding of d2 */
+
+/* params for the active-set "mu-lazy" engine */
+static const double LAZY_ROW_SHARE = 0.1; /* an update is quiet if it moves the row less than LAZY_ROW_SHARE·EPS/n (squared) */
+static const int LAZY_QUIET = 3; /* a row freezes after this many consecutive quiet updates */
+static const int LAZY_RECHECK = 10; /* every this many iterations all rows are updated (frozen rows may wake up) */
+
+/* params for the multilevel "ml" engine */
+#define ML_MAX_LEVELS 32 /* coarsening levels at most (each at least ML_MIN_SHRINK smaller) */
+static const size_t ML_COARSE_ROWS = 128; /* stop coarsening at this many rows (or 8k, whichever is larger) */
+static const double ML_MIN_SHRINK = 0.9; /* stop when a matching keeps more than this fraction of the rows */
+static const int ML_REFINE_ITERS = 10; /* multiplicative steps per level on the way back up */
+
+/* params for the threaded "mu-par" engine */
+static const size_t MU_PAR_ROWS = 64; /* rows per chunk: the fixed unit of the reductions, so H does not depend on the thread count */
+
+/* params for the pipelined reader (sym_stream) */
+static const size_t PIPE_ROWS = 128; /* parsed rows per block handed from the reader to the compute threads */
+
+/* params for the on-disk W cache */
+static const char WCACHE_MAGIC[8] = "SYMNMFW"; /* first bytes of every cache file */
+static const long WCACHE_VERSION = 1; /* bump when the file layout or the W computation changes */
+
+/**
+ * @brief Fixed header of a cache file, followed by points (n×dim), degrees (n) and W (n×n) as doubles.
+ */
+typedef struct WCacheHeader {
+    char magic[8];  /**< WCACHE_MAGIC. */
+    long version;  /**< WCACHE_VERSION. */
+    unsigned long n;  /**< Number of points. */
+    unsigned long dim;  /**< Point dimension. */
+    unsigned long hash;  /**< wcache_hash of the points. */
+} WCacheHeader;
+
+/**
+ * @brief Named decomposition engine (entry of SOLVERS).
+ */
+typedef struct SolverEntry {
+    const char *name;  /**< Name used by decomp_solver / the CLI. */
+    DecompSolver solve;  /**< Engine. */
+} SolverEntry;
+
+/**
+ * @brief Reusable barrier (mutex + condition variable; pthread_barrier_t is optional in POSIX).
+ */
+typedef struct Barrier {
+    pthread_mutex_t lock;  /**< Guards the fields below. */
+    pthread_cond_t cond;  /**< Signalled when a generation completes. */
+    int count;  /**< Threads taking part. */
+    int waiting;  /**< Threads arrived in the current generation. */
+    unsigned long generation;  /**< Completed generations. */
+} Barrier;
+
+/**
+ * @brief Shared state of one "mu-par" decomposition (see mu_par_worker). Worker t owns the chunks
+ *        [t·nchunks/threads, (t+1)·nchunks/threads) of MU_PAR_ROWS rows for all iterations.
+ */
+typedef struct MuPool {
+    size_t n, k;  /**< Sizes. */
+    const double *W;  /**< n×n W (read only). */
+    const double *H0;  /**< n×k initial H. */
+    double *H[2];  /**< Double-buffered n×k H: iteration t reads H[t%2] and writes H[1-t%2]. */
+    double *gram[2];  /**< Per parity: nchunks partial k×k Gram matrices of the H just written. */
+    double *diff[2];  /**< Per parity: nchunks partial ||H_(t+1) - H_t||_F^2. */
+    double *scratch;  /**< threads blocks of k×k (reduced Gram) + MU_PAR_ROWS×k (W·H rows). */
+    size_t nchunks;  /**< ceil(n / MU_PAR_ROWS). */
+    int threads;  /**< Workers (fixed before the start gate opens). */
+    int iters;  /**< Out: iterations run. */
+    int last;  /**< Out: index of the final H buffer. */
+    Barrier barrier;  /**< One wait per iteration (plus the start gate and the H0 copy). */
+} MuPool;
+
+/**
+ * @brief Argument of one "mu-par" worker thread.
+ */
+typedef struct MuWorker {
+    MuPool *pool;  /**< Shared state. */
+    int id;  /**< Worker index in [0, threads); 0 is the calling thread. */
+} MuWorker;
+
+/**
+ * @brief Reusable scratch memory of one batch worker: grown to the largest job seen, kept across jobs.
+ */
+typedef struct BatchArena {
+    double *buff;  /**< Scratch doubles (malloc'ed). */
+    size_t cap;  /**< Capacity of buff, in doubles. */
+} BatchArena;
+
+/**
+ * @brief Jobs still owned by one batch worker: the owner takes from the front, idle workers steal the back half.
+ */
+typedef struct BatchDeque {
+    pthread_mutex_t lock;  /**< Guards lo and hi. */
+    size_t lo, hi;  /**< Remaining job indices [lo, hi). */
+} BatchDeque;
+
+/**
+ * @brief Shared state of one symnmf_batch call (see batch_worker).
+ */
+typedef struct BatchPool {
+    BatchJob *jobs;  /**< All jobs. */
+    BatchDeque *deques;  /**< One per worker; worker t starts with the jobs [t·count/threads, (t+1)·count/threads). */
+    int threads;  /**< Workers (including the calling thread). */
+} BatchPool;
+
+/**
+ * @brief Argument of one batch worker thread.
+ */
+typedef struct BatchWorker {
+    BatchPool *pool;  /**< Shared state. */
+    int id;  /**< Worker index in [0, threads); 0 is the calling thread. */
+} BatchWorker;
+
+/**
+ * @brief One block of parsed rows of sym_stream, with the affinities of its rows to all earlier rows.
+ */
+typedef struct PipeBlock {
+    size_t row0;  /**< Index of the first row of the block. */
+    size_t rows;  /**< Rows in the block (PIPE_ROWS except for the last block). */
+    double *points;  /**< PIPE_ROWS×dim parsed points. */
+    double *low;  /**< rows×(row0+rows): entry (i, j) is A[row0+i][j] for j < row0+i (the rest is unused). */
+    double *deg;  /**< rows degrees: the sums over j < row0+i once computed, complete once every later block is committed. */
+    int done;  /**< 1 once low and the partial degrees are computed. */
+    struct PipeBlock *next;  /**< Next block in row order, or NULL. */
+} PipeBlock;
+
+/**
+ * @brief sym_entry or one of its fixed-dimension variants (SYM_ENTRY_KERNELS); sym_entry_kernel picks one per call.
+ */
+typedef double (*SymEntryKernel)(const double *p1, const double *p2, size_t dim);
+
+/**
+ * @brief Shared state of sym_stream: blocks are appended by the reader and claimed in order by the compute threads.
+ *        Blocks are kept (a list, not a ring): every later row needs the points of all earlier rows.
+ */
+typedef struct Pipeline {
+    pthread_mutex_t lock;  /**< Guards the fields below (not the block contents). */
+    pthread_cond_t ready;  /**< Signalled when a block is published, the input ends or the reader fails. */
+    size_t dim;  /**< Point dimension (set with the first block). */
+    SymEntryKernel entry_of;  /**< sym_entry_kernel(dim), set with dim. */
+    PipeBlock *head, *tail;  /**< Published blocks. */
+    PipeBlock *claim;  /**< Next block to compute, or NULL if all published blocks are claimed. */
+    PipeBlock *commit;  /**< Next block whose affinities are to be added to the earlier rows' degrees, or NULL. */
+    int committing;  /**< 1 while a thread runs the commits (they are serialized, in row order). */
+    int degrees;  /**< 0: the degrees are not needed (no commits). */
+    int eof;  /**< 1 once the reader is done. */
+    int failed;  /**< 1 if the input is invalid or an allocation failed. */
+} Pipeline;
+
+/**
+ * @brief Sort key of one point for morton_order.
+ */
+typedef struct MortonKey {
+    unsigned long key;  /**< Interleaved quantized coordinates. */
+    size_t idx;  /**< Point index. */
+} MortonKey;
+
+/**
+ * @brief The hot kernels built for one instruction-set level (entry of KERNEL_SETS, chosen by isa_select).
+ */
+typedef struct KernelSet {
+    const char *name;  /**< "avx512", "avx2" or "generic" (the values of SYMNMF_ISA). */
+    void (*gemm_acc)(size_t rows, size_t m, size_t cols, const double *A, size_t lda, const double *B, double *C);  /**< C += A·B */
+} KernelSet;
+
 /* functions prototype declarations */
-int file_validate_and_to_point_list(FILE *in, int *dim_out, int *n_out, Node *point_lst_head);
+int file_validate_and_to_point_list(FILE *in, size_t *dim_out, size_t *n_out, Node *point_lst_head);
 static int read_line(FILE *in, char **buff_out, size_t *len_out);
-static int parse_point(char *buff, int *dim, double **out_point);
-static int read_and_check_row(FILE *in, int *dim, double **out_point);
+static int parse_point(char *buff, size_t *dim, double **out_point);
+static int read_and_check_row(FILE *in, size_t *dim, double **out_point);
 static void free_tail_and_point(Node *head);
 void free_list(Node *head);
-int linked_list_to_2d_array(Node *head, int n, int dim, double **out_arr);
+int linked_list_to_2d_array(Node *head, size_t n, size_t dim, double **out_arr);
+
+int sym(size_t dim, size_t n, const double *mat, double **out_A);
+int sym_pruned(size_t dim, size_t n, const double *mat, double tol, double **out_A, unsigned char **out_mask);
+size_t sym_tile_count(size_t n);
+static double box_gap2(size_t dim, const double *lo1, const double *hi1, const double *lo2, const double *hi2);
+static double sym_entry(const double *p1,const double*p2, size_t dim);
+static SymEntryKernel sym_entry_kernel(size_t dim);
+int ddg(size_t n, const double *A, double **out_D);
+int ddg_tiled(size_t n, const double *A, const unsigned char *mask, double **out_D);
+int norm(size_t n, const double *A, const double *D, double **out_W);
+int norm_tiled(size_t n, const double *A, const double *D, const unsigned char *mask, double **out_W);
+int sym_stream(FILE *in, int threads, size_t *dim_out, size_t *n_out, double **out_A, double **out_deg);
+static int thread_count(int threads);
+static int pipeline_goal(const char *goal, FILE *in, int threads);
+static int pipe_publish(Pipeline *pipe, PipeBlock *blk, size_t dim);
+static void *pipe_worker(void *arg);
+static void pipe_compute(const Pipeline *pipe, PipeBlock *blk);
+static void pipe_commit(const Pipeline *pipe, const PipeBlock *blk);
+static void pipe_free(PipeBlock *head);
+
+int decomp_mat(size_t n, size_t k, const double *W, const double *H0, double **out);
+DecompSolver decomp_solver(const char *name);
+int decomp_mat_solver(const char *name, size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats);
+static int decomp_solve_mu(size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats);
+int decomp_mat_sweep(size_t n, const double *W, size_t count, const size_t *ks, const double *H0s, SweepFit *out);
+int symnmf_batch(size_t count, BatchJob *jobs, int threads);
+static void *batch_worker(void *arg);
+static int batch_next(BatchPool *pool, int id, size_t *out_job);
+static int batch_run(BatchJob *job, BatchArena *arena);
+static int batch_goal(FILE *in, int threads);
+static int batch_read(FILE *in, size_t *out_count, BatchJob **out_jobs, double **out_points);
+static int decomp_solve_mu_lazy(size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats);
+static int decomp_solve_ml(size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats);
+static size_t ml_match(size_t n, const double *W, size_t *map);
+static double *ml_coarsen(size_t n, const double *W, size_t nc, const size_t *map);
+static int ml_refine(size_t n, size_t k, const double *W, double *H, int iters);
+static int decomp_solve_mu_sparse(size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats);
+int decomp_mat_sparse(size_t n, size_t k, const double *W, const unsigned char *mask, const double *H0, double **out, DecompStats *stats);
+static int tile_index(size_t n, const double *W, const unsigned char *mask, size_t **out_ptr, size_t **out_col);
+static int decomp_solve_mu_par(size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats);
+int decomp_mat_parallel(size_t n, size_t k, const double *W, const double *H0, int threads, double **out, DecompStats *stats);
+static void *mu_par_worker(void *arg);
+static int barrier_init(Barrier *b, int count);
+static void barrier_wait(Barrier *b);
+static void barrier_destroy(Barrier *b);
+static int decomp_solve_cd(size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats);
+static double cd_best_coord(double a, double b);
+static double cube_root(double x);
+static double decomp_objective(size_t n, size_t k, const double *W, const double *H);
+static int update_decomp_mat(size_t n, size_t k, const double *W, const double *H, double **out_H);
+static int mat_mul(size_t rows, size_t m, size_t cols, const double *A, const double *B, double **out);
+const char *isa_select(void);
+static int isa_supported(const char *name);
+static void gemm_acc_generic(size_t rows, size_t m, size_t cols, const double *A, size_t lda, const double *B, double *C);
+#ifdef SYMNMF_X86
+static void gemm_acc_avx2(size_t rows, size_t m, size_t cols, const double *A, size_t lda, const double *B, double *C);
+static void gemm_acc_avx512(size_t rows, size_t m, size_t cols, const double *A, size_t lda, const double *B, double *C);
+#endif
+static int mat_transpose(size_t rows, size_t cols, const double *mat, double **out);
+void *mat_alloc(size_t rows, size_t cols, size_t elem_size, int zeroed);
+void print_squared_matrix_floats_4f(size_t n, const double *mat);
+static void print_matrix_floats_4f(size_t rows, size_t cols, const double *mat);
+
+int model_create(size_t dim, size_t n, size_t k, const double *points, const double *H, SymnmfModel **out_model);
+int model_project(const SymnmfModel *model, const double *point, size_t neighbors, double *out_h, size_t *out_label);
+void model_free(SymnmfModel *model);
+static void select_top(size_t n, const double *vals, size_t m, size_t *idx);
+int morton_order(size_t dim, size_t n, const double *mat, size_t *perm);
+static int morton_cmp(const void *a, const void *b);
+
+int norm_to_file(size_t dim, size_t n, const double *mat, FILE *out, double *out_mean);
+int decomp_mat_minibatch(const WRows *src, size_t k, const double *H0, size_t block, int epochs, unsigned long seed, double **out);
+static const double *w_rows(const WRows *src, size_t row0, size_t rows, double *buff);
+int nystrom_factor(size_t dim, size_t n, const double *mat, size_t m, unsigned long seed, double **out_Z, size_t *out_rank);
+int rff_factor(size_t dim, size_t n, const double *mat, size_t features, unsigned long seed, double **out_Z);
+int lowrank_norm_mean(size_t n, size_t r, const double *Z, double *out_mean);
+int decomp_mat_lowrank(size_t n, size_t r, size_t k, const double *Z, const double *H0, double **out);
+int lowrank_norm_error(size_t dim, size_t n, const double *mat, size_t r, const double *Z, double *out_err);
+static int lowrank_scaled_factor(size_t n, size_t r, const double *Z, double **out_Y, double **out_diag);
+static void lowrank_apply_W(size_t n, size_t r, size_t k, const double *Y, const double *diag, const double *H, double *tmp_r, double *out_WH);
+static void decomp_mu_step(size_t n, size_t k, const double *H, const double *WH, const double *HtH, double *out_H);
+static void gram_mat(size_t n, size_t k, const double *H, double *out_G);
+static int sym_eigen(size_t m, const double *M, double *out_vals, double *out_vecs);
+static unsigned long rng_next(unsigned long *state);
+static double rng_uniform(unsigned long *state);
+static double rng_gaussian(unsigned long *state);
+
+int wcache_open(const char *dir, size_t dim, size_t n, const double *points, WCache *out);
+void wcache_close(WCache *cache);
+static unsigned long wcache_hash(size_t dim, size_t n, const double *points);
+static int wcache_map(const char *path, size_t dim, size_t n, const double *points, unsigned long hash, WCache *out);
+static int wcache_store(const char *dir, const char *path, size_t dim, size_t n, const double *points, unsigned long hash);
 
-int sym(int dim, int n, const double *mat, double **out_A);
-static double sym_entry(const double *p1,const double*p2, int dim);
-int ddg(int n, const double *A, double **out_D);
-int norm(int n, const double *A, const double *D, double **out_W);
+/* decomposition engines selectable by name */
+static const SolverEntry SOLVERS[] = {
+    {"mu", decomp_solve_mu}, /* damped multiplicative rule (BETA) */
+    {"mu-lazy", decomp_solve_mu_lazy}, /* the same rule on the rows still moving (frozen rows rechecked periodically) */
+    {"ml", decomp_solve_ml}, /* multilevel: solve on a coarsened graph, interpolate, refine a few steps per level */
+    {"mu-sparse", decomp_solve_mu_sparse}, /* the same rule with W·H over the non-zero tiles of W only */
+    {"mu-par", decomp_solve_mu_par}, /* the same rule on a pool of threads (one per online core), row-partitioned */
+    {"cd", decomp_solve_cd} /* cyclic coordinate descent on the entries of H */
+};
 
-int decomp_mat(int n, int k, const double *W, const double *H0, double **out);
-static int update_decomp_mat(int n, int k, const double *W, const double *H, double **out_H);
-static int mat_mul(int rows, int m, int cols, const double *A, const double *B, double **out);
-static int mat_transpose(int rows, int cols, const double *mat, double **out);
-void print_squared_matrix_floats_4f(int n, const double *mat);
+/* fixed-dimension variants of sym_entry: the distance written out term by term, in the loop's order (same A) */
+#define SQ_TERM(i) diff = p1[i] - p2[i]; dist += diff * diff;
+#define SQ_TERMS_2 SQ_TERM(0) SQ_TERM(1)
+#define SQ_TERMS_3 SQ_TERMS_2 SQ_TERM(2)
+#define SQ_TERMS_4 SQ_TERMS_3 SQ_TERM(3)
+#define SQ_TERMS_5 SQ_TERMS_4 SQ_TERM(4)
+#define SQ_TERMS_8 SQ_TERMS_5 SQ_TERM(5) SQ_TERM(6) SQ_TERM(7)
+#define FIXED_DIM_SYM_ENTRY(D) \
+    static double sym_entry_##D(const double *p1, const double *p2, size_t dim) { \
+        double dist = 0.0, diff; \
+        (void)dim; \
+        SQ_TERMS_##D \
+        return exp(-dist / 2.0); \
+    }
+
+FIXED_DIM_SYM_ENTRY(2)
+FIXED_DIM_SYM_ENTRY(3)
+FIXED_DIM_SYM_ENTRY(4)
+FIXED_DIM_SYM_ENTRY(5)
+FIXED_DIM_SYM_ENTRY(8)
+
+/* sym_entry kernels indexed by dim; NULL: sym_entry itself */
+static const SymEntryKernel SYM_ENTRY_KERNELS[] = {
+    NULL, NULL, sym_entry_2, sym_entry_3, sym_entry_4, sym_entry_5, NULL, NULL, sym_entry_8
+};
+
+/* kernel sets, widest first: isa_select takes the first one the CPU supports */
+static const KernelSet KERNEL_SETS[] = {
+#ifdef SYMNMF_X86
+    {"avx512", gemm_acc_avx512}, /* 8 doubles per vector */
+    {"avx2", gemm_acc_avx2}, /* 4 doubles per vector */
+#endif
+    {"generic", gemm_acc_generic} /* plain loops (any CPU) */
+};
+#define KERNEL_SET_COUNT (sizeof KERNEL_SETS / sizeof KERNEL_SETS[0])
+static const KernelSet *kernels = KERNEL_SETS + KERNEL_SET_COUNT - 1; /* generic until isa_select runs */
 
 /**
  * @brief Main entry: read points file, build matrix per goal, print result.
- * @param argc Argument count (expect 3).
- * @param argv Argument vector: [1]=goal ("sym","ddg","norm"), [2]=file name.
+ * @param argc Argument count (expect 3, or 4 with an option).
+ * @param argv Argument vector: [1]=goal ("sym","ddg","norm","batch"), [2]=file name, optional [3]="--cache-dir=DIR"
+ *             (ddg/norm are mapped from / stored to the W cache in DIR) or "--pipeline=T" (A and the degrees are
+ *             built by T compute threads while the file is parsed, see sym_stream; 0 = one per online core).
+ *             Goal "batch" reads a multi-dataset file (see batch_read) and takes "--threads=T" instead.
  * @return 0 on success, exits(1) with error message on failure.
  */
 int main(int argc, char **argv) {
     const char *goal;
     FILE *in;
     Node *point_lst_head;
-    int dim = 0, n = 0;
+    const char *cache_dir = NULL;
+    char *end, *opt;
+    long threads = -1;
+    int pipeline = 0;
+    WCache cache;
+    size_t dim = 0, n = 0, i;
     double *points = NULL, *sym_mat = NULL, *ddg_mat = NULL, *norm_mat = NULL;
-    
-    /* Step 1: check argv and that goal is valid -> expecting argv[1] = goal, argv[2] = file_name */
-    if (argc !=  3) {printf("An Error Has Occurred\n"); exit(1);}
-    
+    unsigned char *mask = NULL;
+
+    isa_select(); /* pick the kernel set for this CPU (logged to stderr) */
+    /* Step 1: check argv and that goal is valid -> expecting argv[1] = goal, argv[2] = file_name[, argv[3] = --cache-dir=DIR] */
+    if (argc == 4 && strncmp(argv[3], "--cache-dir=", 12) == 0 && argv[3][12] != '\0') {cache_dir = argv[3] + 12;}
+    else if (argc == 4 && (strncmp(argv[3], "--pipeline=", 11) == 0 || strncmp(argv[3], "--threads=", 10) == 0)) {
+        opt = strchr(argv[3], '=') + 1; pipeline = (argv[3][2] == 'p');
+        errno = 0; threads = strtol(opt, &end, 10);
+        if (*opt == '\0' || *end != '\0' || errno == ERANGE || threads < 0 || threads > INT_MAX) {printf("An Error Has Occurred\n"); exit(1);}
+    }
+    else if (argc !=  3) {printf("An Error Has Occurred\n"); exit(1);}
+
     goal = argv[1];
+    if (strcmp(goal, "batch") == 0) { /* many small jobs in one process */
+        if (cache_dir || pipeline) {printf("An Error Has Occurred\n"); exit(1);}
+        in = fopen(argv[2], "r"); if (!in) {printf("An Error Has Occurred\n"); exit(1);}
+        if (batch_goal(in, (int)threads) == -1) {printf("An Error Has Occurred\n"); fclose(in); exit(1);}
+        fclose(in); return 0;
+    }
     if (strcmp(goal, "sym") != 0 && strcmp(goal, "ddg") != 0 && strcmp(goal, "norm") != 0) {printf("An Error Has Occurred\n"); exit(1);}
-    
+    if (threads >= 0 && !pipeline) {printf("An Error Has Occurred\n"); exit(1);} /* --threads is for batch only */
+
     in = fopen(argv[2], "r"); if (!in) {printf("An Error Has Occurred\n"); exit(1);}
+    if (pipeline) { /* parse and compute side by side */
+        if (pipeline_goal(goal, in, (int)threads) == -1) {printf("An Error Has Occurred\n"); fclose(in); exit(1);}
+        fclose(in); return 0;
+    }
     point_lst_head = malloc(sizeof(*point_lst_head)); /* Step 2: validate and create points list. */
     if(!point_lst_head) {fclose(in); printf("An Error Has Occurred\n"); exit(1);}
     point_lst_head->next = NULL; point_lst_head->point = NULL;
     if (file_validate_and_to_point_list(in, &dim, &n, point_lst_head) != 1 || n <= 1) {printf("An Error Has Occurred\n"); free_list(point_lst_head); fclose(in); exit(1);}
     fclose(in);
-    
+
     if (linked_list_to_2d_array(point_lst_head, n, dim, &points) != 1) {printf("An Error Has Occurred\n"); free_list(point_lst_head); free(points), exit(1);} /* Convert the linked list to a 2D array and free linked list */
     free_list(point_lst_head); /* Even if success -> we have the 2D array and no need for linked list of points*/
 
     /*Step 2: run algorithm determined by "goal" - and print result*/
-    if (strcmp(goal, "sym") == 0) { /* Step 4: run chosen algorithm (by goal) - and create n * n matrix */
+    if (cache_dir && strcmp(goal, "sym") != 0) { /* ddg / norm from the mapped cache entry */
+        if (wcache_open(cache_dir, dim, n, points, &cache) == -1) {printf("An Error Has Occurred\n"); free(points); exit(1);}
+        if (strcmp(goal, "norm") == 0) {print_squared_matrix_floats_4f(n, cache.W);}
+        else {
+            ddg_mat = mat_alloc(n, n, sizeof *ddg_mat, 1);
+            if (!ddg_mat) {printf("An Error Has Occurred\n"); wcache_close(&cache); free(points); exit(1);}
+            for (i = 0; i < n; i++) {ddg_mat[i * n + i] = cache.degrees[i];}
+            print_squared_matrix_floats_4f(n, ddg_mat); free(ddg_mat);
+        }
+        wcache_close(&cache);
+    }
+    else if (strcmp(goal, "sym") == 0) { /* Step 4: run chosen algorithm (by goal) - and create n * n matrix */
         if (sym(dim, n,points, &sym_mat) == -1) {printf("An Error Has Occurred\n");free(points); exit(1);}
         print_squared_matrix_floats_4f(n, sym_mat); free(sym_mat);
     }
-    else if (strcmp(goal, "ddg") == 0) {
-        if (sym(dim, n,points, &sym_mat) == -1) {printf("An Error Has Occurred\n");free(points); exit(1);}
-        if (ddg(n, sym_mat, &ddg_mat) == -1) {printf("An Error Has Occurred\n");free(points); free(sym_mat); exit(1);}
-        free(sym_mat); print_squared_matrix_floats_4f(n, ddg_mat); free(ddg_mat);
+    else if (strcmp(goal, "ddg") == 0) { /* ddg and norm only visit the tiles sym computed */
+        if (sym_pruned(dim, n, points, 0.0, &sym_mat, &mask) == -1) {printf("An Error Has Occurred\n");free(points); exit(1);}
+        if (ddg_tiled(n, sym_mat, mask, &ddg_mat) == -1) {printf("An Error Has Occurred\n");free(points); free(sym_mat); free(mask); exit(1);}
+        free(sym_mat); free(mask); print_squared_matrix_floats_4f(n, ddg_mat); free(ddg_mat);
     }
     else { /* goal = norm */
-        if (sym(dim, n,points, &sym_mat) == -1) {printf("An Error Has Occurred\n");free(points); exit(1);}
-        if (ddg(n, sym_mat, &ddg_mat) == -1) {printf("An Error Has Occurred\n");free(points); free(sym_mat); exit(1);}
-        if (norm(n, sym_mat, ddg_mat, &norm_mat) == -1) {printf("An Error Has Occurred\n");free(points); free(sym_mat); free(ddg_mat); exit(1);}
-        free(sym_mat); free (ddg_mat); print_squared_matrix_floats_4f(n, norm_mat); free(norm_mat);
+        if (sym_pruned(dim, n, points, 0.0, &sym_mat, &mask) == -1) {printf("An Error Has Occurred\n");free(points); exit(1);}
+        if (ddg_tiled(n, sym_mat, mask, &ddg_mat) == -1) {printf("An Error Has Occurred\n");free(points); free(sym_mat); free(mask); exit(1);}
+        if (norm_tiled(n, sym_mat, ddg_mat, mask, &norm_mat) == -1) {printf("An Error Has Occurred\n");free(points); free(sym_mat); free(ddg_mat); free(mask); exit(1);}
+        free(sym_mat); free (ddg_mat); free(mask); print_squared_matrix_floats_4f(n, norm_mat); free(norm_mat);
     }
     free(points); return 0;
 }
@@ -97,10 +456,10 @@ int main(int argc, char **argv) {
  * @return 1 on success, 0 if file empty, -1 on parse/allocation error.
  * @note Caller must free the list (and points) when done.
  */
-int file_validate_and_to_point_list(FILE *in, int *dim_out, int *n_out, Node *point_lst_head) {
+int file_validate_and_to_point_list(FILE *in, size_t *dim_out, size_t *n_out, Node *point_lst_head) {
     Node *curr_node;
     Node *new_node;
-    int points_list_len = 0;
+    size_t points_list_len = 0;
     int status;
 
     point_lst_head->next = NULL;
@@ -111,7 +470,7 @@ int file_validate_and_to_point_list(FILE *in, int *dim_out, int *n_out, Node *po
     if (status == 0) {*n_out = points_list_len; return 0;} /* 0 = empty (EOF at start) */
     else if (status == -1) {free_tail_and_point(point_lst_head); return -1;} /* -1 = invalid */
     else {points_list_len ++;}
-    
+
     while (1) {
         new_node = malloc(sizeof(*new_node));
         if (!new_node) {free_tail_and_point(point_lst_head); return -1;}
@@ -177,12 +536,12 @@ static int read_line(FILE *in, char **buff_out, size_t *len_out) {
  * @param out_point Out: malloc'ed array of length *dim with parsed doubles; caller must free().
  * @return 1 on success, -1 on parse/alloc/validation error.
  */
-static int parse_point(char *buff, int *dim, double **out_point) {
+static int parse_point(char *buff, size_t *dim, double **out_point) {
     char *p = buff, *q = NULL;
     char *endptr = NULL, *comma = NULL;
     double *point = NULL, *tmp_double = NULL, coordinate;
     size_t max_dim = 8;
-    int point_len = 0;
+    size_t point_len = 0;
 
     if (*dim == 0) {point = malloc(max_dim * sizeof(double));} /* First point */
     else {point = malloc((*dim) * sizeof(double));}
@@ -195,7 +554,7 @@ static int parse_point(char *buff, int *dim, double **out_point) {
         while (*q) {if (isspace((unsigned char)*q)) {free(point); return -1;} q++;}
         errno = 0; coordinate = strtod(p, &endptr); /* Parse double */
         if (*endptr != '\0' || errno == ERANGE) {free(point); return -1;}
-        if (*dim == 0 && point_len >= (int)max_dim) { /* For first point - check if need to allocate more memory in buffer */
+        if (*dim == 0 && point_len >= max_dim) { /* For first point - check if need to allocate more memory in buffer */
             max_dim *= 2;
             tmp_double = realloc(point, max_dim * sizeof(double));
             if (!tmp_double) {free(point); return -1;}
@@ -222,7 +581,7 @@ static int parse_point(char *buff, int *dim, double **out_point) {
  * @param out_point Receives malloc'ed array of length *dim; caller must free().
  * @return 1 on success, 0 on clean EOF (empty line at end), -1 on parse/alloc/error.
  */ 
-static int read_and_check_row(FILE *in, int *dim, double **out_point) {
+static int read_and_check_row(FILE *in, size_t *dim, double **out_point) {
     char *buff = NULL;
     size_t len = 0;
     int status, parse_status;
@@ -275,14 +634,14 @@ void free_list(Node *head) {
  * @param out_arr Receives malloc'ed n×dim array; caller must free().
  * @return 1 on success, -1 on failure.
  */
-int linked_list_to_2d_array(Node *head, int n, int dim, double **out_arr) {
+int linked_list_to_2d_array(Node *head, size_t n, size_t dim, double **out_arr) {
     double *arr;
     Node *p;
-    int i, d;
+    size_t i, d;
 
-    if (!head || n <= 0 || dim <= 0 || !out_arr) {return -1;}
+    if (!head || n == 0 || dim == 0 || !out_arr) {return -1;}
 
-    arr = malloc(n * dim * sizeof(double));
+    arr = mat_alloc(n, dim, sizeof(double), 0);
     if (!arr) {return -1;}
 
     p = head;
@@ -302,39 +661,115 @@ int linked_list_to_2d_array(Node *head, int n, int dim, double **out_arr) {
  * @param mat Input n×dim points.
  * @param out_A Receives malloc'ed n×n A; caller must free().
  * @return 1 on success, -1 on allocation failure.
+ * @note Exact: tile pairs are skipped only where every entry would be 0.0 anyway (see sym_pruned).
  */
-int sym(int dim, int n, const double *mat, double **out_A) {
-    double *A;
-    int i, j;
-    double entry;
-    
-    A = malloc(n * n * sizeof *A); /* iInitialize the new n*n symmetric matrix */
-    if (!A) return -1;
+int sym(size_t dim, size_t n, const double *mat, double **out_A) {
+    return sym_pruned(dim, n, mat, 0.0, out_A, NULL);
+}
+
+/**
+ * @brief Build A tile by tile (SYM_TILE points per tile), skipping tile pairs that cannot hold a non-zero entry.
+ *        Each tile keeps the bounding box of its points; the squared gap between two boxes is a lower bound on every
+ *        d^2 between their points, so a gap above SYM_ZERO_D2 (or -2 ln tol) means exp(-d^2/2) is 0.0 (or < tol)
+ *        for the whole pair. Effective when nearby points are adjacent (e.g. after morton_order).
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param mat Input n×dim points.
+ * @param tol 0: exact A; > 0: entries below tol are set to 0 (and whole tile pairs below it skipped).
+ * @param out_A Receives malloc'ed n×n A; caller must free().
+ * @param out_mask If not NULL, receives the malloc'ed tiles×tiles mask (1: the tile pair was computed); caller must free().
+ * @return 1 on success, -1 on allocation failure.
+ */
+int sym_pruned(size_t dim, size_t n, const double *mat, double tol, double **out_A, unsigned char **out_mask) {
+    double *A, *lo, *hi, cut = SYM_ZERO_D2, entry;
+    unsigned char *mask;
+    size_t tiles, ti, tj, i, j, i1, j0, j1, d;
+    SymEntryKernel entry_of = sym_entry_kernel(dim);
+
+    if (dim == 0 || !mat || !out_A) return -1;
+    if (tol > 0.0 && -2.0 * log(tol) < cut) {cut = -2.0 * log(tol);}
+    tiles = sym_tile_count(n);
+    A = mat_alloc(n, n, sizeof *A, 1); /* zeroed: skipped tiles and the diagonal stay 0 */
+    lo = mat_alloc(tiles, dim, sizeof *lo, 0); hi = mat_alloc(tiles, dim, sizeof *hi, 0);
+    mask = mat_alloc(tiles, tiles, sizeof *mask, 0);
+    if (!A || (tiles > 0 && (!lo || !hi || !mask))) {free(A); free(lo); free(hi); free(mask); return -1;}
 
-    for(i = 0; i < n; i++) { /* Add entries to sym matrix */
-        A[i * n + i] = 0.0;
-        for(j = i + 1; j < n; j++) {
-            entry = sym_entry(mat + i * dim, mat + j * dim, dim);
-            A[i * n + j] = entry;
-            A[j * n + i] = entry;
+    for (ti = 0; ti < tiles; ti++) { /* bounding box of each tile */
+        i1 = (ti * SYM_TILE + SYM_TILE < n) ? ti * SYM_TILE + SYM_TILE : n;
+        for (d = 0; d < dim; d++) {lo[ti * dim + d] = hi[ti * dim + d] = mat[ti * SYM_TILE * dim + d];}
+        for (i = ti * SYM_TILE + 1; i < i1; i++) {
+            for (d = 0; d < dim; d++) {
+                if (mat[i * dim + d] < lo[ti * dim + d]) {lo[ti * dim + d] = mat[i * dim + d];}
+                if (mat[i * dim + d] > hi[ti * dim + d]) {hi[ti * dim + d] = mat[i * dim + d];}
+            }
+        }
+    }
+    for (ti = 0; ti < tiles; ti++) { /* upper triangle of tile pairs, mirrored */
+        i1 = (ti * SYM_TILE + SYM_TILE < n) ? ti * SYM_TILE + SYM_TILE : n;
+        for (tj = ti; tj < tiles; tj++) {
+            mask[ti * tiles + tj] = mask[tj * tiles + ti] = !(box_gap2(dim, lo + ti * dim, hi + ti * dim, lo + tj * dim, hi + tj * dim) > cut);
+            if (!mask[ti * tiles + tj]) {continue;}
+            j1 = (tj * SYM_TILE + SYM_TILE < n) ? tj * SYM_TILE + SYM_TILE : n;
+            for (i = ti * SYM_TILE; i < i1; i++) {
+                j0 = (ti == tj) ? i + 1 : tj * SYM_TILE;
+                for (j = j0; j < j1; j++) {
+                    entry = entry_of(mat + i * dim, mat + j * dim, dim);
+                    if (entry < tol) {entry = 0.0;}
+                    A[i * n + j] = entry;
+                    A[j * n + i] = entry;
+                }
+            }
         }
     }
+    free(lo); free(hi);
+    if (out_mask) {*out_mask = mask;} else {free(mask);}
     *out_A = A;
     return 1;
 }
 
+/**
+ * @brief Tiles per side of the sym_pruned mask.
+ * @param n Number of points.
+ * @return ceil(n / SYM_TILE).
+ */
+size_t sym_tile_count(size_t n) {
+    return (n + SYM_TILE - 1) / SYM_TILE;
+}
+
+/**
+ * @brief Squared distance between two axis-aligned boxes (0 if they overlap): a lower bound on d^2 between their points.
+ * @param dim Dimension.
+ * @param lo1 Lower corner of box 1.
+ * @param hi1 Upper corner of box 1.
+ * @param lo2 Lower corner of box 2.
+ * @param hi2 Upper corner of box 2.
+ * @return The squared gap.
+ */
+static double box_gap2(size_t dim, const double *lo1, const double *hi1, const double *lo2, const double *hi2) {
+    double gap2 = 0.0, g;
+    size_t d;
+
+    for (d = 0; d < dim; d++) {
+        g = (lo2[d] > hi1[d]) ? lo2[d] - hi1[d] : (lo1[d] > hi2[d]) ? lo1[d] - hi2[d] : 0.0;
+        gap2 += g * g;
+    }
+    return gap2;
+}
+
 /**
  * @brief Compute entry value = exp(-||p1-p2||^2 / 2).
  * @param p1 First point (length dim).
  * @param p2 Second point (length dim).
  * @param dim Dimension.
  * @return Entry value in (0,1].
+ * @note The generic loop; callers use sym_entry_kernel(dim), which picks the unrolled variant for the dimensions in
+ *       SYM_ENTRY_KERNELS (2, 3, 4, 5, 8), with the same value.
  */
-static double sym_entry(const double *p1, const double *p2, int dim) {
+static double sym_entry(const double *p1, const double *p2, size_t dim) {
     double dist = 0.0;
     double diff;
     double entry;
-    int i;
+    size_t i;
 
     for(i = 0; i < dim; i++) { /* Calculate squared Euclidean distance */
         diff = p1[i] - p2[i];
@@ -344,6 +779,18 @@ static double sym_entry(const double *p1, const double *p2, int dim) {
     return entry;
 }
 
+/**
+ * @brief Pick the sym_entry kernel for a dimension, once per call of the caller rather than once per entry.
+ * @param dim Dimension.
+ * @return The unrolled variant from SYM_ENTRY_KERNELS, or sym_entry.
+ */
+static SymEntryKernel sym_entry_kernel(size_t dim) {
+    if (dim < sizeof SYM_ENTRY_KERNELS / sizeof SYM_ENTRY_KERNELS[0] && SYM_ENTRY_KERNELS[dim]) {
+        return SYM_ENTRY_KERNELS[dim];
+    }
+    return sym_entry;
+}
+
  /**
  * @brief Build n×n diagonal degree matrix D from sym matrix A.
  * @param n Number of rows/cols.
@@ -351,20 +798,36 @@ static double sym_entry(const double *p1, const double *p2, int dim) {
  * @param out_D Receives malloc'ed n×n D; caller must free().
  * @return 1 on success, -1 on allocation failure.
  */
-int ddg(int n, const double *A, double **out_D) {
+int ddg(size_t n, const double *A, double **out_D) {
+    return ddg_tiled(n, A, NULL, out_D);
+}
+
+/**
+ * @brief ddg summing only the tile pairs sym_pruned computed (the others hold 0.0 and add nothing).
+ * @param n Number of rows/cols.
+ * @param A Input n×n sym matrix.
+ * @param mask Tile mask from sym_pruned, or NULL for all tiles.
+ * @param out_D Receives malloc'ed n×n D; caller must free().
+ * @return 1 on success, -1 on allocation failure.
+ * @note Each row is still summed in column order, so D is the same as ddg's, bit for bit.
+ */
+int ddg_tiled(size_t n, const double *A, const unsigned char *mask, double **out_D) {
     double *D;
-    int i, j;
-    double diag_sum;
+    size_t tiles, ti, tj, i, i1, j, j1;
 
-    D = calloc(n * n, sizeof *D); /* Initialize the new n * n ddg matrix - all entries initialized to 0.0 */
+    D = mat_alloc(n, n, sizeof *D, 1); /* Initialize the new n * n ddg matrix - all entries initialized to 0.0 */
     if (!D) {return -1;}
+    tiles = sym_tile_count(n);
 
-    for(i = 0; i < n; i++) { /* Add diag entries to ddg matrix */
-        diag_sum = 0.0;
-        for(j = 0; j < n; j++) {
-            diag_sum += A[i * n + j];
+    for (ti = 0; ti < tiles; ti++) { /* Add each computed tile's row sums to the diag entries */
+        i1 = (ti * SYM_TILE + SYM_TILE < n) ? ti * SYM_TILE + SYM_TILE : n;
+        for (tj = 0; tj < tiles; tj++) {
+            if (mask && !mask[ti * tiles + tj]) {continue;}
+            j1 = (tj * SYM_TILE + SYM_TILE < n) ? tj * SYM_TILE + SYM_TILE : n;
+            for (i = ti * SYM_TILE; i < i1; i++) {
+                for (j = tj * SYM_TILE; j < j1; j++) {D[i * n + i] += A[i * n + j];}
+            }
         }
-        D[i * n + i] = diag_sum;
     }
     *out_D = D;
     return 1;
@@ -378,25 +841,367 @@ int ddg(int n, const double *A, double **out_D) {
  * @param out_W Receives malloc'ed n×n normalized matrix; caller must free().
  * @return 1 on success, -1 on allocation failure.
  */
-int norm(int n, const double *A, const double *D, double **out_W) {
-    double *D_inversed_sqrt;
-    double *tmp;
-    int i;
-    double d;
+int norm(size_t n, const double *A, const double *D, double **out_W) {
+    return norm_tiled(n, A, D, NULL, out_W);
+}
+
+/**
+ * @brief norm over the tile pairs sym_pruned computed: W_ij = (d_i^(-1/2) · A_ij) · d_j^(-1/2), skipped tiles stay 0.
+ * @param n Number of rows/cols.
+ * @param A Input n×n sym matrix.
+ * @param D Input n×n ddg matrix.
+ * @param mask Tile mask from sym_pruned, or NULL for all tiles.
+ * @param out_W Receives malloc'ed n×n normalized matrix; caller must free().
+ * @return 1 on success, -1 on allocation failure.
+ * @note O(n^2): the same products, in the same order, as D^(-1/2) · A · D^(-1/2) with diagonal D^(-1/2), so W is
+ *       the same bit for bit.
+ */
+int norm_tiled(size_t n, const double *A, const double *D, const unsigned char *mask, double **out_W) {
+    double *W, *dinv, d;
+    size_t tiles, ti, tj, i, i1, j, j1;
 
-    D_inversed_sqrt = calloc(n * n, sizeof *D_inversed_sqrt);
-    if (!D_inversed_sqrt) {return -1;}
+    W = mat_alloc(n, n, sizeof *W, 1); /* zeroed: skipped tiles stay 0 */
+    dinv = mat_alloc(n, 1, sizeof *dinv, 0);
+    if (!W || !dinv) {free(W); free(dinv); return -1;}
+    tiles = sym_tile_count(n);
 
-    for (i = 0; i < n; i++) { /* Create D^(-1/2) */
+    for (i = 0; i < n; i++) { /* Diagonal of D^(-1/2) */
         d = D[i * n + i];
         if (d == 0) d = EPS;
-        D_inversed_sqrt[i * n + i] = 1.0 / sqrt(d);
+        dinv[i] = 1.0 / sqrt(d);
+    }
+    for (ti = 0; ti < tiles; ti++) {
+        i1 = (ti * SYM_TILE + SYM_TILE < n) ? ti * SYM_TILE + SYM_TILE : n;
+        for (tj = 0; tj < tiles; tj++) {
+            if (mask && !mask[ti * tiles + tj]) {continue;}
+            j1 = (tj * SYM_TILE + SYM_TILE < n) ? tj * SYM_TILE + SYM_TILE : n;
+            for (i = ti * SYM_TILE; i < i1; i++) {
+                for (j = tj * SYM_TILE; j < j1; j++) {W[i * n + j] = (dinv[i] * A[i * n + j]) * dinv[j];}
+            }
+        }
+    }
+    free(dinv);
+    *out_W = W;
+    return 1;
+}
+
+/**
+ * @brief Resolve a requested thread count: <= 0 means one per online core (1 if that cannot be read).
+ * @param threads Requested count.
+ * @return Thread count >= 1.
+ */
+static int thread_count(int threads) {
+    long cores;
+
+    if (threads > 0) {return threads;}
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return (cores > 0 && cores < INT_MAX) ? (int)cores : 1;
+}
+
+/**
+ * @brief Build A and the degrees while the points are parsed. The calling thread reads blocks of PIPE_ROWS rows and
+ *        publishes each one as soon as it is full; compute threads fill the affinities of a block's rows to all
+ *        earlier rows (row i needs only rows 0..i-1) and their partial degrees, and a serialized commit then adds
+ *        the block's affinities to the degrees of the earlier rows, in row order. At EOF the reader joins the
+ *        compute threads on the last blocks.
+ * @param in Input CSV stream (same format and checks as file_validate_and_to_point_list).
+ * @param threads Compute threads besides the reader; <= 0 means one per online core.
+ * @param dim_out Out: point dimension.
+ * @param n_out Out: number of points.
+ * @param out_A If not NULL, receives the malloc'ed n×n A; caller must free().
+ * @param out_deg If not NULL, receives the malloc'ed n degrees (row sums of A); caller must free().
+ * @return 1 on success, 0 if the stream is empty, -1 on invalid input or allocation failure.
+ * @note A and the degrees are those of sym and ddg bit for bit (each degree is summed in column order).
+ */
+int sym_stream(FILE *in, int threads, size_t *dim_out, size_t *n_out, double **out_A, double **out_deg) {
+    Pipeline pipe;
+    PipeBlock *blk = NULL, *b;
+    pthread_t *tids;
+    double *point, *A = NULL, *deg = NULL;
+    size_t dim = 0, n = 0, i, j, width;
+    int status, started, t;
+
+    if (!in || !dim_out || !n_out) return -1;
+    threads = thread_count(threads);
+    tids = malloc((size_t)threads * sizeof *tids);
+    if (!tids) {return -1;}
+    pipe.dim = 0; pipe.entry_of = sym_entry; pipe.head = pipe.tail = pipe.claim = pipe.commit = NULL;
+    pipe.committing = 0; pipe.degrees = (out_deg != NULL); pipe.eof = 0; pipe.failed = 0;
+    if (pthread_mutex_init(&pipe.lock, NULL) != 0) {free(tids); return -1;}
+    if (pthread_cond_init(&pipe.ready, NULL) != 0) {pthread_mutex_destroy(&pipe.lock); free(tids); return -1;}
+    for (started = 0; started < threads; started++) { /* fewer threads if creation fails (the reader computes too) */
+        if (pthread_create(&tids[started], NULL, pipe_worker, &pipe) != 0) {break;}
+    }
+
+    while (1) { /* read: fill a block, publish it when full or at EOF */
+        point = NULL;
+        status = read_and_check_row(in, &dim, &point);
+        if (status == 1 && !blk) {
+            blk = malloc(sizeof *blk);
+            if (blk) {blk->row0 = n; blk->rows = 0; blk->low = blk->deg = NULL; blk->done = 0; blk->next = NULL;
+                blk->points = mat_alloc(PIPE_ROWS, dim, sizeof *blk->points, 0);}
+            if (!blk || !blk->points) {free(blk); blk = NULL; free(point); status = -1;}
+        }
+        if (status == 1) {memcpy(blk->points + blk->rows * dim, point, dim * sizeof *point); free(point); blk->rows++; n++;}
+        if (status == -1) {pipe_free(blk); blk = NULL; break;}
+        if (blk && (blk->rows == PIPE_ROWS || status == 0)) {
+            if (pipe_publish(&pipe, blk, dim) == -1) {pipe_free(blk); blk = NULL; status = -1; break;}
+            blk = NULL;
+        }
+        if (status == 0) {break;}
+    }
+    pthread_mutex_lock(&pipe.lock);
+    pipe.eof = 1;
+    if (status == -1) {pipe.failed = 1;}
+    pthread_cond_broadcast(&pipe.ready);
+    pthread_mutex_unlock(&pipe.lock);
+    pipe_worker(&pipe); /* help with the blocks still unclaimed */
+    for (t = 0; t < started; t++) {pthread_join(tids[t], NULL);}
+    free(tids); pthread_cond_destroy(&pipe.ready); pthread_mutex_destroy(&pipe.lock);
+    if (status == -1) {pipe_free(pipe.head); return -1;}
+    if (n == 0) {*dim_out = dim; *n_out = 0; return 0;}
+
+    if (out_A) {A = mat_alloc(n, n, sizeof *A, 1);} /* zeroed: the diagonal stays 0 */
+    if (out_deg) {deg = malloc(n * sizeof *deg);}
+    if ((out_A && !A) || (out_deg && !deg)) {free(A); free(deg); pipe_free(pipe.head); return -1;}
+    for (b = pipe.head; b; b = b->next) { /* mirror the lower triangle, gather the degrees */
+        width = b->row0 + b->rows;
+        for (i = 0; i < b->rows; i++) {
+            if (A) {for (j = 0; j < b->row0 + i; j++) {A[(b->row0 + i) * n + j] = A[j * n + b->row0 + i] = b->low[i * width + j];}}
+            if (deg) {deg[b->row0 + i] = b->deg[i];}
+        }
+    }
+    pipe_free(pipe.head);
+    *dim_out = dim; *n_out = n;
+    if (out_A) {*out_A = A;}
+    if (out_deg) {*out_deg = deg;}
+    return 1;
+}
+
+/**
+ * @brief Run a CLI goal ("sym", "ddg" or "norm") on a points stream with sym_stream, and print the result.
+ * @param goal Goal name.
+ * @param in Input CSV stream.
+ * @param threads Compute threads (see sym_stream).
+ * @return 1 on success, -1 on invalid input (fewer than 2 points included) or allocation failure.
+ */
+static int pipeline_goal(const char *goal, FILE *in, int threads) {
+    double *A = NULL, *deg = NULL, *D, *W;
+    size_t dim, n, i;
+    int is_sym = (strcmp(goal, "sym") == 0), is_ddg = (strcmp(goal, "ddg") == 0);
+
+    if (sym_stream(in, threads, &dim, &n, is_ddg ? NULL : &A, is_sym ? NULL : &deg) != 1) {return -1;}
+    if (n <= 1) {free(A); free(deg); return -1;}
+    if (is_sym) {print_squared_matrix_floats_4f(n, A); free(A); return 1;}
+    D = mat_alloc(n, n, sizeof *D, 1);
+    if (!D) {free(A); free(deg); return -1;}
+    for (i = 0; i < n; i++) {D[i * n + i] = deg[i];}
+    free(deg);
+    if (is_ddg) {print_squared_matrix_floats_4f(n, D); free(D); return 1;}
+    if (norm(n, A, D, &W) == -1) {free(A); free(D); return -1;}
+    free(A); free(D); print_squared_matrix_floats_4f(n, W); free(W);
+    return 1;
+}
+
+/**
+ * @brief Allocate the affinity rows and degrees of a filled block and append it to the pipeline (wakes the workers).
+ * @param pipe Pipeline.
+ * @param blk Block with its points; row0 and rows set.
+ * @param dim Point dimension.
+ * @return 1 on success, -1 on allocation failure (blk is not appended; caller frees it).
+ */
+static int pipe_publish(Pipeline *pipe, PipeBlock *blk, size_t dim) {
+    blk->low = mat_alloc(blk->rows, blk->row0 + blk->rows, sizeof *blk->low, 0);
+    blk->deg = malloc(blk->rows * sizeof *blk->deg);
+    if (!blk->low || !blk->deg) {return -1;}
+    pthread_mutex_lock(&pipe->lock);
+    if (!pipe->head) {pipe->dim = dim; pipe->entry_of = sym_entry_kernel(dim);} /* set once: compute threads read them unlocked */
+    if (pipe->tail) {pipe->tail->next = blk;} else {pipe->head = blk;}
+    pipe->tail = blk;
+    if (!pipe->claim) {pipe->claim = blk;}
+    if (!pipe->commit) {pipe->commit = blk;}
+    pthread_cond_broadcast(&pipe->ready);
+    pthread_mutex_unlock(&pipe->lock);
+    return 1;
+}
+
+/**
+ * @brief Compute thread of sym_stream: claim blocks in row order and compute them; whichever thread finds the next
+ *        block to commit computed runs the commits, so the degree sums keep column order. Returns at EOF once no
+ *        block is left to claim, or on failure.
+ * @param arg The Pipeline.
+ * @return NULL.
+ */
+static void *pipe_worker(void *arg) {
+    Pipeline *pipe = arg;
+    PipeBlock *blk;
+
+    pthread_mutex_lock(&pipe->lock);
+    while (1) {
+        while (!pipe->claim && !pipe->eof && !pipe->failed) {pthread_cond_wait(&pipe->ready, &pipe->lock);}
+        if (pipe->failed || !pipe->claim) {break;}
+        blk = pipe->claim; pipe->claim = blk->next;
+        pthread_mutex_unlock(&pipe->lock);
+        pipe_compute(pipe, blk);
+        pthread_mutex_lock(&pipe->lock);
+        blk->done = 1;
+        if (pipe->degrees && !pipe->committing) {
+            pipe->committing = 1;
+            while (pipe->commit && pipe->commit->done) {
+                blk = pipe->commit; pipe->commit = blk->next;
+                pthread_mutex_unlock(&pipe->lock);
+                pipe_commit(pipe, blk);
+                pthread_mutex_lock(&pipe->lock);
+            }
+            pipe->committing = 0;
+        }
+    }
+    pthread_mutex_unlock(&pipe->lock);
+    return NULL;
+}
+
+/**
+ * @brief Fill the affinities of a block's rows to all earlier rows, and their sums (the degrees over j < i).
+ *        Earlier blocks are walked one at a time, so their points are reused across the block's rows.
+ * @param pipe Pipeline (blocks up to blk are published and never change).
+ * @param blk Claimed block.
+ */
+static void pipe_compute(const Pipeline *pipe, PipeBlock *blk) {
+    const PipeBlock *b;
+    size_t dim = pipe->dim, width = blk->row0 + blk->rows, i, j, j1;
+    double entry;
+
+    for (i = 0; i < blk->rows; i++) {blk->deg[i] = 0.0;}
+    for (b = pipe->head; b; b = b->next) {
+        for (i = 0; i < blk->rows; i++) {
+            j1 = (b == blk) ? i : b->rows;
+            for (j = 0; j < j1; j++) {
+                entry = pipe->entry_of(b->points + j * dim, blk->points + i * dim, dim);
+                blk->low[i * width + b->row0 + j] = entry;
+                blk->deg[i] += entry;
+            }
+        }
+        if (b == blk) {break;}
+    }
+}
+
+/**
+ * @brief Add a computed block's affinities to the degrees of all earlier rows (A is symmetric). Commits run one at a
+ *        time in row order, so every degree receives its terms in column order, as in ddg.
+ * @param pipe Pipeline.
+ * @param blk Next block to commit (computed).
+ */
+static void pipe_commit(const Pipeline *pipe, const PipeBlock *blk) {
+    PipeBlock *b;
+    size_t width = blk->row0 + blk->rows, i, j, i1;
+
+    for (j = 0; j < blk->rows; j++) {
+        for (b = pipe->head; b; b = b->next) {
+            i1 = (b == blk) ? j : b->rows;
+            for (i = 0; i < i1; i++) {b->deg[i] += blk->low[j * width + b->row0 + i];}
+            if (b == blk) {break;}
+        }
+    }
+}
+
+/**
+ * @brief Free a list of pipeline blocks.
+ * @param head First block (may be NULL).
+ */
+static void pipe_free(PipeBlock *head) {
+    PipeBlock *next;
+
+    while (head) {
+        next = head->next;
+        free(head->points); free(head->low); free(head->deg); free(head);
+        head = next;
+    }
+}
+
+/**
+ * @brief Run the CLI goal "batch": read a multi-dataset file, fit every job with symnmf_batch, and print per job a
+ *        "job=<j> k=<k> iters=<iterations> objective=<objective>" line, H (n×k) and its labels (one comma-separated line).
+ * @param in Input stream (see batch_read).
+ * @param threads Worker threads (see symnmf_batch).
+ * @return 1 on success, -1 on invalid input or failure (nothing is printed then).
+ */
+static int batch_goal(FILE *in, int threads) {
+    BatchJob *jobs;
+    double *points;
+    size_t count, j, i;
+    int status;
+
+    if (batch_read(in, &count, &jobs, &points) == -1) {return -1;}
+    status = symnmf_batch(count, jobs, threads);
+    for (j = 0; j < count; j++) {
+        if (status == 1) {
+            printf("job=%lu k=%lu iters=%d objective=%.4f\n", (unsigned long)j, (unsigned long)jobs[j].fit.k, jobs[j].fit.stats.iters, jobs[j].fit.stats.objective);
+            print_matrix_floats_4f(jobs[j].n, jobs[j].fit.k, jobs[j].fit.H);
+            for (i = 0; i < jobs[j].n; i++) {printf("%lu%s", (unsigned long)jobs[j].fit.labels[i], (i == jobs[j].n - 1) ? "\n" : ",");}
+        }
+        free(jobs[j].fit.H); free(jobs[j].fit.labels);
     }
+    free(jobs); free(points);
+    return status;
+}
 
-    tmp = NULL;
-    if (mat_mul(n, n, n, D_inversed_sqrt, A, &tmp) == -1) {free(D_inversed_sqrt); return -1;}
-    if (mat_mul(n, n, n, tmp, D_inversed_sqrt, out_W) == -1) {free(tmp); free(D_inversed_sqrt); return -1;}
-    free(tmp); free(D_inversed_sqrt);
+/**
+ * @brief Read a multi-dataset file: each job starts with a header line "@k,seed", followed by its points (CSV rows,
+ *        one dimension per job, as in the single-dataset file).
+ * @param in Input stream.
+ * @param out_count Receives the number of jobs.
+ * @param out_jobs Receives the malloc'ed jobs (points, n, dim, k and seed set); caller must free().
+ * @param out_points Receives the malloc'ed points of all jobs, one after the other; caller must free().
+ * @return 1 on success, -1 on invalid input (no job, points before the first header, 1 < k < n violated) or allocation failure.
+ */
+static int batch_read(FILE *in, size_t *out_count, BatchJob **out_jobs, double **out_points) {
+    BatchJob *jobs = NULL, *tmp_jobs;
+    double *points = NULL, *tmp_points, *point;
+    size_t *starts = NULL, *tmp_starts, count = 0, jobs_cap = 0, used = 0, points_cap = 0, len, j;
+    unsigned long k, seed;
+    char *buff, *end;
+    int status, ok;
+
+    while ((status = read_line(in, &buff, &len)) == 1) {
+        ok = 1;
+        if (buff[0] == '@') { /* header of a new job: "@k,seed" */
+            errno = 0;
+            ok = isdigit((unsigned char)buff[1]); k = strtoul(buff + 1, &end, 10);
+            ok = ok && *end == ',' && isdigit((unsigned char)end[1]);
+            if (ok) {seed = strtoul(end + 1, &end, 10); ok = *end == '\0' && errno != ERANGE;}
+            if (ok && count == jobs_cap) {
+                jobs_cap = jobs_cap ? 2 * jobs_cap : 16;
+                tmp_jobs = realloc(jobs, jobs_cap * sizeof *jobs); if (tmp_jobs) {jobs = tmp_jobs;}
+                tmp_starts = realloc(starts, jobs_cap * sizeof *starts); if (tmp_starts) {starts = tmp_starts;}
+                ok = tmp_jobs && tmp_starts;
+            }
+            if (ok) {
+                jobs[count].n = 0; jobs[count].dim = 0; jobs[count].points = NULL; jobs[count].seed = seed;
+                jobs[count].fit.k = k; starts[count] = used; count++;
+            }
+        }
+        else if (count == 0) {ok = 0;} /* points before the first header */
+        else {
+            point = NULL;
+            ok = parse_point(buff, &jobs[count - 1].dim, &point) == 1;
+            if (ok && used + jobs[count - 1].dim > points_cap) {
+                points_cap = (points_cap ? 2 * points_cap : 1024) + jobs[count - 1].dim;
+                tmp_points = realloc(points, points_cap * sizeof *points);
+                if (tmp_points) {points = tmp_points;} else {ok = 0;}
+            }
+            if (ok) {memcpy(points + used, point, jobs[count - 1].dim * sizeof *point); used += jobs[count - 1].dim; jobs[count - 1].n++;}
+            free(point);
+        }
+        free(buff);
+        if (!ok) {status = -1; break;}
+    }
+    for (j = 0; j < count && status == 0; j++) {
+        if (!(1 < jobs[j].fit.k && jobs[j].fit.k < jobs[j].n)) {status = -1;}
+        jobs[j].points = points + starts[j];
+    }
+    free(starts);
+    if (status == -1 || count == 0) {free(jobs); free(points); return -1;}
+    *out_count = count; *out_jobs = jobs; *out_points = points;
     return 1;
 }
 
@@ -409,12 +1214,61 @@ int norm(int n, const double *A, const double *D, double **out_W) {
  * @param out Receives malloc'ed final n×k H; caller must free().
  * @return 1 on success, -1 on failure.
  */
-int decomp_mat(int n, int k, const double *W, const double *H0, double **out) {
+int decomp_mat(size_t n, size_t k, const double *W, const double *H0, double **out) {
+    return decomp_solve_mu(n, k, W, H0, out, NULL);
+}
+
+/**
+ * @brief Look up a decomposition engine by name.
+ * @param name Engine name: "mu", "mu-lazy", "mu-sparse", "mu-par", "ml" or "cd".
+ * @return The engine, or NULL if the name is unknown.
+ */
+DecompSolver decomp_solver(const char *name) {
+    size_t i;
+
+    if (!name) {return NULL;}
+    for (i = 0; i < sizeof SOLVERS / sizeof SOLVERS[0]; i++) {
+        if (strcmp(SOLVERS[i].name, name) == 0) {return SOLVERS[i].solve;}
+    }
+    return NULL;
+}
+
+/**
+ * @brief Run the named decomposition engine until ||H_(t+1) - H_t||_F^2 < EPS or MAX_ITERS.
+ * @param name Engine name (see decomp_solver).
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n matrix.
+ * @param H0 Initial n×k matrix.
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @param stats Receives iterations and final objective; may be NULL.
+ * @return 1 on success, -1 on unknown engine or failure.
+ */
+int decomp_mat_solver(const char *name, size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats) {
+    DecompSolver solve = decomp_solver(name);
+
+    if (!solve) {return -1;}
+    return solve(n, k, W, H0, out, stats);
+}
+
+/**
+ * @brief "mu" engine: damped multiplicative updates (update_decomp_mat) - the original decomp_mat loop.
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n matrix.
+ * @param H0 Initial n×k matrix.
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @param stats Receives iterations and final objective; may be NULL.
+ * @return 1 on success, -1 on failure.
+ */
+static int decomp_solve_mu(size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats) {
     double *H_t, *H_t_plus1;
-    int i, j, it;
+    size_t i, j;
+    int it;
     double diff, d;
-    
-    H_t = malloc(n * k * sizeof *H_t); /* H(t) <- H0 */
+
+    if (n == 0 || k == 0 || !W || !H0 || !out) return -1;
+    H_t = mat_alloc(n, k, sizeof *H_t, 0); /* H(t) <- H0 */
     if (!H_t) return -1;
     for (i = 0; i < n; ++i) {
         for (j = 0; j < k; ++j) {
@@ -432,119 +1286,2109 @@ int decomp_mat(int n, int k, const double *W, const double *H0, double **out) {
                 diff += d * d;
             }
         }
-        if (diff < EPS) {free(H_t); *out = H_t_plus1; return 1;} /* retunr  H(t+1) */
         free(H_t); H_t = H_t_plus1;/* Next iteration: Ht <- H(t+1) */
+        if (diff < EPS) {break;} /* retunr  H(t+1) */
     }
-    *out = H_t; return 1; /* Max iters reached; return last Ht */
+    if (stats) {
+        stats->iters = (it < MAX_ITERS) ? it + 1 : MAX_ITERS;
+        stats->objective = decomp_objective(n, k, W, H_t);
+    }
+    *out = H_t; return 1; /* Converged or max iters reached; return last Ht */
 }
 
 /**
- * @brief One update step for H using W and current H (with EPS/BETA safeguards).
+ * @brief Run the "mu" engine for several k on one W. The H blocks live side by side in one n×K matrix (K = sum of
+ *        the k still running), so the dominant O(n^2) pass over W is shared: each iteration computes the wide product
+ *        W·[H_1 .. H_m] once, then every block takes its own damped multiplicative step with its own H^T H
+ *        (decomp_mu_step) and its own EPS test. A converged block drops out of the product.
  * @param n Number of rows in W and H.
- * @param k Number of columns in H.
  * @param W Input n×n matrix.
- * @param H Current n×k matrix.
- * @param out_H Receives malloc'ed n×k updated H; caller must free().
- * @return 1 on success, -1 on failure.
+ * @param count Number of k values.
+ * @param ks The k values (each >= 1).
+ * @param H0s Initial H blocks, one after the other: n×ks[0], then n×ks[1], ...
+ * @param out Receives count results (caller-allocated); free each H and labels.
+ * @return 1 on success, -1 on invalid args or allocation failure.
+ * @note Each block follows decomp_solve_mu's iteration, with H H^T H evaluated as H (H^T H): same iterates up to rounding.
  */
-static int update_decomp_mat(int n, int k, const double *W, const double *H, double **out_H) {
-    double *H_T = NULL, *tmp1 = NULL, *tmp2 = NULL, *tmp3 = NULL, *H_t_plus1 = NULL;
-    int i, j;
+int decomp_mat_sweep(size_t n, const double *W, size_t count, const size_t *ks, const double *H0s, SweepFit *out) {
+    double *H = NULL, *WH = NULL, *Hb = NULL, *WHb = NULL, *Hn = NULL, *G = NULL, w, d, diff, best;
+    size_t *off = NULL, *cols = NULL, total = 0, kmax = 0, ka, b, i, j, l, c;
+    int *running = NULL, it, left;
 
-    if (n <= 0 || k <= 0 || !W || !H || !out_H) return -1;
-
-    if (mat_transpose(n, k, H, &H_T) == -1) {return -1;} /* H^T (kxn) */
-    if (mat_mul(n, k, n, H, H_T, &tmp1) == -1) {free(H_T); return -1;} /* (H H^T) (n×n) */
-    if (mat_mul(n, n, k, tmp1, H, &tmp2) == -1) {free(H_T); free(tmp1); return -1;} /* (H H^T) H (n×k) */
-    free(H_T); free(tmp1);
+    if (n == 0 || count == 0 || !W || !ks || !H0s || !out) return -1;
+    for (b = 0; b < count; b++) {
+        if (ks[b] == 0 || ks[b] > (size_t)-1 - total) return -1;
+        total += ks[b];
+        if (ks[b] > kmax) {kmax = ks[b];}
+        out[b].k = ks[b];
+    }
 
-    for (i = 0; i < n; i++) { /* Ensure not dividing by zero - if cell == 0 -> turn to EPS */
-        for (j = 0; j < k; j++) {
-            if (tmp2[i * k + j] == 0.0) {tmp2[i * k + j] = EPS;}
+    /* Step 1: the wide H (n×total), the product buffer, one block's scratch, and per-block offsets */
+    H = mat_alloc(n, total, sizeof *H, 0); WH = mat_alloc(n, total, sizeof *WH, 0);
+    Hb = mat_alloc(n, kmax, sizeof *Hb, 0); WHb = mat_alloc(n, kmax, sizeof *WHb, 0); Hn = mat_alloc(n, kmax, sizeof *Hn, 0);
+    G = mat_alloc(kmax, kmax, sizeof *G, 0);
+    off = mat_alloc(count, 1, sizeof *off, 0); cols = mat_alloc(total, 1, sizeof *cols, 0);
+    running = mat_alloc(count, 1, sizeof *running, 0);
+    if (!H || !WH || !Hb || !WHb || !Hn || !G || !off || !cols || !running) {
+        free(H); free(WH); free(Hb); free(WHb); free(Hn); free(G); free(off); free(cols); free(running); return -1;
+    }
+    for (b = 0, c = 0; b < count; c += ks[b], b++) {
+        off[b] = c; running[b] = 1; out[b].stats.iters = MAX_ITERS;
+        for (i = 0; i < n; i++) {
+            for (j = 0; j < ks[b]; j++) {H[i * total + c + j] = H0s[c * n + i * ks[b] + j];}
+        }
+    }
+
+    for (it = 0, left = (int)count; it < MAX_ITERS && left > 0; ++it) {
+        /* Step 2: one pass over W for the columns of every running block: WH[:, cols] = W H[:, cols] */
+        for (b = 0, ka = 0; b < count; b++) {
+            if (!running[b]) {continue;}
+            for (j = 0; j < ks[b]; j++) {cols[ka++] = off[b] + j;}
+        }
+        for (i = 0; i < n; i++) {
+            for (c = 0; c < ka; c++) {WH[i * total + cols[c]] = 0.0;}
+            for (l = 0; l < n; l++) {
+                w = W[i * n + l];
+                for (c = 0; c < ka; c++) {WH[i * total + cols[c]] += w * H[l * total + cols[c]];}
+            }
+        }
+
+        /* Step 3: per running block, its own multiplicative step and EPS test */
+        for (b = 0; b < count; b++) {
+            if (!running[b]) {continue;}
+            for (i = 0; i < n; i++) {
+                for (j = 0; j < ks[b]; j++) {
+                    Hb[i * ks[b] + j] = H[i * total + off[b] + j];
+                    WHb[i * ks[b] + j] = WH[i * total + off[b] + j];
+                }
+            }
+            gram_mat(n, ks[b], Hb, G);
+            decomp_mu_step(n, ks[b], Hb, WHb, G, Hn);
+            diff = 0.0;
+            for (i = 0; i < n; i++) {
+                for (j = 0; j < ks[b]; j++) {
+                    d = Hn[i * ks[b] + j] - Hb[i * ks[b] + j];
+                    diff += d * d;
+                    H[i * total + off[b] + j] = Hn[i * ks[b] + j];
+                }
+            }
+            if (diff < EPS) {running[b] = 0; out[b].stats.iters = it + 1; left--;}
+        }
+    }
+
+    /* Step 4: per k: H, labels (row argmax) and the objective */
+    free(WH); free(Hb); free(WHb); free(Hn); free(G); free(cols); free(running);
+    for (b = 0; b < count; b++) {
+        out[b].H = mat_alloc(n, ks[b], sizeof *out[b].H, 0);
+        out[b].labels = mat_alloc(n, 1, sizeof *out[b].labels, 0);
+        if (!out[b].H || !out[b].labels) {
+            for (c = 0; c <= b; c++) {free(out[c].H); free(out[c].labels); out[c].H = NULL; out[c].labels = NULL;}
+            free(H); free(off); return -1;
+        }
+        for (i = 0; i < n; i++) {
+            out[b].labels[i] = 0; best = H[i * total + off[b]];
+            for (j = 0; j < ks[b]; j++) {
+                out[b].H[i * ks[b] + j] = H[i * total + off[b] + j];
+                if (H[i * total + off[b] + j] > best) {best = H[i * total + off[b] + j]; out[b].labels[i] = j;}
+            }
+        }
+        out[b].stats.objective = decomp_objective(n, ks[b], W, out[b].H);
+    }
+    free(H); free(off);
+    return 1;
+}
+
+/**
+ * @brief Fit SymNMF on many small datasets: a work-stealing pool runs the jobs, each worker in its own scratch arena.
+ *        Worker t starts with a contiguous share of the jobs and takes them from the front; once it runs dry it
+ *        steals the back half of another worker's share (see batch_next). The calling thread is worker 0.
+ * @param count Number of jobs.
+ * @param jobs The jobs (points, k and seed in; fit and status out).
+ * @param threads Worker threads (including the caller); <= 0 means one per online core, at most count.
+ * @return 1 if every job succeeded, -1 otherwise (see each job's status).
+ * @note Each job is computed by one thread from its own inputs only, so its result does not depend on threads.
+ */
+int symnmf_batch(size_t count, BatchJob *jobs, int threads) {
+    BatchPool pool;
+    BatchWorker *workers;
+    pthread_t *tids;
+    size_t j;
+    int t, started, status = 1;
+
+    if (count == 0 || !jobs) return -1;
+    threads = thread_count(threads);
+    if ((size_t)threads > count) {threads = (int)count;}
+    for (j = 0; j < count; j++) {jobs[j].status = -1; jobs[j].fit.H = NULL; jobs[j].fit.labels = NULL;}
+    pool.jobs = jobs; pool.threads = threads;
+    pool.deques = mat_alloc((size_t)threads, 1, sizeof *pool.deques, 0);
+    workers = mat_alloc((size_t)threads, 1, sizeof *workers, 0);
+    tids = mat_alloc((size_t)threads, 1, sizeof *tids, 0);
+    if (!pool.deques || !workers || !tids) {free(pool.deques); free(workers); free(tids); return -1;}
+    for (t = 0; t < threads; t++) {
+        if (pthread_mutex_init(&pool.deques[t].lock, NULL) != 0) {
+            while (t-- > 0) {pthread_mutex_destroy(&pool.deques[t].lock);}
+            free(pool.deques); free(workers); free(tids); return -1;
+        }
+        pool.deques[t].lo = count / threads * t + count % threads * t / threads; /* count·t/threads without overflow */
+        pool.deques[t].hi = count / threads * (t + 1) + count % threads * (t + 1) / threads;
+        workers[t].pool = &pool; workers[t].id = t;
+    }
+
+    for (started = 1; started < threads; started++) { /* a worker that fails to start leaves its share to the thieves */
+        if (pthread_create(&tids[started], NULL, batch_worker, &workers[started]) != 0) {break;}
+    }
+    batch_worker(&workers[0]);
+    for (t = 1; t < started; t++) {pthread_join(tids[t], NULL);}
+    for (t = 0; t < threads; t++) {pthread_mutex_destroy(&pool.deques[t].lock);}
+    free(pool.deques); free(workers); free(tids);
+    for (j = 0; j < count; j++) {if (jobs[j].status != 1) {status = -1;}}
+    return status;
+}
+
+/**
+ * @brief Body of one batch worker: run jobs until none is left to take or steal, reusing one arena throughout.
+ * @param arg The worker's BatchWorker.
+ * @return NULL.
+ */
+static void *batch_worker(void *arg) {
+    BatchWorker *worker = arg;
+    BatchArena arena;
+    size_t j;
+
+    arena.buff = NULL; arena.cap = 0;
+    while (batch_next(worker->pool, worker->id, &j)) {worker->pool->jobs[j].status = batch_run(&worker->pool->jobs[j], &arena);}
+    free(arena.buff);
+    return NULL;
+}
+
+/**
+ * @brief Take the next job of a worker: the front of its own share, or else the back half of the first non-empty
+ *        share of another worker (scanning from the next worker), which becomes its own share.
+ * @param pool Shared state.
+ * @param id Worker index.
+ * @param out_job Receives the job index.
+ * @return 1 if a job was taken, 0 if every share is empty (jobs are never added, so the worker can stop).
+ */
+static int batch_next(BatchPool *pool, int id, size_t *out_job) {
+    BatchDeque *own = &pool->deques[id], *victim;
+    size_t take, lo;
+    int t;
+
+    pthread_mutex_lock(&own->lock);
+    if (own->lo < own->hi) {*out_job = own->lo++; pthread_mutex_unlock(&own->lock); return 1;}
+    pthread_mutex_unlock(&own->lock);
+    for (t = 1; t < pool->threads; t++) {
+        victim = &pool->deques[(id + t) % pool->threads];
+        pthread_mutex_lock(&victim->lock);
+        take = (victim->hi - victim->lo + 1) / 2; /* 0 when empty; the victim keeps the front */
+        victim->hi -= take;
+        lo = victim->hi;
+        pthread_mutex_unlock(&victim->lock);
+        if (take == 0) {continue;}
+        pthread_mutex_lock(&own->lock);
+        own->lo = lo + 1; own->hi = lo + take;
+        pthread_mutex_unlock(&own->lock);
+        *out_job = lo;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Run one batch job in a worker's arena. W = D^(-1/2) A D^(-1/2) is built entry by entry, with the same values
+ *        as sym -> ddg -> norm. H0 is drawn from the job's seed, then the multiplicative step of decomp_mat_sweep
+ *        runs until EPS or MAX_ITERS.
+ * @param job Job (fit.H, fit.labels and fit.stats are set).
+ * @param arena Worker's arena, grown when the job needs more than any earlier one.
+ * @return 1 on success, -1 on invalid sizes or allocation failure.
+ */
+static int batch_run(BatchJob *job, BatchArena *arena) {
+    size_t n = job->n, dim = job->dim, k = job->fit.k, need, i, j;
+    double *W, *dinv, *H, *Hn, *WH, *G, *tmp, d, diff, mean = 0.0, scale, best;
+    unsigned long state = job->seed;
+    int it;
+    SymEntryKernel entry_of = sym_entry_kernel(dim);
+
+    if (n == 0 || dim == 0 || k == 0 || !job->points) return -1;
+    if ((double)n * (double)(n + 1) + 3.0 * (double)n * (double)k + (double)k * (double)k > (double)((size_t)-1 / sizeof(double))) return -1;
+    need = n * (n + 1) + 3 * n * k + k * k; /* W, D^(-1/2), H, H(t+1), W·H, H^T H */
+    if (need > arena->cap) {
+        free(arena->buff);
+        arena->buff = malloc(need * sizeof *arena->buff);
+        arena->cap = arena->buff ? need : 0;
+        if (!arena->buff) return -1;
+    }
+    W = arena->buff; dinv = W + n * n; H = dinv + n; Hn = H + n * k; WH = Hn + n * k; G = WH + n * k;
+    job->fit.H = mat_alloc(n, k, sizeof *job->fit.H, 0);
+    job->fit.labels = mat_alloc(n, 1, sizeof *job->fit.labels, 0);
+    if (!job->fit.H || !job->fit.labels) {free(job->fit.H); free(job->fit.labels); job->fit.H = NULL; job->fit.labels = NULL; return -1;}
+
+    /* Step 1: A, the degrees (row sums in column order, as ddg), then W in place (as norm: (d_i·a_ij)·d_j) */
+    for (i = 0; i < n; i++) {
+        W[i * n + i] = 0.0;
+        for (j = i + 1; j < n; j++) {W[i * n + j] = W[j * n + i] = entry_of(job->points + i * dim, job->points + j * dim, dim);}
+    }
+    for (i = 0; i < n; i++) {
+        d = 0.0;
+        for (j = 0; j < n; j++) {d += W[i * n + j];}
+        if (d == 0) {d = EPS;}
+        dinv[i] = 1.0 / sqrt(d);
+    }
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {W[i * n + j] = dinv[i] * W[i * n + j] * dinv[j]; mean += W[i * n + j];}
+    }
+
+    /* Step 2: H0 uniform in [0, 2·sqrt(mean/k)), then the multiplicative rule */
+    scale = 2.0 * sqrt(mean / ((double)n * (double)n) / (double)k);
+    for (i = 0; i < n * k; i++) {H[i] = scale * rng_uniform(&state);}
+    for (it = 0; it < MAX_ITERS; ++it) {
+        memset(WH, 0, n * k * sizeof *WH);
+        kernels->gemm_acc(n, n, k, W, n, H, WH);
+        gram_mat(n, k, H, G);
+        decomp_mu_step(n, k, H, WH, G, Hn);
+        diff = 0.0;
+        for (i = 0; i < n * k; i++) {d = Hn[i] - H[i]; diff += d * d;}
+        tmp = H; H = Hn; Hn = tmp;
+        if (diff < EPS) {break;}
+    }
+    job->fit.stats.iters = (it < MAX_ITERS) ? it + 1 : MAX_ITERS;
+
+    /* Step 3: outputs: H, labels (row argmax) and the objective */
+    for (i = 0; i < n; i++) {
+        job->fit.labels[i] = 0; best = H[i * k];
+        for (j = 0; j < k; j++) {
+            job->fit.H[i * k + j] = H[i * k + j];
+            if (H[i * k + j] > best) {best = H[i * k + j]; job->fit.labels[i] = j;}
+        }
+    }
+    job->fit.stats.objective = decomp_objective(n, k, W, H);
+    return 1;
+}
+
+/**
+ * @brief "mu-lazy" engine: damped multiplicative updates restricted to an active set of rows. A row whose updates
+ *        moved it less than LAZY_ROW_SHARE·EPS/n (squared) for LAZY_QUIET iterations in a row is frozen: its W·H row and its step
+ *        are skipped, so an iteration costs O(active·n·k) instead of O(n^2 k). Every LAZY_RECHECK iterations all rows
+ *        are updated and any that moved again are woken. H^T H is patched by the rank-1 changes of the updated rows
+ *        (and rebuilt on full iterations).
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n matrix.
+ * @param H0 Initial n×k matrix.
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @param stats Receives iterations and final objective; may be NULL.
+ * @return 1 on success, -1 on failure.
+ * @note Stops only when a full iteration passes ||H_(t+1) - H_t||_F^2 < EPS (a partial one that passes forces a
+ *       full one next), so the result passes the same test as "mu"; H agrees with "mu" to ~1e-2 (a few labels may differ).
+ */
+static int decomp_solve_mu_lazy(size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats) {
+    double *H, *Hn, *G, *Gn, *WH, *tmp, d, diff, row_diff, row_eps;
+    int *quiet, it, full;
+    size_t i, j, l;
+
+    if (n == 0 || k == 0 || !W || !H0 || !out) return -1;
+    H = mat_alloc(n, k, sizeof *H, 0); Hn = mat_alloc(n, k, sizeof *Hn, 0);
+    G = mat_alloc(k, k, sizeof *G, 0); Gn = mat_alloc(k, k, sizeof *Gn, 0); WH = mat_alloc(k, 1, sizeof *WH, 0);
+    quiet = mat_alloc(n, 1, sizeof *quiet, 1); /* consecutive quiet updates per row; >= LAZY_QUIET means frozen */
+    if (!H || !Hn || !G || !Gn || !WH || !quiet) {free(H); free(Hn); free(G); free(Gn); free(WH); free(quiet); return -1;}
+    memcpy(H, H0, n * k * sizeof *H);
+    row_eps = LAZY_ROW_SHARE * EPS / (double)n;
+
+    for (it = 0, full = 1; it < MAX_ITERS; ++it) {
+        if (it % LAZY_RECHECK == 0) {full = 1;}
+        if (full) {gram_mat(n, k, H, G);} /* exact H^T H on full iterations, patched in between */
+        memcpy(Gn, G, k * k * sizeof *G);
+        diff = 0.0;
+        for (i = 0; i < n; i++) {
+            if (!full && quiet[i] >= LAZY_QUIET) {memcpy(Hn + i * k, H + i * k, k * sizeof *H); continue;} /* frozen */
+            for (l = 0; l < k; l++) {WH[l] = 0.0;} /* (W H)_i, this row only */
+            kernels->gemm_acc(1, n, k, W + i * n, n, H, WH);
+            decomp_mu_step(1, k, H + i * k, WH, G, Hn + i * k);
+            row_diff = 0.0;
+            for (l = 0; l < k; l++) {d = Hn[i * k + l] - H[i * k + l]; row_diff += d * d;}
+            diff += row_diff;
+            quiet[i] = (row_diff < row_eps) ? quiet[i] + 1 : 0;
+            for (j = 0; j < k; j++) { /* H^T H += h_new h_new^T - h_old h_old^T */
+                for (l = 0; l < k; l++) {Gn[j * k + l] += Hn[i * k + j] * Hn[i * k + l] - H[i * k + j] * H[i * k + l];}
+            }
+        }
+        tmp = H; H = Hn; Hn = tmp; /* swap the H buffers and take the patched Gram */
+        tmp = G; G = Gn; Gn = tmp;
+        if (diff < EPS) {
+            if (full) {break;}
+            full = 1; continue; /* converged on the active rows: confirm on all rows */
+        }
+        full = 0;
+    }
+    if (stats) {
+        stats->iters = (it < MAX_ITERS) ? it + 1 : MAX_ITERS;
+        stats->objective = decomp_objective(n, k, W, H);
+    }
+    free(Hn); free(G); free(Gn); free(WH); free(quiet);
+    *out = H; return 1;
+}
+
+/**
+ * @brief "ml" engine: multilevel coarsen-solve-refine. W is coarsened by heavy-edge matching (each row paired with its
+ *        heaviest unmatched neighbour; a pair's rows and columns are summed) until ML_COARSE_ROWS rows remain. The
+ *        coarsest graph is solved with the "mu" loop from H0 restricted to it, and H is then interpolated back level
+ *        by level (a row gets its aggregate's row divided by the aggregate's size, since W_ab ≈ h_a h_b^T sums to
+ *        (sum h)(sum h)^T) and refined with at most ML_REFINE_ITERS multiplicative steps per level.
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n matrix.
+ * @param H0 Initial n×k matrix (summed over each aggregate to start the coarsest solve).
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @param stats Receives iterations and the final objective; may be NULL. iters counts the refinement steps on the
+ *        full W (at most ML_REFINE_ITERS) when W was coarsened, and the "mu" iterations on W itself when it was not
+ *        (n at most the coarse size, or the first matching stalled).
+ * @return 1 on success, -1 on failure.
+ * @note Costs a few O(n^2) passes to coarsen plus at most ML_REFINE_ITERS O(n^2 k) steps on the full W, instead of
+ *       the flat loop's (often 100+) steps.
+ */
+static int decomp_solve_ml(size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats) {
+    const double *Wl[ML_MAX_LEVELS + 1];
+    size_t nl[ML_MAX_LEVELS + 1], *map[ML_MAX_LEVELS], *size, levels = 0, nc, stop, i, j, l;
+    double *H = NULL, *Hc = NULL;
+    DecompStats coarse;
+    int failed = 0, iters = 0;
+
+    if (n == 0 || k == 0 || !W || !H0 || !out) return -1;
+    Wl[0] = W; nl[0] = n;
+    stop = (8 * k > ML_COARSE_ROWS) ? 8 * k : ML_COARSE_ROWS;
+
+    /* Step 1: coarsen until small enough or the matching stalls */
+    while (levels < ML_MAX_LEVELS && nl[levels] > stop) {
+        map[levels] = mat_alloc(nl[levels], 1, sizeof *map[levels], 0);
+        if (!map[levels]) {failed = 1; break;}
+        nc = ml_match(nl[levels], Wl[levels], map[levels]);
+        if ((double)nc > ML_MIN_SHRINK * (double)nl[levels] || nc < k) {free(map[levels]); break;}
+        Wl[levels + 1] = ml_coarsen(nl[levels], Wl[levels], nc, map[levels]);
+        if (!Wl[levels + 1]) {free(map[levels]); failed = 1; break;}
+        nl[++levels] = nc;
+    }
+
+    /* Step 2: restrict H0 (aggregate rows are sums) and solve the coarsest graph with the "mu" loop */
+    if (!failed) {H = mat_alloc(n, k, sizeof *H, 0); failed = !H;}
+    if (!failed) {memcpy(H, H0, n * k * sizeof *H);}
+    for (l = 0; l < levels && !failed; l++) {
+        Hc = mat_alloc(nl[l + 1], k, sizeof *Hc, 1);
+        if (!Hc) {failed = 1; break;}
+        for (i = 0; i < nl[l]; i++) {
+            for (j = 0; j < k; j++) {Hc[map[l][i] * k + j] += H[i * k + j];}
+        }
+        free(H); H = Hc;
+    }
+    if (!failed) {
+        Hc = NULL;
+        failed = decomp_solve_mu(nl[levels], k, Wl[levels], H, &Hc, &coarse) == -1;
+        free(H); H = Hc;
+        if (levels == 0) {iters = coarse.iters;} /* The coarsest graph is W: its solve is the whole run */
+    }
+
+    /* Step 3: interpolate level by level, refining each with a few multiplicative steps */
+    for (l = levels; l-- > 0 && !failed;) {
+        Hc = mat_alloc(nl[l], k, sizeof *Hc, 0);
+        size = mat_alloc(nl[l + 1], 1, sizeof *size, 1);
+        if (!Hc || !size) {free(Hc); free(size); failed = 1; break;}
+        for (i = 0; i < nl[l]; i++) {size[map[l][i]]++;}
+        for (i = 0; i < nl[l]; i++) {
+            for (j = 0; j < k; j++) {Hc[i * k + j] = H[map[l][i] * k + j] / (double)size[map[l][i]];}
+        }
+        free(size); free(H); H = Hc;
+        iters = ml_refine(nl[l], k, Wl[l], H, ML_REFINE_ITERS);
+        failed = iters == -1;
+    }
+
+    for (l = 0; l < levels; l++) {free(map[l]); free((double *)Wl[l + 1]);}
+    if (failed) {free(H); return -1;}
+    if (stats) {
+        stats->iters = iters;
+        stats->objective = decomp_objective(n, k, W, H);
+    }
+    *out = H; return 1;
+}
+
+/**
+ * @brief Heavy-edge matching: each unmatched row (in index order) is paired with its unmatched neighbour of largest W.
+ * @param n Number of rows in W.
+ * @param W Input n×n matrix.
+ * @param map Receives n aggregate indices in [0, return value) (caller-allocated).
+ * @return Number of aggregates (pairs and unmatched singletons).
+ */
+static size_t ml_match(size_t n, const double *W, size_t *map) {
+    size_t i, j, best, nc = 0, none = (size_t)-1;
+    double heaviest;
+
+    for (i = 0; i < n; i++) {map[i] = none;}
+    for (i = 0; i < n; i++) {
+        if (map[i] != none) {continue;}
+        best = none; heaviest = 0.0;
+        for (j = 0; j < n; j++) {
+            if (j != i && map[j] == none && W[i * n + j] > heaviest) {heaviest = W[i * n + j]; best = j;}
+        }
+        map[i] = nc;
+        if (best != none) {map[best] = nc;}
+        nc++;
+    }
+    return nc;
+}
+
+/**
+ * @brief Coarse graph of a matching: W_c[a][b] = sum of W[i][j] over rows i in aggregate a and columns j in b.
+ * @param n Number of rows in W.
+ * @param W Input n×n matrix.
+ * @param nc Number of aggregates.
+ * @param map n aggregate indices (ml_match).
+ * @return malloc'ed nc×nc coarse matrix (caller must free()), or NULL on allocation failure.
+ */
+static double *ml_coarsen(size_t n, const double *W, size_t nc, const size_t *map) {
+    double *Wc = mat_alloc(nc, nc, sizeof *Wc, 1);
+    size_t i, j;
+
+    if (!Wc) {return NULL;}
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {Wc[map[i] * nc + map[j]] += W[i * n + j];}
+    }
+    return Wc;
+}
+
+/**
+ * @brief At most iters damped multiplicative steps on H in place (H H^T H as H (H^T H)), stopping early on the EPS test.
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n matrix.
+ * @param H In: current n×k H; out: refined H.
+ * @param iters Max steps.
+ * @return Steps taken, or -1 on allocation failure.
+ */
+static int ml_refine(size_t n, size_t k, const double *W, double *H, int iters) {
+    double *WH = mat_alloc(n, k, sizeof *WH, 0), *Hn = mat_alloc(n, k, sizeof *Hn, 0), *G = mat_alloc(k, k, sizeof *G, 0);
+    double d, diff;
+    size_t i;
+    int it;
+
+    if (!WH || !Hn || !G) {free(WH); free(Hn); free(G); return -1;}
+    for (it = 0; it < iters; ++it) {
+        memset(WH, 0, n * k * sizeof *WH); /* W H */
+        kernels->gemm_acc(n, n, k, W, n, H, WH);
+        gram_mat(n, k, H, G);
+        decomp_mu_step(n, k, H, WH, G, Hn);
+        diff = 0.0;
+        for (i = 0; i < n * k; i++) {d = Hn[i] - H[i]; diff += d * d; H[i] = Hn[i];}
+        if (diff < EPS) {it++; break;}
+    }
+    free(WH); free(Hn); free(G);
+    return it;
+}
+
+/**
+ * @brief "mu-sparse" engine: decomp_mat_sparse with the non-zero tiles found by one scan of W.
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n matrix.
+ * @param H0 Initial n×k matrix.
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @param stats Receives iterations and final objective; may be NULL.
+ * @return 1 on success, -1 on failure.
+ */
+static int decomp_solve_mu_sparse(size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats) {
+    return decomp_mat_sparse(n, k, W, NULL, H0, out, stats);
+}
+
+/**
+ * @brief Damped multiplicative updates with W·H restricted to the SYM_TILE×SYM_TILE tiles of W listed by the
+ *        sym_pruned mask (or, without one, that hold a non-zero entry). Exact: skipped tiles contribute nothing. On
+ *        well-separated data in a locality-preserving order (sym_pruned tiles, morton_order) most tiles are zero.
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n matrix.
+ * @param mask Tile mask of the A that W was normalized from (sym_pruned), or NULL to scan W for non-zero tiles.
+ * @param H0 Initial n×k matrix.
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @param stats Receives iterations and final objective; may be NULL.
+ * @return 1 on success, -1 on failure.
+ * @note Same stopping rule as "mu"; H H^T H is evaluated as H (H^T H), so iterates match "mu" up to rounding.
+ *       A masked tile that underflowed to all zeros adds +0.0 to W·H, so H is the same with or without the mask.
+ */
+int decomp_mat_sparse(size_t n, size_t k, const double *W, const unsigned char *mask, const double *H0, double **out, DecompStats *stats) {
+    double *H, *Hn, *WH, *G, *tmp, d, diff;
+    size_t *ptr = NULL, *col = NULL, tiles, ti, t, i, i1, j0, j1;
+    int it;
+
+    if (n == 0 || k == 0 || !W || !H0 || !out) return -1;
+    H = mat_alloc(n, k, sizeof *H, 0); Hn = mat_alloc(n, k, sizeof *Hn, 0); WH = mat_alloc(n, k, sizeof *WH, 0);
+    G = mat_alloc(k, k, sizeof *G, 0);
+    if (!H || !Hn || !WH || !G || tile_index(n, W, mask, &ptr, &col) == -1) {free(H); free(Hn); free(WH); free(G); return -1;}
+    memcpy(H, H0, n * k * sizeof *H);
+    tiles = sym_tile_count(n);
+
+    for (it = 0; it < MAX_ITERS; ++it) {
+        memset(WH, 0, n * k * sizeof *WH); /* W H over the non-zero tiles */
+        for (ti = 0; ti < tiles; ti++) {
+            i1 = (ti * SYM_TILE + SYM_TILE < n) ? ti * SYM_TILE + SYM_TILE : n;
+            for (t = ptr[ti]; t < ptr[ti + 1]; t++) {
+                j0 = col[t] * SYM_TILE; j1 = (j0 + SYM_TILE < n) ? j0 + SYM_TILE : n;
+                kernels->gemm_acc(i1 - ti * SYM_TILE, j1 - j0, k, W + ti * SYM_TILE * n + j0, n, H + j0 * k, WH + ti * SYM_TILE * k);
+            }
+        }
+        gram_mat(n, k, H, G);
+        decomp_mu_step(n, k, H, WH, G, Hn);
+        diff = 0.0;
+        for (i = 0; i < n * k; i++) {d = Hn[i] - H[i]; diff += d * d;}
+        tmp = H; H = Hn; Hn = tmp;
+        if (diff < EPS) {break;}
+    }
+    if (stats) {
+        stats->iters = (it < MAX_ITERS) ? it + 1 : MAX_ITERS;
+        stats->objective = decomp_objective(n, k, W, H);
+    }
+    free(Hn); free(WH); free(G); free(ptr); free(col);
+    *out = H; return 1;
+}
+
+/**
+ * @brief Index of the live SYM_TILE×SYM_TILE tiles of W, per tile row (compressed sparse rows of tiles).
+ * @param n Number of rows in W.
+ * @param W Input n×n matrix (scanned only when mask is NULL).
+ * @param mask Tile mask from sym_pruned (its computed tiles are live), or NULL: the tiles holding a non-zero entry are.
+ * @param out_ptr Receives malloc'ed tiles+1 offsets: tile row ti owns (*out_col)[ptr[ti] .. ptr[ti+1]); caller must free().
+ * @param out_col Receives malloc'ed tile column indices; caller must free().
+ * @return 1 on success, -1 on allocation failure.
+ */
+static int tile_index(size_t n, const double *W, const unsigned char *mask, size_t **out_ptr, size_t **out_col) {
+    size_t tiles = sym_tile_count(n), *ptr, *col, ti, tj, i, i1, j, j1, count = 0;
+    int live;
+
+    ptr = mat_alloc(tiles + 1, 1, sizeof *ptr, 0); col = mat_alloc(tiles, tiles, sizeof *col, 0);
+    if (!ptr || !col) {free(ptr); free(col); return -1;}
+    for (ti = 0; ti < tiles; ti++) {
+        ptr[ti] = count;
+        i1 = (ti * SYM_TILE + SYM_TILE < n) ? ti * SYM_TILE + SYM_TILE : n;
+        for (tj = 0; tj < tiles; tj++) {
+            if (mask) {
+                if (mask[ti * tiles + tj]) {col[count++] = tj;}
+                continue;
+            }
+            j1 = (tj * SYM_TILE + SYM_TILE < n) ? tj * SYM_TILE + SYM_TILE : n;
+            for (i = ti * SYM_TILE, live = 0; i < i1 && !live; i++) {
+                for (j = tj * SYM_TILE; j < j1; j++) {
+                    if (W[i * n + j] != 0.0) {live = 1; break;}
+                }
+            }
+            if (live) {col[count++] = tj;}
+        }
+    }
+    ptr[tiles] = count;
+    *out_ptr = ptr; *out_col = col;
+    return 1;
+}
+
+/**
+ * @brief "mu-par" engine: decomp_mat_parallel on one thread per online core.
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n matrix.
+ * @param H0 Initial n×k matrix.
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @param stats Receives iterations and final objective; may be NULL.
+ * @return 1 on success, -1 on failure.
+ */
+static int decomp_solve_mu_par(size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats) {
+    return decomp_mat_parallel(n, k, W, H0, 0, out, stats);
+}
+
+/**
+ * @brief Damped multiplicative updates on a persistent pool of threads. The pool is created once per call; each
+ *        worker keeps the same row chunks of W and H for every iteration (and touches its rows of H first, so they
+ *        are placed on its NUMA node). An iteration is one pass per worker - W·H for its rows, the step
+ *        H (WH / H (H^T H)), the partial Gram matrix and diff of the new rows - followed by one barrier; every
+ *        worker then sums the per-chunk partials in chunk order, so all agree on H^T H and on the EPS test.
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n matrix.
+ * @param H0 Initial n×k matrix.
+ * @param threads Worker threads (the caller is one of them); <= 0 means one per online core.
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @param stats Receives iterations and final objective; may be NULL.
+ * @return 1 on success, -1 on failure.
+ * @note Same stopping rule as "mu"; H H^T H is evaluated as H (H^T H), so iterates match "mu" up to rounding.
+ *       Reductions run over fixed chunks in a fixed order: the result is identical for every thread count.
+ */
+int decomp_mat_parallel(size_t n, size_t k, const double *W, const double *H0, int threads, double **out, DecompStats *stats) {
+    MuPool pool;
+    MuWorker *workers = NULL;
+    pthread_t *tids = NULL;
+    int t, started;
+
+    if (n == 0 || k == 0 || !W || !H0 || !out) return -1;
+    threads = thread_count(threads);
+    pool.n = n; pool.k = k; pool.W = W; pool.H0 = H0;
+    pool.nchunks = (n + MU_PAR_ROWS - 1) / MU_PAR_ROWS;
+    if ((size_t)threads > pool.nchunks) {threads = (int)pool.nchunks;}
+
+    /* Step 1: buffers; left untouched here so that each worker's rows are first written by that worker */
+    pool.H[0] = mat_alloc(n, k, sizeof *pool.H[0], 0); pool.H[1] = mat_alloc(n, k, sizeof *pool.H[1], 0);
+    pool.gram[0] = mat_alloc(pool.nchunks, k * k, sizeof *pool.gram[0], 0); pool.gram[1] = mat_alloc(pool.nchunks, k * k, sizeof *pool.gram[1], 0);
+    pool.diff[0] = mat_alloc(pool.nchunks, 1, sizeof *pool.diff[0], 0); pool.diff[1] = mat_alloc(pool.nchunks, 1, sizeof *pool.diff[1], 0);
+    pool.scratch = mat_alloc((size_t)threads, k * (k + MU_PAR_ROWS), sizeof *pool.scratch, 0);
+    workers = mat_alloc((size_t)threads, 1, sizeof *workers, 0); tids = mat_alloc((size_t)threads, 1, sizeof *tids, 0);
+    if (!pool.H[0] || !pool.H[1] || !pool.gram[0] || !pool.gram[1] || !pool.diff[0] || !pool.diff[1] || !pool.scratch || !workers || !tids
+        || barrier_init(&pool.barrier, threads) == -1) {
+        free(pool.H[0]); free(pool.H[1]); free(pool.gram[0]); free(pool.gram[1]); free(pool.diff[0]); free(pool.diff[1]);
+        free(pool.scratch); free(workers); free(tids); return -1;
+    }
+
+    /* Step 2: spawn while holding the barrier lock, so workers wait at the start gate until the final count is set */
+    pthread_mutex_lock(&pool.barrier.lock);
+    for (t = 0; t < threads; t++) {workers[t].pool = &pool; workers[t].id = t;}
+    for (started = 1; started < threads; started++) {
+        if (pthread_create(&tids[started], NULL, mu_par_worker, &workers[started]) != 0) {break;}
+    }
+    pool.threads = started; pool.barrier.count = started; /* fewer threads if a spawn failed: chunks are re-split */
+    pthread_mutex_unlock(&pool.barrier.lock);
+    mu_par_worker(&workers[0]);
+    for (t = 1; t < started; t++) {pthread_join(tids[t], NULL);}
+
+    /* Step 3: keep the final buffer, release the rest */
+    barrier_destroy(&pool.barrier);
+    free(pool.H[1 - pool.last]); free(pool.gram[0]); free(pool.gram[1]); free(pool.diff[0]); free(pool.diff[1]);
+    free(pool.scratch); free(workers); free(tids);
+    if (stats) {
+        stats->iters = pool.iters;
+        stats->objective = decomp_objective(n, k, W, pool.H[pool.last]);
+    }
+    *out = pool.H[pool.last]; return 1;
+}
+
+/**
+ * @brief Body of one "mu-par" worker: start gate, copy of its H0 rows, then the iterations (one barrier each).
+ * @param arg MuWorker* of this thread.
+ * @return NULL.
+ * @note Buffers are double-buffered by parity, so a worker that has passed the barrier may write iteration t+1's
+ *       partials while a slower one still sums iteration t's.
+ */
+static void *mu_par_worker(void *arg) {
+    MuWorker *self = arg;
+    MuPool *p = self->pool;
+    size_t n = p->n, k = p->k, c, c_lo, c_hi, r0, r1, i, l;
+    double *G, *WH, *Hc, *Hn, d, diff;
+    int it, cur = 0;
+
+    barrier_wait(&p->barrier); /* start gate: p->threads is final */
+    c_lo = p->nchunks * (size_t)self->id / (size_t)p->threads;
+    c_hi = p->nchunks * ((size_t)self->id + 1) / (size_t)p->threads;
+    G = p->scratch + (size_t)self->id * (k * k + MU_PAR_ROWS * k); WH = G + k * k;
+    for (c = c_lo; c < c_hi; c++) { /* H(0) rows of own chunks (first touch), and their partial Gram */
+        r0 = c * MU_PAR_ROWS; r1 = (r0 + MU_PAR_ROWS < n) ? r0 + MU_PAR_ROWS : n;
+        memcpy(p->H[0] + r0 * k, p->H0 + r0 * k, (r1 - r0) * k * sizeof *p->H[0]);
+        memset(p->H[1] + r0 * k, 0, (r1 - r0) * k * sizeof *p->H[1]);
+        gram_mat(r1 - r0, k, p->H[0] + r0 * k, p->gram[0] + c * k * k);
+    }
+    barrier_wait(&p->barrier);
+
+    for (it = 0; it < MAX_ITERS; ++it) {
+        memset(G, 0, k * k * sizeof *G); /* H^T H = sum of the chunk partials, in chunk order */
+        for (c = 0; c < p->nchunks; c++) {
+            for (l = 0; l < k * k; l++) {G[l] += p->gram[cur][c * k * k + l];}
+        }
+        Hc = p->H[cur]; Hn = p->H[1 - cur];
+        for (c = c_lo; c < c_hi; c++) {
+            r0 = c * MU_PAR_ROWS; r1 = (r0 + MU_PAR_ROWS < n) ? r0 + MU_PAR_ROWS : n;
+            memset(WH, 0, (r1 - r0) * k * sizeof *WH); /* (W H) rows of this chunk */
+            kernels->gemm_acc(r1 - r0, n, k, p->W + r0 * n, n, Hc, WH);
+            decomp_mu_step(r1 - r0, k, Hc + r0 * k, WH, G, Hn + r0 * k);
+            gram_mat(r1 - r0, k, Hn + r0 * k, p->gram[1 - cur] + c * k * k);
+            diff = 0.0;
+            for (i = r0 * k; i < r1 * k; i++) {d = Hn[i] - Hc[i]; diff += d * d;}
+            p->diff[1 - cur][c] = diff;
+        }
+        barrier_wait(&p->barrier);
+        cur = 1 - cur;
+        diff = 0.0; /* every worker sums the same partials in the same order: all take the same branch */
+        for (c = 0; c < p->nchunks; c++) {diff += p->diff[cur][c];}
+        if (diff < EPS) {break;}
+    }
+    if (self->id == 0) {p->iters = (it < MAX_ITERS) ? it + 1 : MAX_ITERS; p->last = cur;}
+    return NULL;
+}
+
+/**
+ * @brief Initialize a barrier for count threads.
+ * @param b Barrier to initialize.
+ * @param count Threads taking part (may be lowered under b->lock before anyone waits).
+ * @return 1 on success, -1 on failure.
+ */
+static int barrier_init(Barrier *b, int count) {
+    if (pthread_mutex_init(&b->lock, NULL) != 0) {return -1;}
+    if (pthread_cond_init(&b->cond, NULL) != 0) {pthread_mutex_destroy(&b->lock); return -1;}
+    b->count = count; b->waiting = 0; b->generation = 0;
+    return 1;
+}
+
+/**
+ * @brief Block until all b->count threads have called barrier_wait for the current generation.
+ * @param b Barrier.
+ */
+static void barrier_wait(Barrier *b) {
+    unsigned long generation;
+
+    pthread_mutex_lock(&b->lock);
+    generation = b->generation;
+    if (++b->waiting == b->count) {b->waiting = 0; b->generation++; pthread_cond_broadcast(&b->cond);}
+    else {
+        while (generation == b->generation) {pthread_cond_wait(&b->cond, &b->lock);}
+    }
+    pthread_mutex_unlock(&b->lock);
+}
+
+/**
+ * @brief Release a barrier's mutex and condition variable.
+ * @param b Barrier (no thread may be waiting).
+ */
+static void barrier_destroy(Barrier *b) {
+    pthread_cond_destroy(&b->cond);
+    pthread_mutex_destroy(&b->lock);
+}
+
+/**
+ * @brief "cd" engine: cyclic coordinate descent, each H_ij set to the exact non-negative minimizer of ||W - H H^T||_F^2.
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n symmetric matrix.
+ * @param H0 Initial n×k matrix.
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @param stats Receives sweeps and final objective; may be NULL.
+ * @return 1 on success, -1 on failure.
+ * @note Caches W·H and H^T H: moving H_ij by s is a quartic in s whose stationary points solve
+ *       x^3 + a x + b = 0 (x = H_ij + s), and the caches are patched in O(n + k). One sweep costs O(n^2 k),
+ *       like one "mu" iteration, but converges in far fewer sweeps.
+ */
+static int decomp_solve_cd(size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats) {
+    double *H, *WH = NULL, *G;
+    size_t i, j, l;
+    int it;
+    double h, x, s, hg, q, p, row_sq, diff;
+
+    if (n == 0 || k == 0 || !W || !H0 || !out) return -1;
+    H = mat_alloc(n, k, sizeof *H, 0); G = mat_alloc(k, k, sizeof *G, 0);
+    if (!H || !G || mat_mul(n, n, k, W, H0, &WH) == -1) {free(H); free(G); return -1;} /* W H (n×k) */
+    memcpy(H, H0, n * k * sizeof *H);
+    gram_mat(n, k, H, G);
+
+    for (it = 0; it < MAX_ITERS; ++it) {
+        diff = 0.0;
+        for (i = 0; i < n; i++) {
+            row_sq = 0.0;
+            for (l = 0; l < k; l++) {row_sq += H[i * k + l] * H[i * k + l];}
+            for (j = 0; j < k; j++) {
+                h = H[i * k + j];
+                hg = 0.0; /* (H H^T H)_ij = (H G)_ij */
+                for (l = 0; l < k; l++) {hg += H[i * k + l] * G[l * k + j];}
+                q = WH[i * k + j] - hg; /* ((W - H H^T) h_j)_i */
+                p = G[j * k + j] + h * h - (W[i * n + i] - row_sq);
+                x = cd_best_coord(p - 3.0 * h * h, 2.0 * h * h * h - p * h - q);
+                s = x - h;
+                if (s == 0.0) {continue;}
+
+                H[i * k + j] = x; /* Patch the caches for H_ij += s */
+                for (l = 0; l < n; l++) {WH[l * k + j] += s * W[l * n + i];}
+                for (l = 0; l < k; l++) {
+                    if (l == j) {continue;}
+                    G[j * k + l] += s * H[i * k + l];
+                    G[l * k + j] = G[j * k + l];
+                }
+                G[j * k + j] += 2.0 * s * h + s * s;
+                row_sq += x * x - h * h;
+                diff += s * s;
+            }
+        }
+        if (diff < EPS) {break;}
+    }
+    free(WH); free(G);
+    if (stats) {
+        stats->iters = (it < MAX_ITERS) ? it + 1 : MAX_ITERS;
+        stats->objective = decomp_objective(n, k, W, H);
+    }
+    *out = H; return 1;
+}
+
+/**
+ * @brief Non-negative minimizer of phi(x) = x^4/4 + a x^2/2 + b x (phi' = x^3 + a x + b).
+ * @param a Linear coefficient of the depressed cubic.
+ * @param b Constant coefficient of the depressed cubic.
+ * @return Best of x = 0 and the non-negative real roots (Cardano / trigonometric form).
+ */
+static double cd_best_coord(double a, double b) {
+    double roots[3], disc, sq, m, angle, x, val, best = 0.0, best_val = 0.0;
+    int count, r;
+
+    disc = (b / 2.0) * (b / 2.0) + (a / 3.0) * (a / 3.0) * (a / 3.0);
+    if (disc >= 0.0 || a >= 0.0) { /* One real root */
+        sq = sqrt(disc > 0.0 ? disc : 0.0);
+        roots[0] = cube_root(-b / 2.0 + sq) + cube_root(-b / 2.0 - sq);
+        count = 1;
+    }
+    else { /* Three real roots */
+        m = 2.0 * sqrt(-a / 3.0);
+        angle = 3.0 * b / (a * m); /* (3b / 2a) sqrt(-3/a) */
+        if (angle > 1.0) angle = 1.0;
+        if (angle < -1.0) angle = -1.0;
+        angle = acos(angle) / 3.0;
+        for (r = 0; r < 3; r++) {roots[r] = m * cos(angle - 2.0 * PI * r / 3.0);}
+        count = 3;
+    }
+    for (r = 0; r < count; r++) {
+        x = roots[r];
+        if (x <= 0.0) {continue;}
+        val = x * x * x * x / 4.0 + a * x * x / 2.0 + b * x;
+        if (val < best_val) {best_val = val; best = x;}
+    }
+    return best;
+}
+
+/**
+ * @brief Real cube root (C90 has no cbrt).
+ * @param x Input value.
+ * @return Cube root of x, with the sign of x.
+ */
+static double cube_root(double x) {
+    return (x < 0.0) ? -pow(-x, 1.0 / 3.0) : pow(x, 1.0 / 3.0);
+}
+
+/**
+ * @brief SymNMF objective ||W - H H^T||_F^2.
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n matrix.
+ * @param H Input n×k matrix.
+ * @return The squared Frobenius residual (O(n^2 k)).
+ */
+static double decomp_objective(size_t n, size_t k, const double *W, const double *H) {
+    size_t i, j, l;
+    double total = 0.0, approx, r;
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            approx = 0.0;
+            for (l = 0; l < k; l++) {approx += H[i * k + l] * H[j * k + l];}
+            r = W[i * n + j] - approx;
+            total += r * r;
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief One update step for H using W and current H (with EPS/BETA safeguards).
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n matrix.
+ * @param H Current n×k matrix.
+ * @param out_H Receives malloc'ed n×k updated H; caller must free().
+ * @return 1 on success, -1 on failure.
+ */
+static int update_decomp_mat(size_t n, size_t k, const double *W, const double *H, double **out_H) {
+    double *H_T = NULL, *tmp1 = NULL, *tmp2 = NULL, *tmp3 = NULL, *H_t_plus1 = NULL;
+    size_t i, j;
+
+    if (n == 0 || k == 0 || !W || !H || !out_H) return -1;
+
+    if (mat_transpose(n, k, H, &H_T) == -1) {return -1;} /* H^T (kxn) */
+    if (mat_mul(n, k, n, H, H_T, &tmp1) == -1) {free(H_T); return -1;} /* (H H^T) (n×n) */
+    if (mat_mul(n, n, k, tmp1, H, &tmp2) == -1) {free(H_T); free(tmp1); return -1;} /* (H H^T) H (n×k) */
+    free(H_T); free(tmp1);
+
+    for (i = 0; i < n; i++) { /* Ensure not dividing by zero - if cell == 0 -> turn to EPS */
+        for (j = 0; j < k; j++) {
+            if (tmp2[i * k + j] == 0.0) {tmp2[i * k + j] = EPS;}
         }
     }
     if (mat_mul(n, n, k, W, H, &tmp3) == -1) {free(tmp2); return -1;} /* W H (n×k) */
-    H_t_plus1 = malloc(n * k * sizeof *H_t_plus1);
+    H_t_plus1 = mat_alloc(n, k, sizeof *H_t_plus1, 0);
     if (!H_t_plus1) {free(tmp2); free(tmp3); return -1;}
 
     for (i = 0; i < n; i++) {  /* Calculate H(t+1) */
         for (j = 0; j < k; j++) {
-            H_t_plus1[i * k + j] = H[i * k + j] * ((1.0 - BETA) + BETA * (tmp3[i * k + j] / tmp2[i * k + j]));
+            H_t_plus1[i * k + j] = H[i * k + j] * ((1.0 - BETA) + BETA * (tmp3[i * k + j] / tmp2[i * k + j]));
+        }
+    }
+    free(tmp2); free(tmp3);
+    *out_H = H_t_plus1;
+    return 1;
+}
+
+ /**
+ * @brief Multiply two matrices: A(rows×m) and B(m×cols).
+ * @param rows Number of rows in A.
+ * @param m Shared dimension of A and B.
+ * @param cols Number of columns in B.
+ * @param A Left matrix (rows×m).
+ * @param B Right matrix (m×cols).
+ * @param out Receives malloc'ed rows×cols result; caller must free().
+ * @return 1 on success, -1 on invalid args or allocation failure.
+ */
+static int mat_mul(size_t rows, size_t m, size_t cols, const double *A, const double *B, double **out) {
+    double *C;
+
+    if (rows == 0 || m == 0 || cols == 0 || !A || !B || !out) {return -1;}
+    C = mat_alloc(rows, cols, sizeof *C, 1);
+    if (!C) {return -1;}
+
+    kernels->gemm_acc(rows, m, cols, A, m, B, C);
+    *out = C;
+    return 1;
+}
+
+/**
+ * @brief Select the kernel set once at startup: the widest level the CPU supports (CPUID via __builtin_cpu_supports),
+ *        or the level named by the SYMNMF_ISA environment variable ("avx512", "avx2", "generic") if the CPU has it.
+ *        Logs the choice to stderr. Until it runs, the generic kernels are used.
+ * @return Name of the selected set.
+ * @note Every set gives the same results bit for bit, so the override is for testing and timing only.
+ */
+const char *isa_select(void) {
+    const char *want = getenv("SYMNMF_ISA");
+    size_t s, from = 0;
+
+    if (want && *want == '\0') {want = NULL;}
+    for (s = 0; want && s < KERNEL_SET_COUNT; s++) {
+        if (strcmp(want, KERNEL_SETS[s].name) == 0) {from = s; break;}
+    }
+    for (s = from; s < KERNEL_SET_COUNT - 1 && !isa_supported(KERNEL_SETS[s].name); s++) {}
+    kernels = KERNEL_SETS + s;
+    fprintf(stderr, "symnmf: %s kernels", kernels->name);
+    if (want && strcmp(want, kernels->name) != 0) {fprintf(stderr, " (SYMNMF_ISA=%s not available)", want);}
+    fprintf(stderr, "\n");
+    return kernels->name;
+}
+
+/**
+ * @brief Whether this CPU (and OS) can run a kernel set.
+ * @param name Set name.
+ * @return Non-zero if supported.
+ */
+static int isa_supported(const char *name) {
+#ifdef SYMNMF_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "avx512") == 0) {return __builtin_cpu_supports("avx512f");}
+    if (strcmp(name, "avx2") == 0) {return __builtin_cpu_supports("avx2");}
+#endif
+    return strcmp(name, "generic") == 0;
+}
+
+/**
+ * @brief C += A·B with plain loops: A is rows×m with row stride lda, B is m×cols, C is rows×cols (row-major).
+ *        Each entry of C adds its m products in order j = 0..m-1; the vector variants keep that order (and use no
+ *        fused multiply-add), so every kernel set gives the same C bit for bit.
+ * @param rows Rows of A and C.
+ * @param m Columns of A, rows of B.
+ * @param cols Columns of B and C.
+ * @param A Left matrix.
+ * @param lda Row stride of A (>= m).
+ * @param B Right matrix.
+ * @param C Accumulator, updated in place.
+ */
+static void gemm_acc_generic(size_t rows, size_t m, size_t cols, const double *A, size_t lda, const double *B, double *C) {
+    size_t i, j, l;
+    double a;
+
+    for (i = 0; i < rows; ++i) {
+        for (j = 0; j < m; ++j) {
+            a = A[i * lda + j];
+            for (l = 0; l < cols; ++l) {
+                C[i * cols + l] += a * B[j * cols + l];
+            }
+        }
+    }
+}
+
+#ifdef SYMNMF_X86
+/**
+ * @brief gemm_acc_generic with AVX2: blocks of 4 rows × 4 columns of C stay in registers while j runs over m
+ *        (masked loads/stores for the last columns). Same summation order per entry and no fused multiply-add
+ *        (fp-contract=off even where the target has FMA), so the same C.
+ * @param rows Rows of A and C.
+ * @param m Columns of A, rows of B.
+ * @param cols Columns of B and C.
+ * @param A Left matrix.
+ * @param lda Row stride of A (>= m).
+ * @param B Right matrix.
+ * @param C Accumulator, updated in place.
+ */
+__attribute__((target("avx2"), optimize("fp-contract=off")))
+static void gemm_acc_avx2(size_t rows, size_t m, size_t cols, const double *A, size_t lda, const double *B, double *C) {
+    size_t i, j, l, w;
+    __m256i mask;
+    __m256d b, c0, c1, c2, c3;
+    const double *a0, *a1, *a2, *a3;
+
+    for (i = 0; i + 4 <= rows; i += 4) { /* the 4 rows of A are reused from cache for every column block */
+        a0 = A + i * lda; a1 = a0 + lda; a2 = a1 + lda; a3 = a2 + lda;
+        for (l = 0; l < cols; l += 4) {
+            w = (cols - l < 4) ? cols - l : 4;
+            mask = _mm256_set_epi64x(w > 3 ? -1 : 0, w > 2 ? -1 : 0, w > 1 ? -1 : 0, -1);
+            c0 = _mm256_maskload_pd(C + i * cols + l, mask); c1 = _mm256_maskload_pd(C + (i + 1) * cols + l, mask);
+            c2 = _mm256_maskload_pd(C + (i + 2) * cols + l, mask); c3 = _mm256_maskload_pd(C + (i + 3) * cols + l, mask);
+            for (j = 0; j < m; j++) {
+                b = _mm256_maskload_pd(B + j * cols + l, mask);
+                c0 = _mm256_add_pd(c0, _mm256_mul_pd(_mm256_set1_pd(a0[j]), b));
+                c1 = _mm256_add_pd(c1, _mm256_mul_pd(_mm256_set1_pd(a1[j]), b));
+                c2 = _mm256_add_pd(c2, _mm256_mul_pd(_mm256_set1_pd(a2[j]), b));
+                c3 = _mm256_add_pd(c3, _mm256_mul_pd(_mm256_set1_pd(a3[j]), b));
+            }
+            _mm256_maskstore_pd(C + i * cols + l, mask, c0); _mm256_maskstore_pd(C + (i + 1) * cols + l, mask, c1);
+            _mm256_maskstore_pd(C + (i + 2) * cols + l, mask, c2); _mm256_maskstore_pd(C + (i + 3) * cols + l, mask, c3);
+        }
+    }
+    for (; i < rows; i++) { /* the last rows % 4 rows */
+        a0 = A + i * lda;
+        for (l = 0; l < cols; l += 4) {
+            w = (cols - l < 4) ? cols - l : 4;
+            mask = _mm256_set_epi64x(w > 3 ? -1 : 0, w > 2 ? -1 : 0, w > 1 ? -1 : 0, -1);
+            c0 = _mm256_maskload_pd(C + i * cols + l, mask);
+            for (j = 0; j < m; j++) {c0 = _mm256_add_pd(c0, _mm256_mul_pd(_mm256_set1_pd(a0[j]), _mm256_maskload_pd(B + j * cols + l, mask)));}
+            _mm256_maskstore_pd(C + i * cols + l, mask, c0);
+        }
+    }
+}
+
+/**
+ * @brief gemm_acc_generic with AVX-512: blocks of 4 rows × 8 columns of C stay in registers while j runs over m
+ *        (masked loads/stores for the last columns). Same summation order per entry and no fused multiply-add
+ *        (fp-contract=off even where the target has FMA), so the same C.
+ * @param rows Rows of A and C.
+ * @param m Columns of A, rows of B.
+ * @param cols Columns of B and C.
+ * @param A Left matrix.
+ * @param lda Row stride of A (>= m).
+ * @param B Right matrix.
+ * @param C Accumulator, updated in place.
+ */
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+static void gemm_acc_avx512(size_t rows, size_t m, size_t cols, const double *A, size_t lda, const double *B, double *C) {
+    size_t i, j, l, w;
+    __mmask8 mask;
+    __m512d b, c0, c1, c2, c3;
+    const double *a0, *a1, *a2, *a3;
+
+    for (i = 0; i + 4 <= rows; i += 4) { /* the 4 rows of A are reused from cache for every column block */
+        a0 = A + i * lda; a1 = a0 + lda; a2 = a1 + lda; a3 = a2 + lda;
+        for (l = 0; l < cols; l += 8) {
+            w = (cols - l < 8) ? cols - l : 8;
+            mask = (__mmask8)((1u << w) - 1u);
+            c0 = _mm512_maskz_loadu_pd(mask, C + i * cols + l); c1 = _mm512_maskz_loadu_pd(mask, C + (i + 1) * cols + l);
+            c2 = _mm512_maskz_loadu_pd(mask, C + (i + 2) * cols + l); c3 = _mm512_maskz_loadu_pd(mask, C + (i + 3) * cols + l);
+            for (j = 0; j < m; j++) {
+                b = _mm512_maskz_loadu_pd(mask, B + j * cols + l);
+                c0 = _mm512_add_pd(c0, _mm512_mul_pd(_mm512_set1_pd(a0[j]), b));
+                c1 = _mm512_add_pd(c1, _mm512_mul_pd(_mm512_set1_pd(a1[j]), b));
+                c2 = _mm512_add_pd(c2, _mm512_mul_pd(_mm512_set1_pd(a2[j]), b));
+                c3 = _mm512_add_pd(c3, _mm512_mul_pd(_mm512_set1_pd(a3[j]), b));
+            }
+            _mm512_mask_storeu_pd(C + i * cols + l, mask, c0); _mm512_mask_storeu_pd(C + (i + 1) * cols + l, mask, c1);
+            _mm512_mask_storeu_pd(C + (i + 2) * cols + l, mask, c2); _mm512_mask_storeu_pd(C + (i + 3) * cols + l, mask, c3);
+        }
+    }
+    for (; i < rows; i++) { /* the last rows % 4 rows */
+        a0 = A + i * lda;
+        for (l = 0; l < cols; l += 8) {
+            w = (cols - l < 8) ? cols - l : 8;
+            mask = (__mmask8)((1u << w) - 1u);
+            c0 = _mm512_maskz_loadu_pd(mask, C + i * cols + l);
+            for (j = 0; j < m; j++) {c0 = _mm512_add_pd(c0, _mm512_mul_pd(_mm512_set1_pd(a0[j]), _mm512_maskz_loadu_pd(mask, B + j * cols + l)));}
+            _mm512_mask_storeu_pd(C + i * cols + l, mask, c0);
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Compute transpose of a rows×cols matrix.
+ * @param rows Number of rows in input.
+ * @param cols Number of columns in input.
+ * @param mat Input matrix.
+ * @param out Receives malloc'ed cols×rows result; caller must free().
+ * @return 1 on success, -1 on allocation failure.
+ */
+static int mat_transpose(size_t rows, size_t cols, const double *mat, double **out) {
+    double *res;
+    size_t i, j;
+
+    res = mat_alloc(rows, cols, sizeof *res, 0);
+    if (!res) {return -1;}
+    for (i = 0; i < rows; ++i) {
+        for (j = 0; j < cols; ++j) {
+            res[j * rows + i] = mat[i * cols + j];
+        }
+    }
+
+    *out = res;
+    return 1;
+}
+
+/**
+ * @brief Allocate a rows×cols array, failing instead of wrapping around when the byte size overflows size_t.
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @param elem_size Size of one entry in bytes.
+ * @param zeroed Non-zero to zero-fill (calloc semantics).
+ * @return Pointer to release with free(), or NULL on overflow or allocation failure.
+ */
+void *mat_alloc(size_t rows, size_t cols, size_t elem_size, int zeroed) {
+    size_t max_count = (size_t)-1;
+
+    if (rows == 0 || cols == 0 || elem_size == 0) {return NULL;}
+    if (cols > max_count / elem_size || rows > max_count / elem_size / cols) {return NULL;} /* rows * cols * elem_size would wrap */
+    return zeroed ? calloc(rows * cols, elem_size) : malloc(rows * cols * elem_size);
+}
+
+/**
+ * @brief Print an n×n matrix of doubles with 4 decimal places.
+ * @param n Matrix dimension.
+ * @param mat Input square matrix.
+ */
+void print_squared_matrix_floats_4f(size_t n, const double *mat) {
+    print_matrix_floats_4f(n, n, mat);
+}
+
+/**
+ * @brief Print a rows×cols matrix with 4 decimals, comma-separated, one row per line.
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @param mat Matrix to print.
+ */
+static void print_matrix_floats_4f(size_t rows, size_t cols, const double *mat) {
+    size_t i, j;
+
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            printf("%.4f", mat[i * cols + j]);
+            if (j == cols - 1) {printf("\n");}
+            else {printf(",");}
+        }
+    }
+}
+
+/**
+ * @brief Build a fitted model from training points and their final H (copies both, computes degrees once).
+ * @param dim Point dimension.
+ * @param n Number of training points.
+ * @param k Number of columns in H.
+ * @param points Input n×dim training points.
+ * @param H Input n×k fitted decomposition.
+ * @param out_model Receives malloc'ed model; caller must model_free().
+ * @return 1 on success, -1 on invalid args or allocation failure.
+ */
+int model_create(size_t dim, size_t n, size_t k, const double *points, const double *H, SymnmfModel **out_model) {
+    SymnmfModel *model;
+    size_t i, j, l;
+    double entry;
+    SymEntryKernel entry_of = sym_entry_kernel(dim);
+
+    if (dim == 0 || n == 0 || k == 0 || !points || !H || !out_model) {return -1;}
+    model = calloc(1, sizeof *model);
+    if (!model) {return -1;}
+    model->n = n; model->dim = dim; model->k = k;
+    model->points = mat_alloc(n, dim, sizeof *model->points, 0);
+    model->degrees = calloc(n, sizeof *model->degrees);
+    model->H = mat_alloc(n, k, sizeof *model->H, 0);
+    model->gram = mat_alloc(k, k, sizeof *model->gram, 1);
+    if (!model->points || !model->degrees || !model->H || !model->gram) {model_free(model); return -1;}
+    memcpy(model->points, points, n * dim * sizeof *model->points);
+    memcpy(model->H, H, n * k * sizeof *model->H);
+
+    for (i = 0; i < n; i++) { /* Degrees = row sums of A, without keeping the n×n matrix */
+        for (j = i + 1; j < n; j++) {
+            entry = entry_of(points + i * dim, points + j * dim, dim);
+            model->degrees[i] += entry;
+            model->degrees[j] += entry;
+        }
+    }
+    for (i = 0; i < n; i++) { /* Gram matrix H^T H (k×k), reused by every projection */
+        for (j = 0; j < k; j++) {
+            for (l = 0; l < k; l++) {model->gram[j * k + l] += H[i * k + j] * H[i * k + l];}
+        }
+    }
+    *out_model = model;
+    return 1;
+}
+
+/**
+ * @brief Project a new point onto a fitted model: w = D^(-1/2)-normalized affinities, h = argmin_{h>=0} ||w - H h||^2.
+ * @param model Fitted model.
+ * @param point New point (length model->dim).
+ * @param neighbors Use only the `neighbors` most similar training points (0 = all).
+ * @param out_h Receives the H row (length model->k, caller-allocated); may be NULL.
+ * @param out_label Receives the argmax of the H row.
+ * @return 1 on success, -1 on invalid args or allocation failure.
+ * @note Cost is O(n·dim + n·k) for the affinities and O(k^2) per NNLS sweep.
+ */
+int model_project(const SymnmfModel *model, const double *point, size_t neighbors, double *out_h, size_t *out_label) {
+    double *aff, *b, *h;
+    size_t *idx;
+    size_t n, k, m, i, j, l, best;
+    int it;
+    double d_x, d_j, w, g, next, moved;
+    SymEntryKernel entry_of;
+
+    if (!model || !point || !out_label) {return -1;}
+    n = model->n; k = model->k;
+    entry_of = sym_entry_kernel(model->dim);
+    m = (neighbors > 0 && neighbors < n) ? neighbors : n;
+    aff = malloc(n * sizeof *aff); idx = malloc(n * sizeof *idx);
+    b = calloc(k, sizeof *b); h = calloc(k, sizeof *h);
+    if (!aff || !idx || !b || !h) {free(aff); free(idx); free(b); free(h); return -1;}
+
+    for (i = 0; i < n; i++) { /* Affinities of the new point to every training point */
+        aff[i] = entry_of(point, model->points + i * model->dim, model->dim);
+        idx[i] = i;
+    }
+    if (m < n) {select_top(n, aff, m, idx);} /* idx[0..m-1] <- nearest neighbours */
+
+    d_x = 0.0;
+    for (i = 0; i < m; i++) {d_x += aff[idx[i]];}
+    if (d_x == 0) d_x = EPS;
+    for (i = 0; i < m; i++) { /* b = H^T w, with w_j = a_j / sqrt(d_x d_j) */
+        j = idx[i];
+        d_j = model->degrees[j];
+        if (d_j == 0) d_j = EPS;
+        w = aff[j] / sqrt(d_x * d_j);
+        for (l = 0; l < k; l++) {b[l] += w * model->H[j * k + l];}
+    }
+    free(aff); free(idx);
+
+    for (it = 0; it < PROJ_ITERS; it++) { /* Projected coordinate descent on (H^T H) h = H^T w, h >= 0 */
+        moved = 0.0;
+        for (j = 0; j < k; j++) {
+            if (model->gram[j * k + j] <= 0.0) {continue;}
+            g = b[j];
+            for (l = 0; l < k; l++) {g -= model->gram[j * k + l] * h[l];}
+            next = h[j] + g / model->gram[j * k + j];
+            if (next < 0.0) {next = 0.0;}
+            moved += (next - h[j]) * (next - h[j]);
+            h[j] = next;
         }
+        if (moved < PROJ_EPS) {break;}
     }
-    free(tmp2); free(tmp3);
-    *out_H = H_t_plus1;
+
+    best = 0;
+    for (j = 1; j < k; j++) {if (h[j] > h[best]) best = j;}
+    if (out_h) {memcpy(out_h, h, k * sizeof *h);}
+    *out_label = best;
+    free(b); free(h);
     return 1;
 }
 
- /**
- * @brief Multiply two matrices: A(rows×m) and B(m×cols).
- * @param rows Number of rows in A.
- * @param m Shared dimension of A and B.
- * @param cols Number of columns in B.
- * @param A Left matrix (rows×m).
- * @param B Right matrix (m×cols).
- * @param out Receives malloc'ed rows×cols result; caller must free().
+/**
+ * @brief Free a model returned by model_create (NULL is ignored).
+ * @param model Model to free.
+ */
+void model_free(SymnmfModel *model) {
+    if (!model) return;
+    free(model->points); free(model->degrees); free(model->H); free(model->gram);
+    free(model);
+}
+
+/**
+ * @brief Partially reorder idx so that idx[0..m-1] index the m largest vals (quickselect).
+ * @param n Length of vals and idx.
+ * @param vals Values to rank.
+ * @param m Number of largest values to move to the front (1 <= m <= n).
+ * @param idx In/out: permutation of 0..n-1.
+ */
+static void select_top(size_t n, const double *vals, size_t m, size_t *idx) {
+    ptrdiff_t lo = 0, hi = (ptrdiff_t)n - 1, i, j;
+    size_t tmp;
+    double pivot;
+
+    while (lo < hi) {
+        pivot = vals[idx[lo + (hi - lo) / 2]];
+        i = lo; j = hi;
+        while (i <= j) { /* Partition descending around pivot */
+            while (vals[idx[i]] > pivot) {i++;}
+            while (vals[idx[j]] < pivot) {j--;}
+            if (i <= j) {tmp = idx[i]; idx[i] = idx[j]; idx[j] = tmp; i++; j--;}
+        }
+        if ((ptrdiff_t)m - 1 <= j) {hi = j;}
+        else if ((ptrdiff_t)m - 1 >= i) {lo = i;}
+        else {break;}
+    }
+}
+
+/**
+ * @brief Order points along a Morton (Z-order) curve: each coordinate is quantized to `bits` levels over the bounding
+ *        box, the bits are interleaved into one key (most significant bit of every coordinate first), and the points
+ *        are sorted by key. Nearby points get nearby positions, so W computed in this order is close to block-diagonal.
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param mat Input n×dim points.
+ * @param perm Receives n point indices in curve order (caller-allocated).
  * @return 1 on success, -1 on invalid args or allocation failure.
+ * @note The key holds CHAR_BIT·sizeof(unsigned long) bits: bits = min(32, key bits / dim) per coordinate; with more
+ *       coordinates than key bits, only the first key-bits coordinates are used. Ties keep input order.
  */
-static int mat_mul(int rows, int m, int cols, const double *A, const double *B, double **out) {
-    int i, j, k;
-    double aik;
-    double *C;
+int morton_order(size_t dim, size_t n, const double *mat, size_t *perm) {
+    MortonKey *keys;
+    double *lo, *hi, levels, q;
+    size_t key_bits = CHAR_BIT * sizeof(unsigned long), used, bits, i, d;
+    int b;
 
-    if (rows <= 0 || m <= 0 || cols <= 0 || !A || !B || !out) {return -1;}
-    C = calloc(rows * cols, sizeof *C);
-    if (!C) {return -1;}
+    if (dim == 0 || n == 0 || !mat || !perm) return -1;
+    used = (dim < key_bits) ? dim : key_bits;
+    bits = key_bits / used; if (bits > 32) {bits = 32;}
+    keys = mat_alloc(n, 1, sizeof *keys, 0); lo = mat_alloc(used, 1, sizeof *lo, 0); hi = mat_alloc(used, 1, sizeof *hi, 0);
+    if (!keys || !lo || !hi) {free(keys); free(lo); free(hi); return -1;}
+    for (d = 0; d < used; d++) {lo[d] = hi[d] = mat[d];} /* bounding box */
+    for (i = 1; i < n; i++) {
+        for (d = 0; d < used; d++) {
+            if (mat[i * dim + d] < lo[d]) {lo[d] = mat[i * dim + d];}
+            if (mat[i * dim + d] > hi[d]) {hi[d] = mat[i * dim + d];}
+        }
+    }
+    levels = ldexp(1.0, (int)bits) - 1.0;
+    for (i = 0; i < n; i++) {
+        keys[i].key = 0; keys[i].idx = i;
+        for (b = (int)bits - 1; b >= 0; b--) { /* bit b of every coordinate, then bit b-1, ... */
+            for (d = 0; d < used; d++) {
+                q = (hi[d] > lo[d]) ? floor((mat[i * dim + d] - lo[d]) / (hi[d] - lo[d]) * levels) : 0.0;
+                keys[i].key = (keys[i].key << 1) | (((unsigned long)q >> b) & 1UL);
+            }
+        }
+    }
+    qsort(keys, n, sizeof *keys, morton_cmp);
+    for (i = 0; i < n; i++) {perm[i] = keys[i].idx;}
+    free(keys); free(lo); free(hi);
+    return 1;
+}
 
-    for (i = 0; i < rows; ++i) {
-        for (j = 0; j < m; ++j) {
-            aik = A[i * m + j];
-            for (k = 0; k < cols; ++k) {
-                C[i * cols + k] += aik * B[j * cols + k];
+/**
+ * @brief qsort comparator of MortonKey: by key, then by point index.
+ * @param a First MortonKey.
+ * @param b Second MortonKey.
+ * @return Negative, zero or positive.
+ */
+static int morton_cmp(const void *a, const void *b) {
+    const MortonKey *x = a, *y = b;
+
+    if (x->key != y->key) {return (x->key < y->key) ? -1 : 1;}
+    return (x->idx < y->idx) ? -1 : (x->idx > y->idx);
+}
+
+/**
+ * @brief Stream W = D^(-1/2) A D^(-1/2) row by row into a binary file (raw row-major doubles), never holding n×n.
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param mat Input n×dim points.
+ * @param out Binary FILE* opened for writing.
+ * @param out_mean Receives the mean entry of W (used to scale H0); may be NULL.
+ * @return 1 on success, -1 on allocation or write failure.
+ * @note Two passes over the pairs: degrees first, then each row of W. O(n) memory.
+ */
+int norm_to_file(size_t dim, size_t n, const double *mat, FILE *out, double *out_mean) {
+    double *inv_sqrt, *row;
+    size_t i, j;
+    double entry, total;
+    SymEntryKernel entry_of = sym_entry_kernel(dim);
+
+    if (dim == 0 || n == 0 || !mat || !out) {return -1;}
+    inv_sqrt = calloc(n, sizeof *inv_sqrt); row = malloc(n * sizeof *row);
+    if (!inv_sqrt || !row) {free(inv_sqrt); free(row); return -1;}
+
+    for (i = 0; i < n; i++) { /* Pass 1: degrees (accumulated in inv_sqrt) */
+        for (j = i + 1; j < n; j++) {
+            entry = entry_of(mat + i * dim, mat + j * dim, dim);
+            inv_sqrt[i] += entry; inv_sqrt[j] += entry;
+        }
+    }
+    for (i = 0; i < n; i++) { /* D^(-1/2) */
+        if (inv_sqrt[i] == 0) inv_sqrt[i] = EPS;
+        inv_sqrt[i] = 1.0 / sqrt(inv_sqrt[i]);
+    }
+    total = 0.0;
+    for (i = 0; i < n; i++) { /* Pass 2: row i of W, same evaluation order as norm() */
+        for (j = 0; j < n; j++) {
+            row[j] = (i == j) ? 0.0 : (inv_sqrt[i] * entry_of(mat + i * dim, mat + j * dim, dim)) * inv_sqrt[j];
+            total += row[j];
+        }
+        if (fwrite(row, sizeof *row, n, out) != n) {free(inv_sqrt); free(row); return -1;}
+    }
+    free(inv_sqrt); free(row);
+    if (out_mean) {*out_mean = total / ((double)n * n);}
+    return 1;
+}
+
+/**
+ * @brief Mini-batch SymNMF: each step updates one random row block of H from the matching rows of W and a running H^T H.
+ * @param src Row-block source of W (in memory or streamed from disk).
+ * @param k Number of columns in H.
+ * @param H0 Initial n×k matrix.
+ * @param block Rows per block (clamped to n).
+ * @param epochs Number of passes over all blocks (stops early if an epoch moves H by less than EPS).
+ * @param seed Seed for the block order (deterministic).
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @return 1 on success, -1 on invalid args, read or allocation failure.
+ * @note A step costs O(block·n·k) and touches only `block` rows of W; H^T H is patched with the changed rows
+ *       and recomputed exactly at the start of every epoch so rounding does not drift.
+ */
+int decomp_mat_minibatch(const WRows *src, size_t k, const double *H0, size_t block, int epochs, unsigned long seed, double **out) {
+    double *H, *buff, *WH_B, *H_B, *G;
+    const double *W_B, *h_old, *h_new;
+    size_t *order;
+    size_t n, nb, b, r0, bs, i, j, l, tmp;
+    int e, inner;
+    unsigned long state = seed;
+    double diff, d, w;
+
+    if (!src || src->n == 0 || k == 0 || !H0 || block == 0 || epochs <= 0 || !out) {return -1;}
+    n = src->n;
+    if (block > n) {block = n;}
+    nb = (n + block - 1) / block;
+    H = mat_alloc(n, k, sizeof *H, 0); buff = mat_alloc(block, n, sizeof *buff, 0);
+    WH_B = mat_alloc(block, k, sizeof *WH_B, 0); H_B = mat_alloc(block, k, sizeof *H_B, 0);
+    G = mat_alloc(k, k, sizeof *G, 0); order = malloc(nb * sizeof *order);
+    if (!H || !buff || !WH_B || !H_B || !G || !order) {free(H); free(buff); free(WH_B); free(H_B); free(G); free(order); return -1;}
+    memcpy(H, H0, n * k * sizeof *H);
+    for (b = 0; b < nb; b++) {order[b] = b;}
+
+    for (e = 0; e < epochs; e++) {
+        for (b = nb - 1; b > 0; b--) { /* Fresh random block order every epoch */
+            j = (size_t)(rng_uniform(&state) * (b + 1));
+            tmp = order[b]; order[b] = order[j]; order[j] = tmp;
+        }
+        gram_mat(n, k, H, G);
+        diff = 0.0;
+        for (b = 0; b < nb; b++) {
+            r0 = order[b] * block;
+            bs = (n - r0 < block) ? n - r0 : block;
+            W_B = w_rows(src, r0, bs, buff); /* bs×n rows of W */
+            if (!W_B) {free(H); free(buff); free(WH_B); free(H_B); free(G); free(order); return -1;}
+
+            memset(WH_B, 0, bs * k * sizeof *WH_B);
+            for (i = 0; i < bs; i++) { /* (W H)_B = W_B H (bs×k) */
+                for (j = 0; j < n; j++) {
+                    w = W_B[i * n + j];
+                    if (w == 0.0) {continue;}
+                    for (l = 0; l < k; l++) {WH_B[i * k + l] += w * H[j * k + l];}
+                }
+            }
+            for (inner = 0; inner < MINIBATCH_INNER; inner++) {
+                decomp_mu_step(bs, k, H + r0 * k, WH_B, G, H_B);
+                for (i = 0; i < bs; i++) { /* G += h_new h_new^T - h_old h_old^T */
+                    h_old = H + (r0 + i) * k; h_new = H_B + i * k;
+                    for (j = 0; j < k; j++) {
+                        for (l = 0; l < k; l++) {G[j * k + l] += h_new[j] * h_new[l] - h_old[j] * h_old[l];}
+                    }
+                }
+                for (i = 0; i < bs; i++) { /* (W H)_B += W_B[:, B] (H_B_new - H_B_old): only the block's own columns changed */
+                    for (j = 0; j < bs; j++) {
+                        w = W_B[i * n + r0 + j];
+                        if (w == 0.0) {continue;}
+                        for (l = 0; l < k; l++) {WH_B[i * k + l] += w * (H_B[j * k + l] - H[(r0 + j) * k + l]);}
+                    }
+                }
+                for (i = 0; i < bs * k; i++) { /* Write the rows back */
+                    d = H_B[i] - H[r0 * k + i];
+                    diff += d * d;
+                    H[r0 * k + i] = H_B[i];
+                }
             }
         }
+        if (diff < EPS) {break;}
     }
-    *out = C;
+    free(buff); free(WH_B); free(H_B); free(G); free(order);
+    *out = H; return 1;
+}
+
+/**
+ * @brief Rows [row0, row0 + rows) of W: a pointer into the in-memory W, or read from the file into buff.
+ * @param src Row-block source.
+ * @param row0 First row.
+ * @param rows Number of rows.
+ * @param buff Scratch rows×n buffer (used only when streaming).
+ * @return Pointer to the rows×n block, or NULL on read failure.
+ */
+static const double *w_rows(const WRows *src, size_t row0, size_t rows, double *buff) {
+    size_t count = rows * src->n;
+
+    if (src->W) {return src->W + row0 * src->n;}
+    if (!src->file || fseeko(src->file, (off_t)src->offset + (off_t)(row0 * src->n * sizeof *buff), SEEK_SET) != 0) {return NULL;} /* 64-bit offsets: W files pass 2 GiB near n = 16k */
+    if (fread(buff, sizeof *buff, count, src->file) != count) {return NULL;}
+    return buff;
+}
+
+/**
+ * @brief Nyström factor of the affinity kernel: sample m landmarks, A + I ≈ Z Z^T with Z = C V Λ^(-1/2).
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param mat Input n×dim points.
+ * @param m Number of landmarks (clamped to n).
+ * @param seed Seed for the landmark sampling (deterministic).
+ * @param out_Z Receives malloc'ed n×r factor; caller must free().
+ * @param out_rank Receives r <= m.
+ * @return 1 on success, -1 on invalid args or allocation failure.
+ * @note C is the n×m block of sym_entry values (K = A + I, since sym() zeroes the diagonal), M = V Λ V^T its m×m landmark rows.
+ */
+int nystrom_factor(size_t dim, size_t n, const double *mat, size_t m, unsigned long seed, double **out_Z, size_t *out_rank) {
+    size_t *idx;
+    double *C, *M, *vals, *vecs, *Z;
+    size_t i, j, l, r, tmp;
+    unsigned long state = seed;
+    double max_val, acc;
+    SymEntryKernel entry_of = sym_entry_kernel(dim);
+
+    if (dim == 0 || n == 0 || m == 0 || !mat || !out_Z || !out_rank) {return -1;}
+    if (m > n) {m = n;}
+    idx = malloc(n * sizeof *idx);
+    C = mat_alloc(n, m, sizeof *C, 0); M = mat_alloc(m, m, sizeof *M, 0);
+    vals = malloc(m * sizeof *vals); vecs = mat_alloc(m, m, sizeof *vecs, 0);
+    if (!idx || !C || !M || !vals || !vecs) {free(idx); free(C); free(M); free(vals); free(vecs); return -1;}
+
+    for (i = 0; i < n; i++) {idx[i] = i;}
+    for (i = 0; i < m; i++) { /* Partial Fisher-Yates: idx[0..m-1] <- landmarks */
+        j = i + (size_t)(rng_uniform(&state) * (n - i));
+        tmp = idx[i]; idx[i] = idx[j]; idx[j] = tmp;
+    }
+    for (i = 0; i < n; i++) { /* C (n×m): kernel between every point and every landmark */
+        for (l = 0; l < m; l++) {C[i * m + l] = entry_of(mat + i * dim, mat + idx[l] * dim, dim);}
+    }
+    for (l = 0; l < m; l++) {memcpy(M + l * m, C + idx[l] * m, m * sizeof *M);} /* M (m×m): landmark rows of C */
+    free(idx);
+
+    if (sym_eigen(m, M, vals, vecs) == -1) {free(C); free(M); free(vals); free(vecs); return -1;}
+    free(M);
+    max_val = 0.0;
+    for (l = 0; l < m; l++) {if (vals[l] > max_val) max_val = vals[l];}
+    r = 0; /* Keep well-conditioned directions, pre-scaled by Λ^(-1/2) (compacted in place) */
+    for (l = 0; l < m; l++) {
+        if (vals[l] <= NYSTROM_RCOND * max_val) {continue;}
+        for (j = 0; j < m; j++) {vecs[j * m + r] = vecs[j * m + l] / sqrt(vals[l]);}
+        r++;
+    }
+    if (r == 0) {free(C); free(vals); free(vecs); return -1;}
+
+    Z = mat_alloc(n, r, sizeof *Z, 0);
+    if (!Z) {free(C); free(vals); free(vecs); return -1;}
+    for (i = 0; i < n; i++) { /* Z = C V_r Λ_r^(-1/2) */
+        for (l = 0; l < r; l++) {
+            acc = 0.0;
+            for (j = 0; j < m; j++) {acc += C[i * m + j] * vecs[j * m + l];}
+            Z[i * r + l] = acc;
+        }
+    }
+    free(C); free(vals); free(vecs);
+    *out_Z = Z; *out_rank = r;
     return 1;
 }
 
 /**
- * @brief Compute transpose of a rows×cols matrix.
- * @param rows Number of rows in input.
- * @param cols Number of columns in input.
- * @param mat Input matrix.
- * @param out Receives malloc'ed cols×rows result; caller must free().
- * @return 1 on success, -1 on allocation failure.
+ * @brief Random Fourier feature factor of the Gaussian affinity: A + I ≈ Z Z^T, Z_if = sqrt(2/F) cos(ω_f·x_i + b_f).
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param mat Input n×dim points.
+ * @param features Number of random features F.
+ * @param seed Seed for ω_f ~ N(0, I) and b_f ~ U[0, 2π) (deterministic).
+ * @param out_Z Receives malloc'ed n×F factor; caller must free().
+ * @return 1 on success, -1 on invalid args or allocation failure.
+ * @note exp(-||x-y||^2 / 2) is the unit-bandwidth Gaussian kernel, so ω is standard normal. O(n·F·dim), nothing n×n.
+ *       The error of W shrinks like 1/sqrt(F): use at least several hundred features (about 1000 for ~0.3 relative error).
  */
-static int mat_transpose(int rows, int cols, const double *mat, double **out) {
-    double *res;
-    int i, j;
+int rff_factor(size_t dim, size_t n, const double *mat, size_t features, unsigned long seed, double **out_Z) {
+    double *omega, *phase, *Z;
+    size_t i, f, d;
+    unsigned long state = seed;
+    double scale, proj;
 
-    res = malloc(rows * cols * sizeof *res);
-    if (!res) {return -1;}
-    for (i = 0; i < rows; ++i) {
-        for (j = 0; j < cols; ++j) {
-            res[j * rows + i] = mat[i * cols + j];
+    if (dim == 0 || n == 0 || features == 0 || !mat || !out_Z) {return -1;}
+    omega = mat_alloc(features, dim, sizeof *omega, 0); phase = malloc(features * sizeof *phase);
+    Z = mat_alloc(n, features, sizeof *Z, 0);
+    if (!omega || !phase || !Z) {free(omega); free(phase); free(Z); return -1;}
+
+    for (f = 0; f < features; f++) { /* Draw the feature map once */
+        for (d = 0; d < dim; d++) {omega[f * dim + d] = rng_gaussian(&state);}
+        phase[f] = 2.0 * PI * rng_uniform(&state);
+    }
+    scale = sqrt(2.0 / features);
+    for (i = 0; i < n; i++) {
+        for (f = 0; f < features; f++) {
+            proj = phase[f];
+            for (d = 0; d < dim; d++) {proj += omega[f * dim + d] * mat[i * dim + d];}
+            Z[i * features + f] = scale * cos(proj);
         }
     }
+    free(omega); free(phase);
+    *out_Z = Z;
+    return 1;
+}
 
-    *out = res;
+/**
+ * @brief Mean entry of the low-rank W = D^(-1/2) (Z Z^T - diag) D^(-1/2) (used to scale H0).
+ * @param n Number of rows in Z.
+ * @param r Number of columns in Z.
+ * @param Z Input n×r factor.
+ * @param out_mean Receives the mean of the n×n entries of W.
+ * @return 1 on success, -1 on failure.
+ */
+int lowrank_norm_mean(size_t n, size_t r, const double *Z, double *out_mean) {
+    double *Y = NULL, *diag = NULL, *col_sum;
+    size_t i, l;
+    double total;
+
+    if (n == 0 || r == 0 || !Z || !out_mean) {return -1;}
+    if (lowrank_scaled_factor(n, r, Z, &Y, &diag) == -1) {return -1;}
+    col_sum = calloc(r, sizeof *col_sum);
+    if (!col_sum) {free(Y); free(diag); return -1;}
+    total = 0.0; /* 1^T W 1 = ||Y^T 1||^2 - sum(diag) */
+    for (i = 0; i < n; i++) {
+        for (l = 0; l < r; l++) {col_sum[l] += Y[i * r + l];}
+        total -= diag[i];
+    }
+    for (l = 0; l < r; l++) {total += col_sum[l] * col_sum[l];}
+    free(Y); free(diag); free(col_sum);
+    *out_mean = total / ((double)n * n);
     return 1;
 }
 
 /**
- * @brief Print an n×n matrix of doubles with 4 decimal places.
- * @param n Matrix dimension.
- * @param mat Input square matrix.
+ * @brief Same as decomp_mat, but W·H is evaluated from the thin factor Z in O(n·r·k) per iteration.
+ * @param n Number of rows in Z and H.
+ * @param r Number of columns in Z.
+ * @param k Number of columns in H.
+ * @param Z Input n×r factor (A + I ≈ Z Z^T).
+ * @param H0 Initial n×k matrix.
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @return 1 on success, -1 on failure (including non-positive mean degree, see lowrank_scaled_factor).
+ * @note The H-side product uses H (H^T H) instead of (H H^T) H, so nothing n×n is formed. Negative entries of the
+ *       approximate W·H (random Fourier features are not a non-negative kernel) are clamped to 0, so H stays >= 0.
+ */
+int decomp_mat_lowrank(size_t n, size_t r, size_t k, const double *Z, const double *H0, double **out) {
+    double *Y = NULL, *diag = NULL, *H_t, *H_t_plus1, *WH, *HtH, *tmp_r, *swap;
+    size_t i;
+    int it;
+    double diff, d;
+
+    if (n == 0 || r == 0 || k == 0 || !Z || !H0 || !out) {return -1;}
+    if (lowrank_scaled_factor(n, r, Z, &Y, &diag) == -1) {return -1;}
+    H_t = mat_alloc(n, k, sizeof *H_t, 0); H_t_plus1 = mat_alloc(n, k, sizeof *H_t_plus1, 0);
+    WH = mat_alloc(n, k, sizeof *WH, 0); HtH = mat_alloc(k, k, sizeof *HtH, 0); tmp_r = mat_alloc(r, k, sizeof *tmp_r, 0);
+    if (!H_t || !H_t_plus1 || !WH || !HtH || !tmp_r) {free(Y); free(diag); free(H_t); free(H_t_plus1); free(WH); free(HtH); free(tmp_r); return -1;}
+    memcpy(H_t, H0, n * k * sizeof *H_t); /* H(t) <- H0 */
+
+    for (it = 0; it < MAX_ITERS; ++it) {
+        lowrank_apply_W(n, r, k, Y, diag, H_t, tmp_r, WH); /* W H (n×k) from thin factors */
+        for (i = 0; i < n * k; ++i) {if (WH[i] < 0.0) {WH[i] = 0.0;}} /* approximate kernels have negative entries: keep H >= 0 */
+        gram_mat(n, k, H_t, HtH); /* H^T H (k×k) */
+        decomp_mu_step(n, k, H_t, WH, HtH, H_t_plus1);
+
+        diff = 0.0; /* Calculate ||H_(t+1) - H_t||_F^2 */
+        for (i = 0; i < n * k; ++i) {
+            d = H_t_plus1[i] - H_t[i];
+            diff += d * d;
+        }
+        swap = H_t; H_t = H_t_plus1; H_t_plus1 = swap; /* Next iteration: Ht <- H(t+1) */
+        if (diff < EPS) {break;}
+    }
+    free(Y); free(diag); free(H_t_plus1); free(WH); free(HtH); free(tmp_r);
+    *out = H_t; return 1;
+}
+
+/**
+ * @brief Accuracy check: relative Frobenius error ||W - W_lowrank||_F / ||W||_F against the dense norm().
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param mat Input n×dim points.
+ * @param r Number of columns in Z.
+ * @param Z Input n×r factor built from the same points.
+ * @param out_err Receives the relative error.
+ * @return 1 on success, -1 on failure.
+ * @note Builds the dense n×n W, so meant for small inputs only.
  */
-void print_squared_matrix_floats_4f(int n, const double *mat) {
-    int i, j;
+int lowrank_norm_error(size_t dim, size_t n, const double *mat, size_t r, const double *Z, double *out_err) {
+    double *A = NULL, *D = NULL, *W = NULL, *Y = NULL, *diag = NULL;
+    size_t i, j, l;
+    double approx, err, total;
+
+    if (!out_err) {return -1;}
+    if (sym(dim, n, mat, &A) == -1) {return -1;}
+    if (ddg(n, A, &D) == -1) {free(A); return -1;}
+    if (norm(n, A, D, &W) == -1) {free(A); free(D); return -1;}
+    free(A); free(D);
+    if (lowrank_scaled_factor(n, r, Z, &Y, &diag) == -1) {free(W); return -1;}
 
+    err = 0.0; total = 0.0;
     for (i = 0; i < n; i++) {
         for (j = 0; j < n; j++) {
-            printf("%.4f", mat[i * n + j]);
-            if (j == n - 1) {printf("\n");}
-            else {printf(",");}
+            approx = 0.0;
+            for (l = 0; l < r; l++) {approx += Y[i * r + l] * Y[j * r + l];}
+            if (i == j) {approx -= diag[i];}
+            err += (W[i * n + j] - approx) * (W[i * n + j] - approx);
+            total += W[i * n + j] * W[i * n + j];
+        }
+    }
+    free(W); free(Y); free(diag);
+    *out_err = (total > 0.0) ? sqrt(err / total) : sqrt(err);
+    return 1;
+}
+
+/**
+ * @brief Fold the degree normalization into the factor: W = Y Y^T - diag(diag), Y = D^(-1/2) Z.
+ * @param n Number of rows in Z.
+ * @param r Number of columns in Z.
+ * @param Z Input n×r factor (A + I ≈ Z Z^T).
+ * @param out_Y Receives malloc'ed n×r scaled factor; caller must free().
+ * @param out_diag Receives malloc'ed length-n correction ||y_i||^2 (keeps W_ii = 0 like norm()); caller must free().
+ * @return 1 on success, -1 on allocation failure or a non-positive mean degree (the factor is unusable).
+ * @note Degrees come from the factors too: d = Z (Z^T 1) - ||z_i||^2, never forming A. Approximate degrees can be
+ *       tiny or negative, so each is raised to at least LOWRANK_DEG_FLOOR times their mean (an EPS floor would
+ *       scale such a row by 1/sqrt(EPS) and swamp W).
+ */
+static int lowrank_scaled_factor(size_t n, size_t r, const double *Z, double **out_Y, double **out_diag) {
+    double *Y, *diag, *col_sum;
+    size_t i, l;
+    double d, row_sq, scale, floor = 0.0;
+
+    Y = mat_alloc(n, r, sizeof *Y, 0); diag = malloc(n * sizeof *diag); col_sum = calloc(r, sizeof *col_sum);
+    if (!Y || !diag || !col_sum) {free(Y); free(diag); free(col_sum); return -1;}
+    for (i = 0; i < n; i++) { /* Z^T 1 */
+        for (l = 0; l < r; l++) {col_sum[l] += Z[i * r + l];}
+    }
+    for (i = 0; i < n; i++) { /* degrees first (kept in diag), for their mean */
+        d = 0.0; row_sq = 0.0;
+        for (l = 0; l < r; l++) {
+            d += Z[i * r + l] * col_sum[l];
+            row_sq += Z[i * r + l] * Z[i * r + l];
+        }
+        diag[i] = d - row_sq; /* Drop the kernel's self term: A_ii = 0 */
+        floor += diag[i];
+    }
+    floor = LOWRANK_DEG_FLOOR * floor / (double)n;
+    if (!(floor > 0.0)) {free(Y); free(diag); free(col_sum); return -1;}
+    for (i = 0; i < n; i++) {
+        d = (diag[i] < floor) ? floor : diag[i];
+        scale = 1.0 / sqrt(d);
+        row_sq = 0.0;
+        for (l = 0; l < r; l++) {
+            Y[i * r + l] = Z[i * r + l] * scale;
+            row_sq += Z[i * r + l] * Z[i * r + l];
+        }
+        diag[i] = row_sq * scale * scale;
+    }
+    free(col_sum);
+    *out_Y = Y; *out_diag = diag;
+    return 1;
+}
+
+/**
+ * @brief W·H = Y (Y^T H) - diag(diag) H, in O(n·r·k).
+ * @param n Number of rows in Y and H.
+ * @param r Number of columns in Y.
+ * @param k Number of columns in H.
+ * @param Y Input n×r scaled factor.
+ * @param diag Input length-n diagonal correction.
+ * @param H Input n×k matrix.
+ * @param tmp_r Scratch r×k buffer.
+ * @param out_WH Receives the n×k product (caller-allocated).
+ */
+static void lowrank_apply_W(size_t n, size_t r, size_t k, const double *Y, const double *diag, const double *H, double *tmp_r, double *out_WH) {
+    size_t i, l, j;
+    double y;
+
+    memset(tmp_r, 0, r * k * sizeof *tmp_r);
+    for (i = 0; i < n; i++) { /* Y^T H (r×k) */
+        for (l = 0; l < r; l++) {
+            y = Y[i * r + l];
+            for (j = 0; j < k; j++) {tmp_r[l * k + j] += y * H[i * k + j];}
+        }
+    }
+    for (i = 0; i < n; i++) { /* Y (Y^T H) - diag H */
+        for (j = 0; j < k; j++) {out_WH[i * k + j] = -diag[i] * H[i * k + j];}
+        for (l = 0; l < r; l++) {
+            y = Y[i * r + l];
+            for (j = 0; j < k; j++) {out_WH[i * k + j] += y * tmp_r[l * k + j];}
+        }
+    }
+}
+
+/**
+ * @brief One damped multiplicative update given W·H and H^T H: H' = H ∘ ((1-β) + β (WH) / (H (H^T H))).
+ * @param n Number of rows in H.
+ * @param k Number of columns in H.
+ * @param H Current n×k matrix.
+ * @param WH Input n×k product W·H.
+ * @param HtH Input k×k Gram matrix H^T H.
+ * @param out_H Receives the n×k updated H (caller-allocated, distinct from H and WH).
+ */
+static void decomp_mu_step(size_t n, size_t k, const double *H, const double *WH, const double *HtH, double *out_H) {
+    size_t i, j;
+    double denom;
+
+    memset(out_H, 0, n * k * sizeof *out_H); /* denominators first: (H H^T H)_ij = (H (H^T H))_ij */
+    kernels->gemm_acc(n, k, k, H, k, HtH, out_H);
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < k; j++) {
+            denom = out_H[i * k + j];
+            if (denom == 0.0) {denom = EPS;}
+            out_H[i * k + j] = H[i * k + j] * ((1.0 - BETA) + BETA * (WH[i * k + j] / denom));
+        }
+    }
+}
+
+/**
+ * @brief Gram matrix G = H^T H.
+ * @param n Number of rows in H.
+ * @param k Number of columns in H.
+ * @param H Input n×k matrix.
+ * @param out_G Receives the k×k result (caller-allocated).
+ */
+static void gram_mat(size_t n, size_t k, const double *H, double *out_G) {
+    size_t i, j, l;
+    double h;
+
+    memset(out_G, 0, k * k * sizeof *out_G);
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < k; j++) {
+            h = H[i * k + j];
+            for (l = 0; l < k; l++) {out_G[j * k + l] += h * H[i * k + l];}
+        }
+    }
+}
+
+/**
+ * @brief Eigen-decomposition of a symmetric m×m matrix by cyclic Jacobi rotations.
+ * @param m Matrix dimension.
+ * @param M Input symmetric m×m matrix.
+ * @param out_vals Receives m eigenvalues (caller-allocated).
+ * @param out_vecs Receives m×m eigenvectors as columns (caller-allocated).
+ * @return 1 on success, -1 on allocation failure.
+ */
+static int sym_eigen(size_t m, const double *M, double *out_vals, double *out_vecs) {
+    double *a;
+    size_t p, q, r;
+    int sweep;
+    double off, theta, t, c, s, arp, arq;
+
+    a = mat_alloc(m, m, sizeof *a, 0);
+    if (!a) {return -1;}
+    memcpy(a, M, m * m * sizeof *a);
+    for (p = 0; p < m; p++) {
+        for (q = 0; q < m; q++) {out_vecs[p * m + q] = (p == q) ? 1.0 : 0.0;}
+    }
+    for (sweep = 0; sweep < JACOBI_SWEEPS; sweep++) {
+        off = 0.0;
+        for (p = 0; p < m; p++) {
+            for (q = p + 1; q < m; q++) {off += a[p * m + q] * a[p * m + q];}
         }
-    }         
+        if (off < 1e-30) {break;}
+        for (p = 0; p < m; p++) {
+            for (q = p + 1; q < m; q++) {
+                if (a[p * m + q] == 0.0) {continue;}
+                theta = (a[q * m + q] - a[p * m + p]) / (2.0 * a[p * m + q]); /* Rotation that zeroes a_pq */
+                t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+                c = 1.0 / sqrt(t * t + 1.0); s = t * c;
+                for (r = 0; r < m; r++) { /* A <- A J */
+                    arp = a[r * m + p]; arq = a[r * m + q];
+                    a[r * m + p] = c * arp - s * arq; a[r * m + q] = s * arp + c * arq;
+                }
+                for (r = 0; r < m; r++) { /* A <- J^T A */
+                    arp = a[p * m + r]; arq = a[q * m + r];
+                    a[p * m + r] = c * arp - s * arq; a[q * m + r] = s * arp + c * arq;
+                }
+                for (r = 0; r < m; r++) { /* V <- V J */
+                    arp = out_vecs[r * m + p]; arq = out_vecs[r * m + q];
+                    out_vecs[r * m + p] = c * arp - s * arq; out_vecs[r * m + q] = s * arp + c * arq;
+                }
+            }
+        }
+    }
+    for (p = 0; p < m; p++) {out_vals[p] = a[p * m + p];}
+    free(a);
+    return 1;
+}
+
+/**
+ * @brief Deterministic 32-bit xorshift generator (same sequence on every platform).
+ * @param state In/out: generator state (0 is remapped to a fixed non-zero value).
+ * @return Next value in [0, 2^32).
+ */
+static unsigned long rng_next(unsigned long *state) {
+    unsigned long x = *state & 0xFFFFFFFFUL;
+
+    if (x == 0) {x = 0x9E3779B9UL;}
+    x ^= (x << 13) & 0xFFFFFFFFUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xFFFFFFFFUL;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief Uniform double in [0, 1) from rng_next.
+ * @param state In/out: generator state.
+ * @return Value in [0, 1).
+ */
+static double rng_uniform(unsigned long *state) {
+    return rng_next(state) / 4294967296.0;
+}
+
+/**
+ * @brief Standard normal sample (Box-Muller) from rng_uniform.
+ * @param state In/out: generator state.
+ * @return Sample from N(0, 1).
+ */
+static double rng_gaussian(unsigned long *state) {
+    double u1 = 1.0 - rng_uniform(state); /* (0, 1]: keeps log() finite */
+    double u2 = rng_uniform(state);
+
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * PI * u2);
+}
+
+/**
+ * @brief Map the cached degrees and W for a point set, computing and storing them first on a miss.
+ * @param dir Cache directory (must exist).
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param points Input n×dim points (cache key).
+ * @param out Receives the mapping; release with wcache_close().
+ * @return 1 on success, -1 on invalid args, I/O or allocation failure.
+ */
+int wcache_open(const char *dir, size_t dim, size_t n, const double *points, WCache *out) {
+    char *path;
+    unsigned long hash;
+    int status;
+
+    if (!dir || dim == 0 || n == 0 || !points || !out) {return -1;}
+    hash = wcache_hash(dim, n, points);
+    path = malloc(strlen(dir) + 64);
+    if (!path) {return -1;}
+    sprintf(path, "%s/symnmf_w_v%ld_%lu_%lu_%08lx.bin", dir, WCACHE_VERSION, (unsigned long)n, (unsigned long)dim, hash);
+
+    status = wcache_map(path, dim, n, points, hash, out); /* Hit: map and return */
+    if (status != 1 && wcache_store(dir, path, dim, n, points, hash) == 1) { /* Miss: compute, publish, map */
+        status = wcache_map(path, dim, n, points, hash, out);
+    }
+    free(path);
+    return (status == 1) ? 1 : -1;
+}
+
+/**
+ * @brief Unmap an entry returned by wcache_open.
+ * @param cache Entry to release (fields are reset).
+ */
+void wcache_close(WCache *cache) {
+    if (!cache || !cache->map) {return;}
+    munmap(cache->map, cache->map_len);
+    cache->map = NULL; cache->map_len = 0;
+    cache->degrees = NULL; cache->W = NULL; cache->n = 0;
+}
+
+/**
+ * @brief 32-bit FNV-1a hash of the point bytes (names the cache file; equality is checked on open).
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param points Input n×dim points.
+ * @return Hash value in [0, 2^32).
+ */
+static unsigned long wcache_hash(size_t dim, size_t n, const double *points) {
+    const unsigned char *bytes = (const unsigned char *)points;
+    size_t i, len = n * dim * sizeof *points;
+    unsigned long hash = 2166136261UL;
+
+    for (i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash = (hash * 16777619UL) & 0xffffffffUL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Map a cache file read-only if it is a complete entry for exactly these points.
+ * @param path Cache file path.
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param points Input n×dim points, compared against the stored copy.
+ * @param hash Expected hash.
+ * @param out Receives the mapping on a hit.
+ * @return 1 on hit, 0 on miss (absent, stale, truncated or colliding entry).
+ */
+static int wcache_map(const char *path, size_t dim, size_t n, const double *points, unsigned long hash, WCache *out) {
+    const WCacheHeader *header;
+    const double *data;
+    struct stat st;
+    size_t points_len = n * dim, len;
+    void *map;
+    int fd;
+
+    if (n > (size_t)-1 / sizeof(double) / n) {return 0;} /* W itself would not be addressable */
+    len = sizeof *header + (points_len + n + n * n) * sizeof(double);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {return 0;}
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != len) {close(fd); return 0;}
+    map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); /* The mapping keeps the file alive, even if it is replaced meanwhile */
+    if (map == MAP_FAILED) {return 0;}
+
+    header = (const WCacheHeader *)map;
+    data = (const double *)(header + 1);
+    if (memcmp(header->magic, WCACHE_MAGIC, sizeof header->magic) != 0 || header->version != WCACHE_VERSION ||
+        header->n != (unsigned long)n || header->dim != (unsigned long)dim || header->hash != hash ||
+        memcmp(data, points, points_len * sizeof *points) != 0) {munmap(map, len); return 0;}
+
+    out->n = n;
+    out->degrees = data + points_len;
+    out->W = data + points_len + n;
+    out->map = map; out->map_len = len;
+    return 1;
+}
+
+/**
+ * @brief Compute degrees and W for the points and atomically publish them at path.
+ * @param dir Cache directory (holds the temporary file, so rename stays on one file system).
+ * @param path Final cache file path.
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param points Input n×dim points.
+ * @param hash Hash of the points.
+ * @return 1 on success, -1 on I/O or allocation failure.
+ */
+static int wcache_store(const char *dir, const char *path, size_t dim, size_t n, const double *points, unsigned long hash) {
+    WCacheHeader header;
+    double *A = NULL, *D = NULL, *W = NULL, *degrees;
+    unsigned char *mask = NULL;
+    char *tmp_path;
+    FILE *out;
+    size_t i;
+    int fd, ok;
+
+    if (sym_pruned(dim, n, points, 0.0, &A, &mask) == -1) {return -1;}
+    if (ddg_tiled(n, A, mask, &D) == -1) {free(A); free(mask); return -1;}
+    if (norm_tiled(n, A, D, mask, &W) == -1) {free(A); free(D); free(mask); return -1;}
+    free(A); free(mask);
+    degrees = D; /* Compact the diagonal in place */
+    for (i = 0; i < n; i++) {degrees[i] = D[i * n + i];}
+
+    tmp_path = malloc(strlen(dir) + 32);
+    if (!tmp_path) {free(D); free(W); return -1;}
+    sprintf(tmp_path, "%s/.symnmf_w_XXXXXX", dir);
+    fd = mkstemp(tmp_path);
+    if (fd < 0) {free(tmp_path); free(D); free(W); return -1;}
+    if (fchmod(fd, 0644) == -1) { /* mkstemp creates 0600; let other jobs on the cache read it */
+        close(fd); unlink(tmp_path); free(tmp_path); free(D); free(W); return -1;
+    }
+    out = fdopen(fd, "wb");
+    if (!out) {close(fd); unlink(tmp_path); free(tmp_path); free(D); free(W); return -1;}
+
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, WCACHE_MAGIC, sizeof header.magic);
+    header.version = WCACHE_VERSION; header.n = n; header.dim = dim; header.hash = hash;
+    ok = fwrite(&header, sizeof header, 1, out) == 1 &&
+         fwrite(points, sizeof *points, n * dim, out) == n * dim &&
+         fwrite(degrees, sizeof *degrees, n, out) == n &&
+         fwrite(W, sizeof *W, n * n, out) == n * n &&
+         fflush(out) == 0 && fsync(fileno(out)) == 0;
+    free(D); free(W);
+    if (fclose(out) != 0) {ok = 0;}
+    if (ok && rename(tmp_path, path) != 0) {ok = 0;} /* Readers see the old entry or the new one, never a partial file */
+    if (!ok) {unlink(tmp_path);}
+    free(tmp_path);
+    return ok ? 1 : -1;
 }
@@ -1,6 +1,8 @@
 #ifndef SYMNMF_H
 #define SYMNMF_H
 
+#include <stdio.h>
+
 /* Public interface: Symnmf core routines */
 
  /**
@@ -10,8 +12,30 @@
  * @param mat Input n×dim points.
  * @param out_A Receives malloc'ed n×n A; caller must free().
  * @return 1 on success, -1 on allocation failure.
+ * @note Tiled (sym_pruned with tol = 0): tile pairs whose entries all underflow to 0.0 are skipped; same A.
  */
-int sym(int dim, int n, const double *mat, double **out_A);
+int sym(size_t dim, size_t n, const double *mat, double **out_A);
+
+/**
+ * @brief Tiled A with bounding-box pruning: a pair of point tiles is skipped when the gap between their boxes
+ *        guarantees every entry is 0.0 in double (or below tol).
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param mat Input n×dim points.
+ * @param tol 0: exact A; > 0: entries below tol are set to 0 (and whole tile pairs below it skipped).
+ * @param out_A Receives malloc'ed n×n A; caller must free().
+ * @param out_mask If not NULL, receives the malloc'ed tiles×tiles mask (1: the tile pair was computed), tiles of
+ *        SYM_TILE points in row order; caller must free().
+ * @return 1 on success, -1 on allocation failure.
+ */
+int sym_pruned(size_t dim, size_t n, const double *mat, double tol, double **out_A, unsigned char **out_mask);
+
+/**
+ * @brief Tiles per side of the sym_pruned mask.
+ * @param n Number of points.
+ * @return ceil(n / SYM_TILE); the mask has this many squared entries.
+ */
+size_t sym_tile_count(size_t n);
 
  /**
  * @brief Build n×n diagonal degree matrix D from sym matrix A.
@@ -20,7 +44,18 @@ int sym(int dim, int n, const double *mat, double **out_A);
  * @param out_D Receives malloc'ed n×n D; caller must free().
  * @return 1 on success, -1 on allocation failure.
  */
-int ddg(int n, const double *A, double **out_D);
+int ddg(size_t n, const double *A, double **out_D);
+
+/**
+ * @brief ddg summing only the tile pairs of A that sym_pruned computed (the others are 0.0).
+ * @param n Number of rows/cols.
+ * @param A Input n×n sym matrix.
+ * @param mask Tile mask from sym_pruned, or NULL for all tiles.
+ * @param out_D Receives malloc'ed n×n D; caller must free().
+ * @return 1 on success, -1 on allocation failure.
+ * @note Same D as ddg, bit for bit.
+ */
+int ddg_tiled(size_t n, const double *A, const unsigned char *mask, double **out_D);
 
 /**
  * @brief Compute normalized matrix W = D^(-1/2) A D^(-1/2).
@@ -30,7 +65,33 @@ int ddg(int n, const double *A, double **out_D);
  * @param out_W Receives malloc'ed n×n normalized matrix; caller must free().
  * @return 1 on success, -1 on allocation failure.
  */
-int norm(int n, const double *A, const double *D, double **out_W);
+int norm(size_t n, const double *A, const double *D, double **out_W);
+
+/**
+ * @brief norm over the tile pairs of A that sym_pruned computed, entry by entry: W_ij = (d_i^(-1/2) · A_ij) · d_j^(-1/2).
+ * @param n Number of rows/cols.
+ * @param A Input n×n sym matrix.
+ * @param D Input n×n ddg matrix.
+ * @param mask Tile mask from sym_pruned, or NULL for all tiles.
+ * @param out_W Receives malloc'ed n×n normalized matrix; caller must free().
+ * @return 1 on success, -1 on allocation failure.
+ * @note O(n^2) and the same W as the diagonal products D^(-1/2) A D^(-1/2), bit for bit; norm is this with mask NULL.
+ */
+int norm_tiled(size_t n, const double *A, const double *D, const unsigned char *mask, double **out_W);
+
+/**
+ * @brief Build A and the degrees while the points are parsed: the caller reads row blocks, compute threads fill each
+ *        block's affinities to all earlier rows (row i needs only rows 0..i-1) and add them to the degrees in row order.
+ * @param in Input CSV stream (same format and checks as the CLI's points file).
+ * @param threads Compute threads besides the reader; <= 0 means one per online core.
+ * @param dim_out Out: point dimension.
+ * @param n_out Out: number of points.
+ * @param out_A If not NULL, receives the malloc'ed n×n A; caller must free().
+ * @param out_deg If not NULL, receives the malloc'ed n degrees (row sums of A); caller must free().
+ * @return 1 on success, 0 if the stream is empty, -1 on invalid input or allocation failure.
+ * @note Same A and degrees as sym and ddg, bit for bit.
+ */
+int sym_stream(FILE *in, int threads, size_t *dim_out, size_t *n_out, double **out_A, double **out_deg);
 
 /**
  * @brief Iteratively update H starting from H0 until (||H_(t+1) - H_t||_F^2) < EPS or MAX_ITERS.
@@ -41,6 +102,312 @@ int norm(int n, const double *A, const double *D, double **out_W);
  * @param out Receives malloc'ed final n×k H; caller must free().
  * @return 1 on success, -1 on failure.
  */
-int decomp_mat(int n, int k, const double *W, const double *H0, double **out);
+int decomp_mat(size_t n, size_t k, const double *W, const double *H0, double **out);
+
+/**
+ * @brief Allocate a rows×cols array, failing instead of wrapping around when the byte size overflows size_t.
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @param elem_size Size of one entry in bytes.
+ * @param zeroed Non-zero to zero-fill (calloc semantics).
+ * @return Pointer to release with free(), or NULL on overflow or allocation failure.
+ */
+void *mat_alloc(size_t rows, size_t cols, size_t elem_size, int zeroed);
+
+/**
+ * @brief Summary of a decomposition run, for comparing engines at equal objective.
+ */
+typedef struct DecompStats {
+    int iters;  /**< Iterations (full sweeps over H) performed. */
+    double objective;  /**< Final ||W - H H^T||_F^2. */
+} DecompStats;
+
+/**
+ * @brief Decomposition engine: W (n×n) and H0 (n×k) in, malloc'ed final H out; fills stats when not NULL.
+ */
+typedef int (*DecompSolver)(size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats);
+
+/**
+ * @brief Look up a decomposition engine by name: "mu" (damped multiplicative, as decomp_mat), "mu-lazy" (the same on an active set of rows),
+ *        "mu-sparse" (the same over the non-zero tiles of W), "mu-par" (the same on all cores), "ml" (multilevel coarsen-solve-refine) or "cd" (coordinate descent).
+ * @param name Engine name: "mu", "mu-lazy", "mu-sparse", "mu-par", "ml" or "cd".
+ * @return The engine, or NULL if the name is unknown.
+ */
+DecompSolver decomp_solver(const char *name);
+
+/**
+ * @brief Run the named decomposition engine until ||H_(t+1) - H_t||_F^2 < EPS or MAX_ITERS.
+ * @param name Engine name (see decomp_solver).
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n matrix.
+ * @param H0 Initial n×k matrix.
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @param stats Receives iterations and final objective; may be NULL (objective is then not computed).
+ * @return 1 on success, -1 on unknown engine or failure.
+ */
+int decomp_mat_solver(const char *name, size_t n, size_t k, const double *W, const double *H0, double **out, DecompStats *stats);
+
+/**
+ * @brief The "mu-sparse" engine with the live tiles of W given by the sym_pruned mask W was built from.
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n matrix.
+ * @param mask Tile mask from sym_pruned, or NULL to find the non-zero tiles by scanning W (as decomp_mat_solver does).
+ * @param H0 Initial n×k matrix.
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @param stats Receives iterations and final objective; may be NULL.
+ * @return 1 on success, -1 on failure.
+ * @note Same H with or without the mask.
+ */
+int decomp_mat_sparse(size_t n, size_t k, const double *W, const unsigned char *mask, const double *H0, double **out, DecompStats *stats);
+
+/**
+ * @brief Damped multiplicative updates on a persistent pool of threads, each owning fixed row chunks of W and H.
+ * @param n Number of rows in W and H.
+ * @param k Number of columns in H.
+ * @param W Input n×n matrix.
+ * @param H0 Initial n×k matrix.
+ * @param threads Worker threads (including the caller); <= 0 means one per online core.
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @param stats Receives iterations and final objective; may be NULL.
+ * @return 1 on success, -1 on failure.
+ * @note The result does not depend on threads. Engine "mu-par" of decomp_mat_solver uses all online cores.
+ */
+int decomp_mat_parallel(size_t n, size_t k, const double *W, const double *H0, int threads, double **out, DecompStats *stats);
+
+/**
+ * @brief Select the widest kernel set (avx512, avx2 or generic) the CPU supports, or the one named by the SYMNMF_ISA
+ *        environment variable, and log the choice to stderr. Call once at startup, before any threads are started.
+ * @return Name of the selected set.
+ * @note All sets give the same results bit for bit; without a call the generic kernels are used.
+ */
+const char *isa_select(void);
+
+/**
+ * @brief Result of one k of a sweep (see decomp_mat_sweep).
+ */
+typedef struct SweepFit {
+    size_t k;  /**< Number of columns in H. */
+    double *H;  /**< Final n×k H (malloc'ed; caller must free()). */
+    size_t *labels;  /**< n labels: argmax of each row of H (malloc'ed; caller must free()). */
+    DecompStats stats;  /**< Iterations and final ||W - H H^T||_F^2. */
+} SweepFit;
+
+/**
+ * @brief Run the "mu" engine for several k on one W: all H blocks are updated side by side, so each iteration reads W
+ *        once for every k still running (one wide W·[H_1 .. H_m] product); each k stops on its own EPS test or MAX_ITERS.
+ * @param n Number of rows in W and H.
+ * @param W Input n×n matrix.
+ * @param count Number of k values.
+ * @param ks The k values (each >= 1).
+ * @param H0s Initial H blocks, one after the other: n×ks[0], then n×ks[1], ...
+ * @param out Receives count results (caller-allocated); free each H and labels.
+ * @return 1 on success, -1 on invalid args or allocation failure.
+ */
+int decomp_mat_sweep(size_t n, const double *W, size_t count, const size_t *ks, const double *H0s, SweepFit *out);
+
+/**
+ * @brief One small clustering job of a batch (see symnmf_batch).
+ */
+typedef struct BatchJob {
+    size_t n, dim;  /**< Number of points and their dimension. */
+    const double *points;  /**< n×dim points (read only). */
+    unsigned long seed;  /**< Seed of the H0 draw: uniforms in [0, 1) scaled by 2·sqrt(mean(W)/k), as in symnmf.py. */
+    SweepFit fit;  /**< In: fit.k (>= 1). Out: H, labels and stats (H and labels malloc'ed; caller must free()). */
+    int status;  /**< Out: 1 on success, -1 on invalid sizes or allocation failure (H and labels are then NULL). */
+} BatchJob;
+
+/**
+ * @brief Fit SymNMF on many small independent datasets in one call: W = norm(points), H0 from the seed, then the
+ *        multiplicative rule until EPS or MAX_ITERS, per job. Jobs run on a work-stealing pool of threads; each thread
+ *        keeps one scratch arena (W, H, W·H, ...) for all its jobs, so a job allocates only its outputs.
+ * @param count Number of jobs.
+ * @param jobs The jobs (points, k and seed in; fit and status out).
+ * @param threads Worker threads (including the caller); <= 0 means one per online core.
+ * @return 1 if every job succeeded, -1 otherwise (see each job's status).
+ * @note A job's result does not depend on threads or on the other jobs.
+ */
+int symnmf_batch(size_t count, BatchJob *jobs, int threads);
+
+/**
+ * @brief Row-block source of an n×n W: either in memory or streamed from a binary file.
+ */
+typedef struct WRows {
+    size_t n;  /**< W is n×n. */
+    const double *W;  /**< In-memory row-major W, or NULL to stream rows from `file`. */
+    FILE *file;  /**< Binary file of row-major n×n doubles (used when W is NULL). */
+    long offset;  /**< Byte offset of W[0][0] in `file`. */
+} WRows;
+
+/**
+ * @brief Stream W = D^(-1/2) A D^(-1/2) row by row into a binary file (raw row-major doubles), never holding n×n.
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param mat Input n×dim points.
+ * @param out Binary FILE* opened for writing.
+ * @param out_mean Receives the mean entry of W (used to scale H0); may be NULL.
+ * @return 1 on success, -1 on allocation or write failure.
+ */
+int norm_to_file(size_t dim, size_t n, const double *mat, FILE *out, double *out_mean);
+
+/**
+ * @brief Mini-batch SymNMF: each step updates one random row block of H from the matching rows of W and a running H^T H.
+ * @param src Row-block source of W (in memory or streamed from disk).
+ * @param k Number of columns in H.
+ * @param H0 Initial n×k matrix.
+ * @param block Rows per block (clamped to n).
+ * @param epochs Number of passes over all blocks (stops early if an epoch moves H by less than EPS).
+ * @param seed Seed for the block order (deterministic).
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @return 1 on success, -1 on invalid args, read or allocation failure.
+ */
+int decomp_mat_minibatch(const WRows *src, size_t k, const double *H0, size_t block, int epochs, unsigned long seed, double **out);
+
+/**
+ * @brief Nyström factor of the affinity kernel: sample m landmarks, A + I ≈ Z Z^T with Z = C V Λ^(-1/2).
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param mat Input n×dim points.
+ * @param m Number of landmarks (clamped to n).
+ * @param seed Seed for the landmark sampling (deterministic).
+ * @param out_Z Receives malloc'ed n×r factor; caller must free().
+ * @param out_rank Receives r <= m (numerically null directions of the landmark block are dropped).
+ * @return 1 on success, -1 on invalid args or allocation failure.
+ */
+int nystrom_factor(size_t dim, size_t n, const double *mat, size_t m, unsigned long seed, double **out_Z, size_t *out_rank);
+
+/**
+ * @brief Random Fourier feature factor of the Gaussian affinity: A + I ≈ Z Z^T, Z_if = sqrt(2/F) cos(ω_f·x_i + b_f).
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param mat Input n×dim points.
+ * @param features Number of random features F.
+ * @param seed Seed for ω_f ~ N(0, I) and b_f ~ U[0, 2π) (deterministic).
+ * @param out_Z Receives malloc'ed n×F factor; caller must free().
+ * @return 1 on success, -1 on invalid args or allocation failure.
+ * @note The error of W shrinks like 1/sqrt(F): below a few hundred features it is of the order of W itself
+ *       (lowrank_norm_error > 1); about 1000 features bring it near 0.3. Check with lowrank_norm_error.
+ */
+int rff_factor(size_t dim, size_t n, const double *mat, size_t features, unsigned long seed, double **out_Z);
+
+/**
+ * @brief Mean entry of the low-rank W = D^(-1/2) (Z Z^T - diag) D^(-1/2) (used to scale H0).
+ * @param n Number of rows in Z.
+ * @param r Number of columns in Z.
+ * @param Z Input n×r factor.
+ * @param out_mean Receives the mean of the n×n entries of W.
+ * @return 1 on success, -1 on failure.
+ */
+int lowrank_norm_mean(size_t n, size_t r, const double *Z, double *out_mean);
+
+/**
+ * @brief Same as decomp_mat, but W·H is evaluated from the thin factor Z in O(n·r·k) per iteration.
+ * @param n Number of rows in Z and H.
+ * @param r Number of columns in Z.
+ * @param k Number of columns in H.
+ * @param Z Input n×r factor (A + I ≈ Z Z^T).
+ * @param H0 Initial n×k matrix.
+ * @param out Receives malloc'ed final n×k H; caller must free().
+ * @return 1 on success, -1 on failure (including a factor whose mean degree is not positive).
+ * @note Negative entries of the approximate W·H are clamped to 0, so H stays non-negative; approximate degrees are
+ *       floored at 0.1 of their mean.
+ */
+int decomp_mat_lowrank(size_t n, size_t r, size_t k, const double *Z, const double *H0, double **out);
+
+/**
+ * @brief Accuracy check: relative Frobenius error ||W - W_lowrank||_F / ||W||_F against the dense norm().
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param mat Input n×dim points.
+ * @param r Number of columns in Z.
+ * @param Z Input n×r factor built from the same points.
+ * @param out_err Receives the relative error.
+ * @return 1 on success, -1 on failure.
+ * @note Builds the dense n×n W, so meant for small inputs only.
+ */
+int lowrank_norm_error(size_t dim, size_t n, const double *mat, size_t r, const double *Z, double *out_err);
+
+/**
+ * @brief Fitted SymNMF model: everything needed to label a new point without rebuilding W.
+ */
+typedef struct SymnmfModel {
+    size_t n;  /**< Number of training points. */
+    size_t dim;  /**< Point dimension. */
+    size_t k;  /**< Number of clusters (columns of H). */
+    double *points;  /**< Training points n×dim (owned). */
+    double *degrees;  /**< Training degrees d_i = sum_j A_ij, length n (owned). */
+    double *H;  /**< Fitted decomposition n×k (owned). */
+    double *gram;  /**< Cached H^T H, k×k (owned). */
+} SymnmfModel;
+
+/**
+ * @brief Build a fitted model from training points and their final H (copies both, computes degrees once).
+ * @param dim Point dimension.
+ * @param n Number of training points.
+ * @param k Number of columns in H.
+ * @param points Input n×dim training points.
+ * @param H Input n×k fitted decomposition (e.g. output of decomp_mat).
+ * @param out_model Receives malloc'ed model; caller must model_free().
+ * @return 1 on success, -1 on invalid args or allocation failure.
+ */
+int model_create(size_t dim, size_t n, size_t k, const double *points, const double *H, SymnmfModel **out_model);
+
+/**
+ * @brief Project a new point onto a fitted model and return its H row and cluster label.
+ * @param model Fitted model.
+ * @param point New point (length model->dim).
+ * @param neighbors Use only the `neighbors` most similar training points (0 = all).
+ * @param out_h Receives the non-negative H row (length model->k, caller-allocated); may be NULL.
+ * @param out_label Receives the argmax of the H row.
+ * @return 1 on success, -1 on invalid args or allocation failure.
+ */
+int model_project(const SymnmfModel *model, const double *point, size_t neighbors, double *out_h, size_t *out_label);
+
+/**
+ * @brief Free a model returned by model_create (NULL is ignored).
+ * @param model Model to free.
+ */
+void model_free(SymnmfModel *model);
+
+/**
+ * @brief Order points along a Morton (Z-order) curve of their quantized coordinates (for locality / block structure of W).
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param mat Input n×dim points.
+ * @param perm Receives n point indices in curve order (caller-allocated).
+ * @return 1 on success, -1 on invalid args or allocation failure.
+ */
+int morton_order(size_t dim, size_t n, const double *mat, size_t *perm);
+
+/**
+ * @brief Read-only mapping of a cached (degrees, W) pair, see wcache_open.
+ */
+typedef struct WCache {
+    size_t n;  /**< Number of points. */
+    const double *degrees;  /**< Row sums of sym (length n, raw: 0 is not replaced by EPS). */
+    const double *W;  /**< n×n normalized matrix, as norm() computes it. */
+    void *map;  /**< Start of the mapping. */
+    size_t map_len;  /**< Mapping length in bytes. */
+} WCache;
+
+/**
+ * @brief Map the cached degrees and W for a point set, computing and storing them first on a miss.
+ * @param dir Cache directory (must exist).
+ * @param dim Point dimension.
+ * @param n Number of points.
+ * @param points Input n×dim points (the cache key: hashed for the file name, compared byte-wise on open).
+ * @param out Receives the mapping; release with wcache_close().
+ * @return 1 on success, -1 on invalid args, I/O or allocation failure.
+ * @note Files are written to a temporary name and renamed into place, so concurrent users only ever
+ *       see complete entries. A stale, truncated or colliding entry is recomputed and replaced.
+ */
+int wcache_open(const char *dir, size_t dim, size_t n, const double *points, WCache *out);
+
+/**
+ * @brief Unmap an entry returned by wcache_open.
+ * @param cache Entry to release (fields are reset).
+ */
+void wcache_close(WCache *cache);
 
 #endif /* SYMNMF_H */
\ No newline at end of file
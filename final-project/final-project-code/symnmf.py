@@ -1,5 +1,7 @@
 import symnmf_c_api as symnmf
+import os
 import sys
+import tempfile
 from typing import IO, List, Tuple
 import numpy as np
 np.random.seed(1234) # Seed set once, for the whole program
@@ -87,30 +89,170 @@ def read_and_check_row(f: IO[str], dim: int | None = None) -> Tuple[float, ...]
         except ValueError: raise ValueError("An Error Has Occurred")
     return tuple(point)
 
-def calculate_final_decomp_mat(points: List[Tuple[float]], k: int) -> List[List[float]]:
+def calculate_final_decomp_mat(points: List[Tuple[float]], k: int, landmarks: int = 0, seed: int = 1234, features: int = 0,
+                               block: int = 0, epochs: int = 1, solver: str = "mu", stats: bool = False,
+                               cache_dir: str | None = None, threads: int = 0, reorder: bool = False,
+                               sym_tol: float = 0.0) -> List[List[float]]:
     """Compute the final decomposition matrix for SymNMF.
 
     Steps:
-    1. Build normalized similarity matrix W from points.
+    1. Build normalized similarity matrix W from points (or a low-rank factor of it: Nystrom or random Fourier features).
     2. Initialize random non-negative decomposition matrix H0.
     3. Update H0 using the SymNMF decomposition routine.
 
     Args:
         points (list[list[float]]): Input data points.
         k (int): Number of clusters.
+        landmarks (int): If > 0, approximate W from this many sampled landmark points (O(n*m*k) per iteration).
+        seed (int): Seed for the landmark sampling / random features.
+        features (int): If > 0, approximate the Gaussian affinity with this many random Fourier features (the error of W
+            shrinks like 1/sqrt(features): use several hundred or more, about 1000 for ~0.3 relative error).
+        block (int): If > 0, use the mini-batch solver with this many rows per block; W is streamed from a temporary file.
+        epochs (int): Passes over all row blocks for the mini-batch solver.
+        solver (str): Dense decomposition engine: "mu" (multiplicative updates), "mu-lazy" (the same on the rows still
+            moving), "mu-sparse" (the same over the non-zero tiles of W), "mu-par" (the same on a thread pool), "ml" (multilevel: solve a coarsened graph, refine
+            on the way up) or "cd" (coordinate descent).
+        stats (bool): If True, print the engine's iteration count and final objective to stderr.
+        cache_dir (str | None): If set, W is mapped from (or computed once into) the on-disk cache in this directory.
+        threads (int): Pool size of the "mu-par" engine (0: one thread per online core).
+        reorder (bool): If True, compute in Morton-curve order of the points (nearby points adjacent, W close to
+            block-diagonal); H0 is drawn in input order and H is returned in input order, so the multiplicative
+            engines give the same H ("cd", "ml" and the mini-batch solver follow row order and may differ).
+        sym_tol (float): If > 0, affinities below it are dropped from W (whole far-apart tile pairs are never computed);
+            0 keeps W exact. Not combined with cache_dir.
 
     Returns:
         list[list[float]]: Updated decomposition matrix H."""
-    norm_mat = symnmf.py_norm(points) # Calculate W from points and convert to numpy Object
+    order = symnmf.py_morton(points) if reorder else None # order[i] = input index of the point computed as row i
+    if order is not None: points = [points[i] for i in order]
+
+    if landmarks > 0 or features > 0: # Low-rank mode: W is only ever held as a thin factor
+        if landmarks > 0 and features > 0: raise ValueError("An Error Has Occurred")
+        factor = symnmf.py_nystrom(points, landmarks, seed) if landmarks > 0 else symnmf.py_rff(points, features, seed)
+        decomp_mat_list_form = init_decomp_mat(len(points), k, symnmf.py_lowrank_mean(factor), order)
+        return restore_order(symnmf.py_lowrank_decomp(factor, decomp_mat_list_form), order)
+
+    if block > 0: # Mini-batch mode: W goes to disk row by row and is read back one row block per step
+        with tempfile.TemporaryDirectory() as tmp_dir:
+            norm_path = os.path.join(tmp_dir, "norm.bin")
+            norm_mean = symnmf.py_norm_to_file(points, norm_path)
+            decomp_mat_list_form = init_decomp_mat(len(points), k, norm_mean, order)
+            return restore_order(symnmf.py_decomp_minibatch(norm_path, decomp_mat_list_form, block, epochs, seed), order)
+
+    tile_mask = None # "mu-sparse": the tiles of W that sym computed, so it need not scan W for them (None for a cached W)
+    if solver == "mu-sparse": norm_mat, tile_mask = symnmf.py_norm(points, cache_dir, sym_tol, 1)
+    else: norm_mat = symnmf.py_norm(points, cache_dir, sym_tol) # Calculate (or load cached) W from points and convert to numpy Object
     norm_mat_np = np.array(norm_mat) # np form for np functs usage
 
     norm_mean = np.mean(norm_mat_np) # Average of all entries in norm
+    decomp_mat_list_form = init_decomp_mat(norm_mat_np.shape[0], k, norm_mean, order)
+
+    if not stats: return restore_order(symnmf.py_decomp(norm_mat, decomp_mat_list_form, solver, 0, threads, tile_mask), order)
+    updated_decomp_mat, iters, objective = symnmf.py_decomp(norm_mat, decomp_mat_list_form, solver, 1, threads, tile_mask)
+    print(f"solver={solver} iters={iters} objective={objective:.6f}", file=sys.stderr)
+    return restore_order(updated_decomp_mat, order)
+
+def init_decomp_mat(n: int, k: int, norm_mean: float, order: List[int] | None = None) -> List[List[float]]:
+    """Draw the random non-negative initial decomposition matrix H0.
+
+    Args:
+        n (int): Number of points.
+        k (int): Number of clusters.
+        norm_mean (float): Average of all entries in W.
+        order (list[int] | None): If set, rows are computed in this order (order[i] = input index of row i): the draw
+            is made in input order and its rows are permuted to match, so every point gets the same H0 row.
+
+    Returns:
+        list[list[float]]: H0 of shape (n x k), entries uniform in [0, 2*sqrt(norm_mean/k))."""
     scale = 2 * np.sqrt(norm_mean / k)
-    decomp_mat = np.random.uniform(0, scale, size=(norm_mat_np.shape[0], k)) # Initianize decomp(0) np
-    decomp_mat_list_form = decomp_mat.tolist()  # Transfer decomp_mat np to list[list[double]]
+    decomp_mat = np.random.uniform(0, scale, size=(n, k)) # Initianize decomp(0) np
+    if order is not None: decomp_mat = decomp_mat[order]
+    return decomp_mat.tolist() # Transfer decomp_mat np to list[list[double]]
+
+def restore_order(rows: list, order: List[int] | None) -> list:
+    """Put rows computed in `order` back in input order (inverse of rows = [input[i] for i in order]).
 
-    updated_decomp_mat = symnmf.py_decomp(norm_mat, decomp_mat_list_form)
-    return updated_decomp_mat
+    Args:
+        rows (list): Per-point rows (or labels) in computed order.
+        order (list[int] | None): order[i] = input index of row i; None means rows are already in input order.
+
+    Returns:
+        list: The rows in input order."""
+    if order is None: return rows
+    restored = [None] * len(rows)
+    for i, input_index in enumerate(order): restored[input_index] = rows[i]
+    return restored
+
+def sweep_decomp(points: List[Tuple[float]], ks: List[int], cache_dir: str | None = None,
+                 reorder: bool = False) -> List[Tuple[List[List[float]], List[int], int, float]]:
+    """Fit SymNMF for several k from one W (built once in C, never marshalled to Python).
+
+    All k run together: each iteration makes one pass over W for the H blocks of every k still running.
+    Every k starts from the H0 a separate run would draw (same seed, same uniforms, same scaling).
+
+    Args:
+        points (list[list[float]]): Input data points.
+        ks (list[int]): Numbers of clusters (each 1 < k < n).
+        cache_dir (str | None): If set, W is mapped from (or computed once into) the on-disk cache in this directory.
+        reorder (bool): If True, compute in Morton-curve order (see calculate_final_decomp_mat); results in input order.
+
+    Returns:
+        list[tuple]: Per k, in order: (H, labels (row argmax of H), iterations, objective ||W - H H^T||_F^2)."""
+    order = symnmf.py_morton(points) if reorder else None
+    if order is not None: points = [points[i] for i in order]
+    draws = [np.random.RandomState(1234).uniform(0, 1, size=(len(points), k)) for k in ks] # as a fresh run's first draw
+    fits = symnmf.py_sweep(points, [(draw if order is None else draw[order]).tolist() for draw in draws], cache_dir)
+    return [(restore_order(H, order), restore_order(labels, order), iters, objective) for H, labels, iters, objective in fits]
+
+def parse_options(args: List[str]) -> dict:
+    """Parse optional trailing `--name=value` arguments.
+
+    Args:
+        args (list[str]): Arguments after the file path.
+
+    Returns:
+        dict: Option values by name (missing options take their defaults).
+
+    Raises:
+        ValueError: On unknown options or invalid values."""
+    options = {"nystrom": 0, "rff": 0, "seed": 1234, "minibatch": 0, "epochs": 1, "solver": "mu", "stats": 0, "cache-dir": "", "threads": 0, "reorder": "", "sym-tol": 0.0}
+    choices = {"solver": {"mu", "mu-lazy", "mu-sparse", "mu-par", "ml", "cd"}, "reorder": {"morton"}} # Restricted string options take one of a fixed set of values
+    for arg in args:
+        name, sep, value = arg[2:].partition("=")
+        if not arg.startswith("--") or not sep or name not in options: raise ValueError("An Error Has Occurred")
+        if isinstance(options[name], str): # String options (non-empty)
+            if not value or (name in choices and value not in choices[name]): raise ValueError("An Error Has Occurred")
+            options[name] = value; continue
+        try:
+            options[name] = float(value) if isinstance(options[name], float) else int(value) # float options keep a float default
+        except ValueError: raise ValueError("An Error Has Occurred")
+        if not 0 <= options[name] < float("inf"): raise ValueError("An Error Has Occurred") # also rejects nan
+    return options
+
+def fit_model(points: List[Tuple[float]], k: int):
+    """Fit SymNMF once and keep what is needed to label new points later.
+
+    Args:
+        points (list[list[float]]): Training points.
+        k (int): Number of clusters.
+
+    Returns:
+        object: Opaque model (training points, their degrees and the final H) for assign_point."""
+    updated_decomp_mat = calculate_final_decomp_mat(points, k)
+    return symnmf.py_model(points, updated_decomp_mat)
+
+def assign_point(model, point: Tuple[float, ...], neighbors: int = 0) -> int:
+    """Label a new point against a fitted model without rebuilding W.
+
+    Args:
+        model: Model returned by fit_model.
+        point (tuple[float, ...]): New point, same dimension as the training points.
+        neighbors (int): Use only this many most similar training points (0 = all of them).
+
+    Returns:
+        int: Cluster index (argmax of the point's projected H row)."""
+    label, _ = symnmf.py_project(model, point, neighbors)
+    return label
 
 def print_matrix(mat: List[List[float]]) -> None:
     """Print a matrix with 4-decimal formatting.
@@ -130,38 +272,57 @@ def main():
     """CLI entry point for SymNMF tasks.
 
     Usage (argv):
-        argv[1] = k (int), with 1 < k < n
-        argv[2] = goal: one of {"symnmf", "sym", "ddg", "norm"}
+        argv[1] = k (int), with 1 < k < n; for goal "sweep", a comma-separated list of k values (e.g. 2,3,4,5)
+        argv[2] = goal: one of {"symnmf", "sym", "ddg", "norm", "sweep"}
         argv[3] = path to input file
+        argv[4:] = optional `--nystrom=M` (approximate W from M landmarks), `--rff=F` (F random Fourier features),
+                   `--minibatch=B` (mini-batch solver, B rows per block), `--epochs=E` (mini-batch passes),
+                   `--seed=S` (landmark / feature / block-order seed), `--solver=mu|mu-lazy|mu-sparse|mu-par|ml|cd` (dense decomposition engine),
+                   `--threads=T` (pool size of mu-par; default one per core), `--reorder=morton` (compute in Morton-curve
+                   order of the points; output stays in input order; goals symnmf, sweep), `--sym-tol=X` (drop affinities below X from W),
+                   `--stats=1` (print iterations and final objective to stderr),
+                   `--cache-dir=DIR` (map W and degrees from an on-disk cache in DIR; goals ddg, norm, symnmf)
 
     Behavior:
         - Reads points from file into list[tuple[float, ...]] and infers dim.
         - For goal: compute relevant matrix ()using C-python API) and print it
+        - For goal "sweep": build W once, fit H for every k and print one summary line per k
     
     Output:
-        Prints the resulting matrix using print_matrix (comma-separated, 4 decimals).
+        Prints the resulting matrix using print_matrix (comma-separated, 4 decimals);
+        for "sweep", lines "k=<k> iters=<iterations> objective=<||W - H H^T||_F^2, 4 decimals>".
 
     Errors:
         On invalid args, file/IO, or memory issues: prints "An Error Has Occurred" and exits(1)."""
     
     try:
         # Step 1: validate args and create points list
-        if len(sys.argv) != 4: # Argv num check (argv[1] = k, argv[2] = goal, argv[3] = file path)
+        if len(sys.argv) < 4: # Argv num check (argv[1] = k, argv[2] = goal, argv[3] = file path, then options)
             raise ValueError("An Error Has Occurred")
+        options = parse_options(sys.argv[4:])
+        cache_dir = options["cache-dir"] or None
         goal = sys.argv[2] # Validate goal
-        if goal not in {"symnmf", "sym", "ddg", "norm"}:
+        if goal not in {"symnmf", "sym", "ddg", "norm", "sweep"}:
             raise ValueError("An Error Has Occurred")
         with open(sys.argv[3], "r") as f: # Validate and read pooints to list[tuple[float, ...]] and calculate dim of points
             points = file_validate_and_to_point_list(f)
+        if goal == "sweep": # k list: every value 1 < k < n
+            ks = [int(k_str) for k_str in sys.argv[1].split(",")]
+            if not all(1 < k < len(points) for k in ks): raise ValueError("An Error Has Occurred")
+            for k, (_, _, iters, objective) in zip(ks, sweep_decomp(points, ks, cache_dir, options["reorder"] == "morton")):
+                print(f"k={k} iters={iters} objective={objective:.4f}")
+            return
         k = int(sys.argv[1]) # Validate k
         if (goal == "symnmf "and not 1 < k < len(points)):
             raise ValueError("An Error Has Occurred")
         
         # Step 2: run algorithm determined by "goal" - and print result
         if goal == "sym": sym_mat = symnmf.py_sym(points); print_matrix(sym_mat)
-        elif goal == "ddg": ddg_mat = symnmf.py_ddg(points); print_matrix(ddg_mat)
-        elif goal == "norm": norm_mat = symnmf.py_norm(points); print_matrix(norm_mat)
-        else: updated_decomp_mat = calculate_final_decomp_mat(points, k); print_matrix(updated_decomp_mat) #goal = "symnmf"
+        elif goal == "ddg": ddg_mat = symnmf.py_ddg(points, cache_dir); print_matrix(ddg_mat)
+        elif goal == "norm": norm_mat = symnmf.py_norm(points, cache_dir); print_matrix(norm_mat)
+        else: updated_decomp_mat = calculate_final_decomp_mat(points, k, options["nystrom"], options["seed"], options["rff"], options["minibatch"], options["epochs"],
+                                                                options["solver"], options["stats"] > 0, cache_dir, options["threads"],
+                                                                options["reorder"] == "morton", options["sym-tol"]); print_matrix(updated_decomp_mat) #goal = "symnmf"
         
     except (ValueError, OSError, MemoryError) as e: # Make sure all raises exceptions will catch
         print(e); sys.exit(1)
@@ -1,17 +1,34 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
 #include <stdlib.h>
+#include <math.h>
 #include "symnmf.h"
 
+#define MODEL_CAPSULE_NAME "symnmf_c_api.model"
+
 /* Functions prototype declarations */
 static int py_parse_points(PyObject *args, PyObject** out_points_obj);
-static int extract_rowsdim_and_colsdim(PyObject *points_obj, int *n, int *dim);
-static int py_points_to_c_points(PyObject* mat_obj, int n, int dim_or_k, double **out_mat);
-static int build_py_object_mat(int n, int k, double *mat, PyObject **py_mat_out);
+static int extract_rowsdim_and_colsdim(PyObject *points_obj, Py_ssize_t *n, Py_ssize_t *dim);
+static int py_points_to_c_points(PyObject* mat_obj, Py_ssize_t n, Py_ssize_t dim_or_k, double **out_mat);
+static int build_py_object_mat(Py_ssize_t n, Py_ssize_t k, const double *mat, PyObject **py_mat_out);
 static PyObject* py_sym(PyObject *self, PyObject *args);
 static PyObject* py_ddg(PyObject *self, PyObject *args);
 static PyObject* py_norm(PyObject *self, PyObject *args);
 static PyObject* py_decomp(PyObject *self, PyObject *args);
+static PyObject* py_model(PyObject *self, PyObject *args);
+static PyObject* py_project(PyObject *self, PyObject *args);
+static void model_capsule_free(PyObject *capsule);
+static PyObject* py_norm_to_file(PyObject *self, PyObject *args);
+static PyObject* py_decomp_minibatch(PyObject *self, PyObject *args);
+static PyObject* py_nystrom(PyObject *self, PyObject *args);
+static PyObject* py_rff(PyObject *self, PyObject *args);
+static PyObject* py_lowrank_mean(PyObject *self, PyObject *args);
+static PyObject* py_lowrank_decomp(PyObject *self, PyObject *args);
+static PyObject* py_lowrank_error(PyObject *self, PyObject *args);
+static PyObject* py_sweep(PyObject *self, PyObject *args);
+static PyObject* build_py_sweep_fit(Py_ssize_t n, const SweepFit *fit);
+static PyObject* py_morton(PyObject *self, PyObject *args);
+static PyObject* py_batch(PyObject *self, PyObject *args);
 
 /**
  * @brief Python wrapper: build S = sym(points) and return as list-of-lists.
@@ -22,7 +39,7 @@ static PyObject* py_decomp(PyObject *self, PyObject *args);
 static PyObject* py_sym(PyObject *self, PyObject *args) {
     /* Step 1: parse args to a c points matrix */
     PyObject *points_obj, *py_mat;
-    int n, dim;
+    Py_ssize_t n, dim;
     double *points = NULL;
     double *sym_mat = NULL;
 
@@ -45,32 +62,47 @@ static PyObject* py_sym(PyObject *self, PyObject *args) {
 /**
  * @brief Python wrapper: compute D = ddg(sym(points)) and return as list-of-lists.
  * @param self CPython self/module (unused).
- * @param args Python tuple: one object `points` (n×dim sequence).
+ * @param args Python tuple: (points=n×dim sequence[, cache_dir=None]); with cache_dir, degrees are read from the W cache.
  * @return New PyObject* (n×n list of lists) on success; NULL on error (sets exception).
  */
 static PyObject* py_ddg(PyObject *self, PyObject *args) {
 
     PyObject *points_obj, *py_mat;
-    int n, dim;
+    const char *cache_dir = NULL;
+    WCache cache;
+    Py_ssize_t n, dim, i;
     double *points = NULL;
     double *sym_mat = NULL;
     double *ddg_mat = NULL;
+    unsigned char *mask = NULL;
 
     (void)self; /* silence unused parameter under -Wall -Wextra -Werror */
 
     /* Step 1: parse args to a c points matrix */
-    if (py_parse_points(args, &points_obj) == -1) {return NULL;}
+    if (!PyArg_ParseTuple(args, "O|z", &points_obj, &cache_dir)) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
     
     if (extract_rowsdim_and_colsdim(points_obj, &n, &dim) == -1) {return NULL;} /* extract n and dim */
     if (py_points_to_c_points(points_obj, n, dim, &points) == -1) {return NULL;} /* transfer py matrix to c matrix */
 
-    /* Step 2: call C function and calculate sym matrix from points */
-    if (sym(dim, n,points, &sym_mat) == -1) {free(points); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    if (cache_dir) { /* Degrees come from the mapped cache entry (computed and stored on a miss) */
+        if (wcache_open(cache_dir, dim, n, points, &cache) == -1) {free(points); PyErr_SetString(PyExc_OSError, "An Error Has Occurred"); return NULL;}
+        free(points);
+        ddg_mat = calloc((size_t)n * n, sizeof *ddg_mat);
+        if (!ddg_mat) {wcache_close(&cache); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+        for (i = 0; i < n; i++) {ddg_mat[i * n + i] = cache.degrees[i];}
+        wcache_close(&cache);
+        if (build_py_object_mat(n, n, ddg_mat, &py_mat) == -1) {free(ddg_mat); return NULL;}
+        free(ddg_mat);
+        return py_mat;
+    }
+
+    /* Step 2: call C function and calculate sym matrix from points, with the mask of its computed tiles */
+    if (sym_pruned(dim, n, points, 0.0, &sym_mat, &mask) == -1) {free(points); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
     free(points);
     
-    /* Step 3: call C function and calculate ddg matrix from sym matrix */
-    if (ddg(n, sym_mat, &ddg_mat) == -1) {free(sym_mat); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
-    free(sym_mat);
+    /* Step 3: call C function and calculate ddg matrix from the computed tiles of sym */
+    if (ddg_tiled(n, sym_mat, mask, &ddg_mat) == -1) {free(sym_mat); free(mask); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    free(sym_mat); free(mask);
 
     /* Step 4: build python ddg matrice (list of lists) and return it */
     if (build_py_object_mat(n, n, ddg_mat, &py_mat) == -1) {free(ddg_mat); return NULL;}
@@ -81,50 +113,78 @@ static PyObject* py_ddg(PyObject *self, PyObject *args) {
 /**
  * @brief Python wrapper: compute N = norm(sym(points), ddg(sym(points))) and return as list-of-lists.
  * @param self CPython self/module (unused).
- * @param args Python tuple: one object `points` (n×dim sequence).
- * @return New PyObject* (n×n list of lists) on success; NULL on error (sets exception).
+ * @param args Python tuple: (points=n×dim sequence[, cache_dir=None[, tol=0.0[, with_mask=0]]]); with cache_dir, W is
+ *             mapped from the W cache; with tol > 0 (no cache), affinities below tol are dropped (sym_pruned).
+ * @return New PyObject* (n×n list of lists), or (W, mask) when with_mask: mask is the bytes of the sym_pruned tile mask
+ *         (for py_decomp's "mu-sparse"), None for a cached W; NULL on error (sets exception).
  */
 static PyObject* py_norm(PyObject *self, PyObject *args) {
     /* Step 1: parse args to a c points matrix */
     PyObject *points_obj, *py_mat;
-    int n, dim;
+    const char *cache_dir = NULL;
+    WCache cache;
+    Py_ssize_t n, dim;
+    double tol = 0.0;
     double *points = NULL;
     double *sym_mat = NULL;
     double *ddg_mat = NULL;
     double *norm_mat = NULL;
+    unsigned char *mask = NULL;
+    int with_mask = 0;
+    size_t tiles;
 
     (void)self; /* silence unused parameter under -Wall -Wextra -Werror */
     
-    if (py_parse_points(args, &points_obj) == -1) {return NULL;} /* extract PyObject points */
+    if (!PyArg_ParseTuple(args, "O|zdi", &points_obj, &cache_dir, &tol, &with_mask)) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;} /* extract PyObject points */
+    if (tol < 0.0 || (tol > 0.0 && cache_dir)) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;} /* the cache holds the exact W only */
     if (extract_rowsdim_and_colsdim(points_obj, &n, &dim) == -1) {return NULL;} /* extract n and dim */
     if (py_points_to_c_points(points_obj, n, dim, &points) == -1) return NULL; /* transfer py matrix to c matrix */
 
-    /* Step 2: call C function and calculate sym matrix from points */
-    if (sym(dim ,n ,points, &sym_mat) == -1) {free(points); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    if (cache_dir) { /* W comes from the mapped cache entry (computed and stored on a miss) */
+        if (wcache_open(cache_dir, dim, n, points, &cache) == -1) {free(points); PyErr_SetString(PyExc_OSError, "An Error Has Occurred"); return NULL;}
+        free(points);
+        if (build_py_object_mat(n, n, cache.W, &py_mat) == -1) {wcache_close(&cache); return NULL;}
+        wcache_close(&cache);
+        if (with_mask) {return Py_BuildValue("(NO)", py_mat, Py_None);}
+        return py_mat;
+    }
+
+    /* Step 2: call C function and calculate sym matrix from points, with the mask of its computed tiles */
+    if (sym_pruned(dim ,n ,points, tol, &sym_mat, &mask) == -1) {free(points); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
     free(points);
     
-    /* Step 3: call C function and calculate ddg matrix from sym matrix */
-    if (ddg(n, sym_mat, &ddg_mat) == -1) {free(sym_mat); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    /* Step 3: call C function and calculate ddg matrix from the computed tiles of sym */
+    if (ddg_tiled(n, sym_mat, mask, &ddg_mat) == -1) {free(sym_mat); free(mask); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
 
-    /*Step 4: call C function and calculate norm matrix from sym and ddg matrix */
-    if (norm(n, sym_mat, ddg_mat, &norm_mat) == -1) {free(sym_mat); free(ddg_mat); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    /*Step 4: call C function and calculate norm matrix over the same tiles */
+    if (norm_tiled(n, sym_mat, ddg_mat, mask, &norm_mat) == -1) {free(sym_mat); free(ddg_mat); free(mask); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
     free(sym_mat); free(ddg_mat);
 
-    /* Step 5: build python norm matrice (list of lists) and return it */
-    if (build_py_object_mat(n, n, norm_mat, &py_mat) == -1) {free(norm_mat); return NULL;}
+    /* Step 5: build python norm matrice (list of lists) and return it, with the mask if asked */
+    if (build_py_object_mat(n, n, norm_mat, &py_mat) == -1) {free(norm_mat); free(mask); return NULL;}
     free(norm_mat);
+    tiles = sym_tile_count((size_t)n);
+    if (with_mask) {py_mat = Py_BuildValue("(Ny#)", py_mat, (const char *)mask, (Py_ssize_t)(tiles * tiles));}
+    free(mask);
     return py_mat;
 }
 
 /**
  * @brief Python wrapper: update decomposition H from norm matrix and initial H0.
  * @param self CPython self/module (unused).
- * @param args Python tuple: (norm_obj=n×n, decomp_obj=n×k).
- * @return New PyObject* (n×k list of lists) on success; NULL on error (sets exception).
+ * @param args Python tuple: (norm_obj=n×n, decomp_obj=n×k[, solver="mu"|"mu-lazy"|"mu-sparse"|"mu-par"|"ml"|"cd"[, with_stats=0[, threads=0[, mask=None]]]]);
+ *             threads (>= 1) sets the pool size of "mu-par" (0: one per online core); mask (the bytes py_norm returns
+ *             with with_mask) gives "mu-sparse" the computed tiles of W instead of a scan of W.
+ * @return New PyObject* (n×k list of lists), or (H, iters, objective) when with_stats; NULL on error (sets exception).
  */
 static PyObject* py_decomp(PyObject *self, PyObject *args) {
     PyObject *norm_obj, *decomp_obj, *py_mat;
-    int n, k;
+    const char *solver = "mu";
+    Py_ssize_t n, k;
+    int with_stats = 0, threads = 0, status;
+    PyObject *mask_obj = Py_None;
+    const unsigned char *mask = NULL;
+    DecompStats stats;
     double *norm_mat = NULL;
     double *decomp_mat_0 = NULL;
     double *updated_decomp_mat = NULL;
@@ -132,10 +192,15 @@ static PyObject* py_decomp(PyObject *self, PyObject *args) {
     (void)self; /* Silence unused parameter under -Wall -Wextra -Werror */
 
     /* Step 1: extract and validate points PyObject from py args */
-    if (!PyArg_ParseTuple(args, "OO", &norm_obj, &decomp_obj)) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;} /*get python objects W and H_0*/
+    if (!PyArg_ParseTuple(args, "OO|siiO", &norm_obj, &decomp_obj, &solver, &with_stats, &threads, &mask_obj)) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;} /*get python objects W and H_0*/
+    if (!decomp_solver(solver) || threads < 0) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;} /* unknown engine */
     
     /* Extract n and k */
     if (extract_rowsdim_and_colsdim(decomp_obj, &n, &k) == -1) return NULL;
+    if (mask_obj != Py_None) { /* tile mask of W, one byte per tile pair */
+        if (!PyBytes_Check(mask_obj) || (size_t)PyBytes_GET_SIZE(mask_obj) != sym_tile_count((size_t)n) * sym_tile_count((size_t)n)) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+        mask = (const unsigned char *)PyBytes_AS_STRING(mask_obj); /* kept alive by args while the GIL is released */
+    }
 
     /* Transfer py norm matrix to c matrix */
     if (py_points_to_c_points(norm_obj, n, n, &norm_mat) == -1) return NULL;
@@ -144,32 +209,554 @@ static PyObject* py_decomp(PyObject *self, PyObject *args) {
     if (py_points_to_c_points(decomp_obj, n, k, &decomp_mat_0) == -1) {free(norm_mat); return NULL;}
 
     /* Step 2: call C function and calculate updated_decomp matrix from norm and decomp matrix */
-    if (decomp_mat(n, k, norm_mat ,decomp_mat_0 ,&updated_decomp_mat) == -1) {free(norm_mat); free(decomp_mat_0); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    Py_BEGIN_ALLOW_THREADS /* pure C from here: other Python threads may run meanwhile */
+    if (strcmp(solver, "mu-par") == 0) {status = decomp_mat_parallel(n, k, norm_mat, decomp_mat_0, threads, &updated_decomp_mat, with_stats ? &stats : NULL);}
+    else if (strcmp(solver, "mu-sparse") == 0) {status = decomp_mat_sparse(n, k, norm_mat, mask, decomp_mat_0, &updated_decomp_mat, with_stats ? &stats : NULL);}
+    else {status = decomp_mat_solver(solver, n, k, norm_mat ,decomp_mat_0 ,&updated_decomp_mat, with_stats ? &stats : NULL);}
+    Py_END_ALLOW_THREADS
+    if (status == -1) {free(norm_mat); free(decomp_mat_0); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
     free(norm_mat); free(decomp_mat_0);
 
+    /* Step 3: build python updated_decomp matrice (list of lists) and return it */
+    if (build_py_object_mat(n, k, updated_decomp_mat, &py_mat) == -1) {free(updated_decomp_mat); return NULL;}
+    free(updated_decomp_mat);
+    if (with_stats) {return Py_BuildValue("(Nid)", py_mat, stats.iters, stats.objective);}
+    return py_mat;
+}
+
+/**
+ * @brief Python wrapper: build a fitted model (training points, degrees, H) for labeling new points.
+ * @param self CPython self/module (unused).
+ * @param args Python tuple: (points=n×dim, H=n×k final decomposition).
+ * @return New PyCapsule holding the model on success; NULL on error (sets exception).
+ */
+static PyObject* py_model(PyObject *self, PyObject *args) {
+    PyObject *points_obj, *decomp_obj, *capsule;
+    Py_ssize_t n, dim, n_decomp, k;
+    double *points = NULL;
+    double *decomp = NULL;
+    SymnmfModel *model = NULL;
+
+    (void)self; /* Silence unused parameter under -Wall -Wextra -Werror */
+
+    /* Step 1: parse args to c points and H matrices (same number of rows) */
+    if (!PyArg_ParseTuple(args, "OO", &points_obj, &decomp_obj)) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    if (extract_rowsdim_and_colsdim(points_obj, &n, &dim) == -1) return NULL;
+    if (extract_rowsdim_and_colsdim(decomp_obj, &n_decomp, &k) == -1) return NULL;
+    if (n_decomp != n) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    if (py_points_to_c_points(points_obj, n, dim, &points) == -1) return NULL;
+    if (py_points_to_c_points(decomp_obj, n, k, &decomp) == -1) {free(points); return NULL;}
+
+    /* Step 2: call C function and build the model (copies points and H) */
+    if (model_create(dim, n, k, points, decomp, &model) == -1) {free(points); free(decomp); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    free(points); free(decomp);
+
+    /* Step 3: hand the model to Python as a capsule that frees it on collection */
+    capsule = PyCapsule_New(model, MODEL_CAPSULE_NAME, model_capsule_free);
+    if (!capsule) {model_free(model); return NULL;}
+    return capsule;
+}
+
+/**
+ * @brief Python wrapper: label a new point against a fitted model.
+ * @param self CPython self/module (unused).
+ * @param args Python tuple: (model capsule, point of length dim[, neighbors=0 for all training points]).
+ * @return New tuple (label, H row as list of k floats) on success; NULL on error (sets exception).
+ */
+static PyObject* py_project(PyObject *self, PyObject *args) {
+    PyObject *capsule, *point_obj, *wrapped, *py_mat, *h_row;
+    SymnmfModel *model;
+    Py_ssize_t neighbors = 0;
+    size_t label;
+    double *point = NULL;
+    double *h = NULL;
+
+    (void)self; /* Silence unused parameter under -Wall -Wextra -Werror */
+
+    /* Step 1: extract the model and the point (as a 1×dim matrix) */
+    if (!PyArg_ParseTuple(args, "OO|n", &capsule, &point_obj, &neighbors) || neighbors < 0) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    model = (SymnmfModel *)PyCapsule_GetPointer(capsule, MODEL_CAPSULE_NAME);
+    if (!model) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    wrapped = PyTuple_Pack(1, point_obj);
+    if (!wrapped) return NULL;
+    if (py_points_to_c_points(wrapped, 1, (Py_ssize_t)model->dim, &point) == -1) {Py_DECREF(wrapped); return NULL;}
+    Py_DECREF(wrapped);
+
+    /* Step 2: call C function and project the point */
+    h = malloc(model->k * sizeof *h);
+    if (!h) {free(point); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    if (model_project(model, point, (size_t)neighbors, h, &label) == -1) {free(point); free(h); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    free(point);
+
+    /* Step 3: build (label, h) and return it */
+    if (build_py_object_mat(1, (Py_ssize_t)model->k, h, &py_mat) == -1) {free(h); return NULL;}
+    free(h);
+    h_row = PyList_GET_ITEM(py_mat, 0);
+    Py_INCREF(h_row);
+    Py_DECREF(py_mat);
+    return Py_BuildValue("(nN)", (Py_ssize_t)label, h_row);
+}
+
+/**
+ * @brief Capsule destructor: free the SymnmfModel owned by a py_model capsule.
+ * @param capsule Capsule being collected.
+ */
+static void model_capsule_free(PyObject *capsule) {
+    model_free((SymnmfModel *)PyCapsule_GetPointer(capsule, MODEL_CAPSULE_NAME));
+}
+
+/**
+ * @brief Python wrapper: write W = norm(points) row by row to a binary file (for py_decomp_minibatch).
+ * @param self CPython self/module (unused).
+ * @param args Python tuple: (points=n×dim, path).
+ * @return New PyFloat with the mean entry of W on success; NULL on error (sets exception).
+ */
+static PyObject* py_norm_to_file(PyObject *self, PyObject *args) {
+    PyObject *points_obj;
+    const char *path;
+    FILE *out;
+    Py_ssize_t n, dim;
+    int status;
+    double *points = NULL;
+    double mean;
+
+    (void)self; /* Silence unused parameter under -Wall -Wextra -Werror */
+
+    /* Step 1: parse args to a c points matrix */
+    if (!PyArg_ParseTuple(args, "Os", &points_obj, &path)) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    if (extract_rowsdim_and_colsdim(points_obj, &n, &dim) == -1) return NULL;
+    if (py_points_to_c_points(points_obj, n, dim, &points) == -1) return NULL;
+
+    /* Step 2: call C function and stream W to the file */
+    out = fopen(path, "wb");
+    if (!out) {free(points); PyErr_SetString(PyExc_OSError, "An Error Has Occurred"); return NULL;}
+    status = norm_to_file(dim, n, points, out, &mean);
+    free(points);
+    if (fclose(out) != 0 || status == -1) {PyErr_SetString(PyExc_OSError, "An Error Has Occurred"); return NULL;}
+    return PyFloat_FromDouble(mean);
+}
+
+/**
+ * @brief Python wrapper: mini-batch decomposition H from W (n×n list, or path of a py_norm_to_file output) and H0.
+ * @param self CPython self/module (unused).
+ * @param args Python tuple: (norm_obj or path, decomp_obj=n×k, block, epochs, seed).
+ * @return New PyObject* (n×k list of lists) on success; NULL on error (sets exception).
+ */
+static PyObject* py_decomp_minibatch(PyObject *self, PyObject *args) {
+    PyObject *norm_obj, *decomp_obj, *py_mat;
+    Py_ssize_t n, k, block;
+    int epochs, status;
+    unsigned long seed;
+    double *norm_mat = NULL;
+    double *decomp_mat_0 = NULL;
+    double *updated_decomp_mat = NULL;
+    WRows src;
+
+    (void)self; /* Silence unused parameter under -Wall -Wextra -Werror */
+
+    /* Step 1: extract H0, then W either as a matrix or as a file to stream row blocks from */
+    if (!PyArg_ParseTuple(args, "OOnik", &norm_obj, &decomp_obj, &block, &epochs, &seed) || block <= 0 || epochs <= 0) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    if (extract_rowsdim_and_colsdim(decomp_obj, &n, &k) == -1) return NULL;
+    if (py_points_to_c_points(decomp_obj, n, k, &decomp_mat_0) == -1) return NULL;
+    src.n = (size_t)n; src.W = NULL; src.file = NULL; src.offset = 0;
+    if (PyUnicode_Check(norm_obj)) {
+        src.file = fopen(PyUnicode_AsUTF8(norm_obj), "rb");
+        if (!src.file) {free(decomp_mat_0); PyErr_SetString(PyExc_OSError, "An Error Has Occurred"); return NULL;}
+    }
+    else {
+        if (py_points_to_c_points(norm_obj, n, n, &norm_mat) == -1) {free(decomp_mat_0); return NULL;}
+        src.W = norm_mat;
+    }
+
+    /* Step 2: call C function and calculate updated_decomp matrix block by block */
+    status = decomp_mat_minibatch(&src, k, decomp_mat_0, block, epochs, seed, &updated_decomp_mat);
+    if (src.file) {fclose(src.file);}
+    free(norm_mat); free(decomp_mat_0);
+    if (status == -1) {PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+
+    /* Step 3: build python updated_decomp matrice (list of lists) and return it */
+    if (build_py_object_mat(n, k, updated_decomp_mat, &py_mat) == -1) {free(updated_decomp_mat); return NULL;}
+    free(updated_decomp_mat);
+    return py_mat;
+}
+
+/**
+ * @brief Python wrapper: Nyström factor Z (A + I ≈ Z Z^T) from m sampled landmark points.
+ * @param self CPython self/module (unused).
+ * @param args Python tuple: (points=n×dim, m landmarks, seed).
+ * @return New PyObject* (n×r list of lists, r <= m) on success; NULL on error (sets exception).
+ */
+static PyObject* py_nystrom(PyObject *self, PyObject *args) {
+    PyObject *points_obj, *py_mat;
+    Py_ssize_t n, dim, m;
+    size_t r;
+    unsigned long seed;
+    double *points = NULL;
+    double *factor = NULL;
+
+    (void)self; /* Silence unused parameter under -Wall -Wextra -Werror */
+
+    /* Step 1: parse args to a c points matrix */
+    if (!PyArg_ParseTuple(args, "Onk", &points_obj, &m, &seed) || m <= 0) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    if (extract_rowsdim_and_colsdim(points_obj, &n, &dim) == -1) return NULL;
+    if (py_points_to_c_points(points_obj, n, dim, &points) == -1) return NULL;
+
+    /* Step 2: call C function and build the thin factor */
+    if (nystrom_factor(dim, n, points, m, seed, &factor, &r) == -1) {free(points); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    free(points);
+
+    /* Step 3: build python factor matrice (list of lists) and return it */
+    if (build_py_object_mat(n, (Py_ssize_t)r, factor, &py_mat) == -1) {free(factor); return NULL;}
+    free(factor);
+    return py_mat;
+}
+
+/**
+ * @brief Python wrapper: random Fourier feature factor Z (A + I ≈ Z Z^T) with F features.
+ * @param self CPython self/module (unused).
+ * @param args Python tuple: (points=n×dim, F features, seed).
+ * @return New PyObject* (n×F list of lists) on success; NULL on error (sets exception).
+ */
+static PyObject* py_rff(PyObject *self, PyObject *args) {
+    PyObject *points_obj, *py_mat;
+    Py_ssize_t n, dim, features;
+    unsigned long seed;
+    double *points = NULL;
+    double *factor = NULL;
+
+    (void)self; /* Silence unused parameter under -Wall -Wextra -Werror */
+
+    /* Step 1: parse args to a c points matrix */
+    if (!PyArg_ParseTuple(args, "Onk", &points_obj, &features, &seed) || features <= 0) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    if (extract_rowsdim_and_colsdim(points_obj, &n, &dim) == -1) return NULL;
+    if (py_points_to_c_points(points_obj, n, dim, &points) == -1) return NULL;
+
+    /* Step 2: call C function and build the feature map */
+    if (rff_factor(dim, n, points, features, seed, &factor) == -1) {free(points); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    free(points);
+
+    /* Step 3: build python factor matrice (list of lists) and return it */
+    if (build_py_object_mat(n, features, factor, &py_mat) == -1) {free(factor); return NULL;}
+    free(factor);
+    return py_mat;
+}
+
+/**
+ * @brief Python wrapper: mean entry of the low-rank normalized matrix W (replaces np.mean(W) for H0 scaling).
+ * @param self CPython self/module (unused).
+ * @param args Python tuple: one object `Z` (n×r factor).
+ * @return New PyFloat on success; NULL on error (sets exception).
+ */
+static PyObject* py_lowrank_mean(PyObject *self, PyObject *args) {
+    PyObject *factor_obj;
+    Py_ssize_t n, r;
+    double *factor = NULL;
+    double mean;
+
+    (void)self; /* Silence unused parameter under -Wall -Wextra -Werror */
+
+    if (py_parse_points(args, &factor_obj) == -1) {return NULL;}
+    if (extract_rowsdim_and_colsdim(factor_obj, &n, &r) == -1) return NULL;
+    if (py_points_to_c_points(factor_obj, n, r, &factor) == -1) return NULL;
+    if (lowrank_norm_mean(n, r, factor, &mean) == -1) {free(factor); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    free(factor);
+    return PyFloat_FromDouble(mean);
+}
+
+/**
+ * @brief Python wrapper: decomposition H from a low-rank factor Z and initial H0 (W never formed).
+ * @param self CPython self/module (unused).
+ * @param args Python tuple: (factor_obj=n×r, decomp_obj=n×k).
+ * @return New PyObject* (n×k list of lists) on success; NULL on error (sets exception).
+ */
+static PyObject* py_lowrank_decomp(PyObject *self, PyObject *args) {
+    PyObject *factor_obj, *decomp_obj, *py_mat;
+    Py_ssize_t n, n_factor, r, k;
+    double *factor = NULL;
+    double *decomp_mat_0 = NULL;
+    double *updated_decomp_mat = NULL;
+
+    (void)self; /* Silence unused parameter under -Wall -Wextra -Werror */
+
+    /* Step 1: extract factor and H0 (same number of rows) */
+    if (!PyArg_ParseTuple(args, "OO", &factor_obj, &decomp_obj)) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    if (extract_rowsdim_and_colsdim(factor_obj, &n_factor, &r) == -1) return NULL;
+    if (extract_rowsdim_and_colsdim(decomp_obj, &n, &k) == -1) return NULL;
+    if (n_factor != n) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    if (py_points_to_c_points(factor_obj, n, r, &factor) == -1) return NULL;
+    if (py_points_to_c_points(decomp_obj, n, k, &decomp_mat_0) == -1) {free(factor); return NULL;}
+
+    /* Step 2: call C function and calculate updated_decomp matrix from the factor */
+    if (decomp_mat_lowrank(n, r, k, factor, decomp_mat_0, &updated_decomp_mat) == -1) {free(factor); free(decomp_mat_0); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    free(factor); free(decomp_mat_0);
+
     /* Step 3: build python updated_decomp matrice (list of lists) and return it */
     if (build_py_object_mat(n, k, updated_decomp_mat, &py_mat) == -1) {free(updated_decomp_mat); return NULL;}
     free(updated_decomp_mat);
     return py_mat;
 }
 
+/**
+ * @brief Python wrapper: relative Frobenius error of the low-rank W against the dense norm() (small inputs only).
+ * @param self CPython self/module (unused).
+ * @param args Python tuple: (points=n×dim, factor_obj=n×r built from the same points).
+ * @return New PyFloat on success; NULL on error (sets exception).
+ */
+static PyObject* py_lowrank_error(PyObject *self, PyObject *args) {
+    PyObject *points_obj, *factor_obj;
+    Py_ssize_t n, dim, n_factor, r;
+    double *points = NULL;
+    double *factor = NULL;
+    double err;
+
+    (void)self; /* Silence unused parameter under -Wall -Wextra -Werror */
+
+    if (!PyArg_ParseTuple(args, "OO", &points_obj, &factor_obj)) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    if (extract_rowsdim_and_colsdim(points_obj, &n, &dim) == -1) return NULL;
+    if (extract_rowsdim_and_colsdim(factor_obj, &n_factor, &r) == -1) return NULL;
+    if (n_factor != n) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    if (py_points_to_c_points(points_obj, n, dim, &points) == -1) return NULL;
+    if (py_points_to_c_points(factor_obj, n, r, &factor) == -1) {free(points); return NULL;}
+    if (lowrank_norm_error(dim, n, points, r, factor, &err) == -1) {free(points); free(factor); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    free(points); free(factor);
+    return PyFloat_FromDouble(err);
+}
+
+/**
+ * @brief Python wrapper: build W once and fit H for several k on it (decomp_mat_sweep).
+ * @param self CPython self/module (unused).
+ * @param args Python tuple: (points=n×dim, draws=[n×k_1, n×k_2, ...][, cache_dir=None]). Each draw holds uniforms in
+ *             [0, 1); H0 for that k is the draw times 2*sqrt(mean(W)/k), as init_decomp_mat in symnmf.py.
+ * @return New list of (H, labels, iters, objective) tuples, one per draw; NULL on error (sets exception).
+ */
+static PyObject* py_sweep(PyObject *self, PyObject *args) {
+    PyObject *points_obj, *draws_obj, *draw, *py_fits, *py_fit;
+    const char *cache_dir = NULL;
+    WCache cache;
+    Py_ssize_t n, dim, rows, cols, count, b;
+    size_t *ks, total = 0, i;
+    double *points = NULL, *sym_mat = NULL, *ddg_mat = NULL, *norm_mat = NULL, *H0s = NULL, *block = NULL;
+    unsigned char *mask = NULL;
+    const double *W;
+    double mean = 0.0, scale;
+    SweepFit *fits;
+    int status;
+
+    (void)self; /* silence unused parameter under -Wall -Wextra -Werror */
+
+    /* Step 1: parse points and the k of each draw */
+    if (!PyArg_ParseTuple(args, "OO|z", &points_obj, &draws_obj, &cache_dir)) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    if (extract_rowsdim_and_colsdim(points_obj, &n, &dim) == -1) {return NULL;}
+    if (!PySequence_Check(draws_obj) || (count = PySequence_Size(draws_obj)) <= 0) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    ks = mat_alloc((size_t)count, 1, sizeof *ks, 0);
+    fits = mat_alloc((size_t)count, 1, sizeof *fits, 1);
+    if (!ks || !fits) {free(ks); free(fits); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    for (b = 0; b < count; b++) {
+        draw = PySequence_GetItem(draws_obj, b);
+        status = draw ? extract_rowsdim_and_colsdim(draw, &rows, &cols) : -1;
+        Py_XDECREF(draw);
+        if (status == -1 || rows != n) {free(ks); free(fits); PyErr_Clear(); PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+        ks[b] = (size_t)cols;
+        total += ks[b];
+    }
+    if (extract_rowsdim_and_colsdim(points_obj, &n, &dim) == -1 || py_points_to_c_points(points_obj, n, dim, &points) == -1) {free(ks); free(fits); return NULL;}
+
+    /* Step 2: W once (mapped from the cache, or sym -> ddg -> norm) and its mean entry */
+    if (cache_dir) {
+        if (wcache_open(cache_dir, dim, n, points, &cache) == -1) {free(points); free(ks); free(fits); PyErr_SetString(PyExc_OSError, "An Error Has Occurred"); return NULL;}
+        W = cache.W;
+    }
+    else {
+        if (sym_pruned(dim, n, points, 0.0, &sym_mat, &mask) == -1 || ddg_tiled(n, sym_mat, mask, &ddg_mat) == -1 || norm_tiled(n, sym_mat, ddg_mat, mask, &norm_mat) == -1) {
+            free(points); free(sym_mat); free(ddg_mat); free(mask); free(ks); free(fits); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;
+        }
+        free(sym_mat); free(ddg_mat); free(mask);
+        W = norm_mat;
+    }
+    free(points);
+    for (i = 0; i < (size_t)n * (size_t)n; i++) {mean += W[i];}
+    mean /= (double)n * (double)n;
+
+    /* Step 3: H0 blocks = draws scaled as init_decomp_mat, then the sweep */
+    H0s = mat_alloc((size_t)n, total, sizeof *H0s, 0);
+    status = H0s ? 1 : -1;
+    for (b = 0, total = 0; b < count && status == 1; total += ks[b] * (size_t)n, b++) {
+        draw = PySequence_GetItem(draws_obj, b);
+        status = draw ? py_points_to_c_points(draw, n, (Py_ssize_t)ks[b], &block) : -1;
+        Py_XDECREF(draw);
+        if (status == -1) {break;}
+        scale = 2.0 * sqrt(mean / (double)ks[b]);
+        for (i = 0; i < (size_t)n * ks[b]; i++) {H0s[total + i] = scale * block[i];}
+        free(block);
+    }
+    if (status == 1 && decomp_mat_sweep((size_t)n, W, (size_t)count, ks, H0s, fits) == -1) {status = -1; PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");}
+    if (cache_dir) {wcache_close(&cache);}
+    free(norm_mat); free(H0s); free(ks);
+    if (status == -1) {
+        free(fits);
+        if (!PyErr_Occurred()) {PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");}
+        return NULL;
+    }
+
+    /* Step 4: build the list of (H, labels, iters, objective) */
+    py_fits = PyList_New(count);
+    for (b = 0; b < count; b++) {
+        py_fit = py_fits ? build_py_sweep_fit(n, &fits[b]) : NULL;
+        if (py_fit) {PyList_SET_ITEM(py_fits, b, py_fit);}
+        else {Py_XDECREF(py_fits); py_fits = NULL;}
+        free(fits[b].H); free(fits[b].labels);
+    }
+    free(fits);
+    if (!py_fits && !PyErr_Occurred()) {PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");}
+    return py_fits;
+}
+
+/**
+ * @brief Build the Python (H, labels, iters, objective) tuple of one sweep result.
+ * @param n Number of rows of H.
+ * @param fit Sweep result.
+ * @return New tuple, or NULL on error (sets Python exception).
+ */
+static PyObject* build_py_sweep_fit(Py_ssize_t n, const SweepFit *fit) {
+    PyObject *py_H, *py_labels, *num;
+    Py_ssize_t i;
+
+    if (build_py_object_mat(n, (Py_ssize_t)fit->k, fit->H, &py_H) == -1) {return NULL;}
+    py_labels = PyList_New(n);
+    if (!py_labels) {Py_DECREF(py_H); return NULL;}
+    for (i = 0; i < n; i++) {
+        num = PyLong_FromSize_t(fit->labels[i]);
+        if (!num) {Py_DECREF(py_H); Py_DECREF(py_labels); return NULL;}
+        PyList_SET_ITEM(py_labels, i, num);
+    }
+    return Py_BuildValue("(NNid)", py_H, py_labels, fit->stats.iters, fit->stats.objective);
+}
+
+/**
+ * @brief Python wrapper: order points along a Morton curve (morton_order).
+ * @param self CPython self/module (unused).
+ * @param args Python tuple: one object `points` (sequence of n rows, each length dim).
+ * @return New PyObject* list of n point indices in curve order; NULL on error (sets exception).
+ */
+static PyObject* py_morton(PyObject *self, PyObject *args) {
+    PyObject *points_obj, *py_perm, *num;
+    Py_ssize_t n, dim, i;
+    double *points = NULL;
+    size_t *perm;
+
+    (void)self; /* silence unused parameter under -Wall -Wextra -Werror */
+
+    /* Step 1: parse args to a c points matrix */
+    if (py_parse_points(args, &points_obj) == -1) {return NULL;}
+    if (extract_rowsdim_and_colsdim(points_obj, &n, &dim) == -1) {return NULL;}
+    if (py_points_to_c_points(points_obj, n, dim, &points) == -1) {return NULL;}
+
+    /* Step 2: compute the order */
+    perm = mat_alloc((size_t)n, 1, sizeof *perm, 0);
+    if (!perm || morton_order(dim, n, points, perm) == -1) {free(points); free(perm); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    free(points);
+
+    /* Step 3: build python list of indices */
+    py_perm = PyList_New(n);
+    if (!py_perm) {free(perm); return NULL;}
+    for (i = 0; i < n; i++) {
+        num = PyLong_FromSize_t(perm[i]);
+        if (!num) {free(perm); Py_DECREF(py_perm); return NULL;}
+        PyList_SET_ITEM(py_perm, i, num);
+    }
+    free(perm);
+    return py_perm;
+}
+
+/**
+ * @brief Python wrapper: fit many small datasets in one call (symnmf_batch).
+ * @param self CPython self/module (unused).
+ * @param args Python tuple: (jobs[, threads=0]); jobs is a sequence of (points=n×dim, k with 1 < k < n, seed) and
+ *             threads the pool size (0: one per online core).
+ * @return New PyObject* list of (H, labels, iters, objective), one per job in order; NULL on error (sets exception).
+ */
+static PyObject* py_batch(PyObject *self, PyObject *args) {
+    PyObject *jobs_obj, *job_obj, *job_tuple, *points_obj, *py_fits = NULL, *py_fit;
+    Py_ssize_t count, b, n, dim, k;
+    unsigned long seed;
+    double *points;
+    BatchJob *jobs;
+    int threads = 0, status = 1;
+
+    (void)self; /* silence unused parameter under -Wall -Wextra -Werror */
+
+    /* Step 1: copy the points, k and seed of every job */
+    if (!PyArg_ParseTuple(args, "O|i", &jobs_obj, &threads) || threads < 0) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    if (!PySequence_Check(jobs_obj) || (count = PySequence_Size(jobs_obj)) <= 0) {PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;}
+    jobs = mat_alloc((size_t)count, 1, sizeof *jobs, 1);
+    if (!jobs) {PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return NULL;}
+    for (b = 0; b < count && status == 1; b++) {
+        job_obj = PySequence_GetItem(jobs_obj, b);
+        job_tuple = job_obj ? PySequence_Tuple(job_obj) : NULL;
+        Py_XDECREF(job_obj);
+        status = (job_tuple && PyArg_ParseTuple(job_tuple, "Onk", &points_obj, &k, &seed)) ? 1 : -1;
+        if (status == 1 && extract_rowsdim_and_colsdim(points_obj, &n, &dim) == -1) {status = -1;}
+        if (status == 1 && !(1 < k && k < n)) {status = -1;}
+        if (status == 1 && py_points_to_c_points(points_obj, n, dim, &points) == -1) {status = -1;}
+        Py_XDECREF(job_tuple);
+        if (status == 1) {jobs[b].points = points; jobs[b].n = (size_t)n; jobs[b].dim = (size_t)dim; jobs[b].fit.k = (size_t)k; jobs[b].seed = seed;}
+    }
+    if (status == -1) {
+        for (b = 0; b < count; b++) {free((double *)jobs[b].points);}
+        free(jobs);
+        PyErr_Clear(); PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL;
+    }
+
+    /* Step 2: run all jobs with the GIL released */
+    Py_BEGIN_ALLOW_THREADS
+    status = symnmf_batch((size_t)count, jobs, threads);
+    Py_END_ALLOW_THREADS
+    if (status == -1) {PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");}
+
+    /* Step 3: build the list of (H, labels, iters, objective) */
+    if (status == 1) {py_fits = PyList_New(count);}
+    for (b = 0; b < count; b++) {
+        py_fit = py_fits ? build_py_sweep_fit((Py_ssize_t)jobs[b].n, &jobs[b].fit) : NULL;
+        if (py_fit) {PyList_SET_ITEM(py_fits, b, py_fit);}
+        else {Py_XDECREF(py_fits); py_fits = NULL;}
+        free(jobs[b].fit.H); free(jobs[b].fit.labels); free((double *)jobs[b].points);
+    }
+    free(jobs);
+    if (!py_fits && !PyErr_Occurred()) {PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");}
+    return py_fits;
+}
+
 /**
  * @brief Method table for symnmf_c_api.
- * @details Maps Python names (py_sym, py_ddg, py_norm, py_decomp) 
+ * @details Maps Python names (py_sym, py_ddg, py_norm, py_decomp, py_norm_to_file, py_decomp_minibatch, py_nystrom, py_rff,
+ *          py_lowrank_mean, py_lowrank_decomp, py_lowrank_error, py_sweep, py_batch, py_morton, py_model, py_project)
  *          to their C wrapper functions.
  */
 static PyMethodDef matMethods[] = {
     {"py_sym", (PyCFunction) py_sym, METH_VARARGS, PyDoc_STR("sym(points) -> list[list[float]]\nCompute similarity matrix from points.")},
-    {"py_ddg", (PyCFunction) py_ddg, METH_VARARGS, PyDoc_STR("ddg(points) -> list[list[float]]\nCompute degree diagonal matrix from points.")},
-    {"py_norm", (PyCFunction) py_norm, METH_VARARGS, PyDoc_STR("norm(points) -> list[list[float]]\nCompute normalized graph Laplacian from points.")},
-    {"py_decomp", (PyCFunction) py_decomp, METH_VARARGS, PyDoc_STR("decomp(norm, H0) -> list[list[float]]\nUpdate decomposition matrix H from N and H0.")},
+    {"py_ddg", (PyCFunction) py_ddg, METH_VARARGS, PyDoc_STR("ddg(points, cache_dir=None) -> list[list[float]]\nCompute degree diagonal matrix from points (via the on-disk W cache in cache_dir if given).")},
+    {"py_norm", (PyCFunction) py_norm, METH_VARARGS, PyDoc_STR("norm(points, cache_dir=None, tol=0.0, with_mask=0) -> list[list[float]] | (W, mask)\nCompute normalized graph Laplacian from points (via the on-disk W cache in cache_dir if given; affinities below tol dropped; with_mask also returns the computed-tile mask, None for a cached W).")},
+    {"py_decomp", (PyCFunction) py_decomp, METH_VARARGS, PyDoc_STR("decomp(norm, H0, solver='mu', with_stats=0, threads=0, mask=None) -> list[list[float]] | (H, iters, objective)\nUpdate decomposition matrix H from N and H0 with the named engine ('mu', 'mu-lazy', 'mu-sparse', 'mu-par', 'ml' or 'cd'); mask (from norm) limits 'mu-sparse' to the computed tiles.")},
+    {"py_norm_to_file", (PyCFunction) py_norm_to_file, METH_VARARGS, PyDoc_STR("norm_to_file(points, path) -> float\nWrite W row by row to a binary file; return the mean entry of W.")},
+    {"py_decomp_minibatch", (PyCFunction) py_decomp_minibatch, METH_VARARGS, PyDoc_STR("decomp_minibatch(norm | path, H0, block, epochs, seed) -> list[list[float]]\nMini-batch update of H over random row blocks of W.")},
+    {"py_nystrom", (PyCFunction) py_nystrom, METH_VARARGS, PyDoc_STR("nystrom(points, m, seed) -> list[list[float]]\nNystrom factor Z of the affinity kernel from m landmarks.")},
+    {"py_rff", (PyCFunction) py_rff, METH_VARARGS, PyDoc_STR("rff(points, features, seed) -> list[list[float]]\nRandom Fourier feature factor Z of the Gaussian affinity.")},
+    {"py_lowrank_mean", (PyCFunction) py_lowrank_mean, METH_VARARGS, PyDoc_STR("lowrank_mean(Z) -> float\nMean entry of the normalized matrix W built from Z.")},
+    {"py_lowrank_decomp", (PyCFunction) py_lowrank_decomp, METH_VARARGS, PyDoc_STR("lowrank_decomp(Z, H0) -> list[list[float]]\nUpdate decomposition matrix H from a low-rank factor Z and H0.")},
+    {"py_lowrank_error", (PyCFunction) py_lowrank_error, METH_VARARGS, PyDoc_STR("lowrank_error(points, Z) -> float\nRelative Frobenius error of W from Z against the dense norm.")},
+    {"py_sweep", (PyCFunction) py_sweep, METH_VARARGS, PyDoc_STR("sweep(points, draws, cache_dir=None) -> list[(H, labels, iters, objective)]\nBuild W once and fit H for the k of every draw (uniforms in [0, 1), scaled as H0).")},
+    {"py_batch", (PyCFunction) py_batch, METH_VARARGS, PyDoc_STR("batch(jobs, threads=0) -> list[(H, labels, iters, objective)]\nFit SymNMF on many small (points, k, seed) jobs on a work-stealing thread pool.")},
+    {"py_morton", (PyCFunction) py_morton, METH_VARARGS, PyDoc_STR("morton(points) -> list[int]\nPoint indices in Morton (Z-order) curve order.")},
+    {"py_model", (PyCFunction) py_model, METH_VARARGS, PyDoc_STR("model(points, H) -> model\nKeep training points, degrees and H for labeling new points.")},
+    {"py_project", (PyCFunction) py_project, METH_VARARGS, PyDoc_STR("project(model, point, neighbors=0) -> (int, list[float])\nLabel a new point and return its H row.")},
 
     {NULL, NULL, 0, NULL} /* end of array */
 };
 
 /**
  * @brief Module definition for symnmf_c_api.
- * @details Exposes Python wrappers: py_sym, py_ddg, py_norm, py_decomp.
+ * @details Exposes Python wrappers: py_sym, py_ddg, py_norm, py_decomp, py_norm_to_file, py_decomp_minibatch, py_nystrom, py_rff,
+ *          py_lowrank_mean, py_lowrank_decomp, py_lowrank_error, py_sweep, py_batch, py_morton, py_model, py_project.
  */
 static struct PyModuleDef symnmfmodule = {
     PyModuleDef_HEAD_INIT,
@@ -185,6 +772,7 @@ static struct PyModuleDef symnmfmodule = {
  */
 PyMODINIT_FUNC PyInit_symnmf_c_api(void) {
     PyObject *m;
+    isa_select(); /* kernel set for this CPU, once per process */
     m = PyModule_Create(&symnmfmodule);
     if (!m) {
         return NULL;
@@ -212,7 +800,7 @@ static int py_parse_points(PyObject *args, PyObject** out_points_obj) {
  * @param cols_dim Out: number of columns.
  * @return 1 on success, -1 on error (sets Python exception).
  */
-static int extract_rowsdim_and_colsdim(PyObject *mat_obj, int *rows_dim, int *cols_dim) {
+static int extract_rowsdim_and_colsdim(PyObject *mat_obj, Py_ssize_t *rows_dim, Py_ssize_t *cols_dim) {
     PyObject *row0;
 
     *rows_dim = PyObject_Length(mat_obj);
@@ -235,15 +823,15 @@ static int extract_rowsdim_and_colsdim(PyObject *mat_obj, int *rows_dim, int *co
  * @param out_mat Out: receives malloc'ed double (*)[dim_or_k]; caller must free().
  * @return 1 on success, -1 on error (sets a Python exception).
  */
-static int py_points_to_c_points(PyObject* mat_obj, int n, int dim_or_k, double **out_mat) {
+static int py_points_to_c_points(PyObject* mat_obj, Py_ssize_t n, Py_ssize_t dim_or_k, double **out_mat) {
     double *mat;
-    int i, j;
+    Py_ssize_t i, j;
     PyObject *row, *py_val;
     double c_val;
 
     if (!PySequence_Check(mat_obj) || PySequence_Size(mat_obj) != n) { PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return -1;}
     
-    mat = malloc(n * dim_or_k * sizeof *mat); /* Allocate C matrix */
+    mat = mat_alloc((size_t)n, (size_t)dim_or_k, sizeof *mat, 0); /* Allocate C matrix (NULL if the size overflows) */
     if (!mat) { PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return -1; }
 
     for (i = 0; i < n; i++) { /* Create C points from PyObject points */
@@ -275,9 +863,9 @@ static int py_points_to_c_points(PyObject* mat_obj, int n, int dim_or_k, double
  * @param py_mat_out Out: receives new PyObject* (list of lists); caller DECREFs.
  * @return 1 on success, -1 on error (sets Python exception).
  */
-static int build_py_object_mat(int n, int k, double *mat, PyObject **py_mat_out) {
+static int build_py_object_mat(Py_ssize_t n, Py_ssize_t k, const double *mat, PyObject **py_mat_out) {
     PyObject *py_mat, *row, *num;
-    int i, j;
+    Py_ssize_t i, j;
 
     py_mat = PyList_New(n);
     if (!py_mat) {PyErr_Clear(); PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); return -1;}
@@ -1,10 +1,24 @@
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
+#include <float.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "kmeans.h"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KMEANS_X86  // AVX2 / AVX-512 variants of find_min_idx, each compiled for its level by a target attribute
+#include <immintrin.h>
+#endif
 
+#ifndef KMEANS_LIBRARY
 /**
  * @brief Linked-list node for an n-D point.
  */
@@ -12,30 +26,259 @@ typedef struct Node {
     double *point;  /**< Coordinates of length dim (malloc'ed). */
     struct Node *next;  /**< Next node or NULL. */
 } Node;
+#endif
+
+/**
+ * @brief Named assignment engine (entry of ENGINES).
+ */
+typedef struct EngineEntry {
+    const char *name;  /**< Name used by kmeans_engine / the --engine option. */
+    KmeansEngine run;  /**< Engine. */
+} EngineEntry;
+
+/**
+ * @brief find_min_idx kernel (centroids as a flat k×dim array); min_idx_kernel picks one per run.
+ */
+typedef size_t (*MinIdxKernel)(const double *point, size_t k, size_t dim, const double *centroids);
+
+/**
+ * @brief The hot kernels built for one instruction-set level (entry of ISA_KERNELS, chosen by kmeans_isa_select).
+ */
+typedef struct IsaKernels {
+    const char *name;  /**< "avx512", "avx2" or "generic" (the values of KMEANS_ISA). */
+    size_t lanes;  /**< Centroids per vector (1: scalar only). */
+    MinIdxKernel find_min_idx;  /**< NULL: scalar loops. */
+} IsaKernels;
+
+/**
+ * @brief kd-tree node: the points perm[begin..end) of its cell; children are node indices (0 = leaf, the root is 0).
+ */
+typedef struct KdNode {
+    size_t begin, end;  /**< Range in KdTree.perm. */
+    size_t left, right;  /**< Children, or 0 for a leaf. */
+} KdNode;
+
+/**
+ * @brief kd-tree over the points for kmeans_kdtree, with tight per-node bounding boxes.
+ */
+typedef struct KdTree {
+    size_t dim;  /**< Dimension. */
+    size_t nodes;  /**< Nodes in use. */
+    size_t depth;  /**< Depth of the deepest leaf (root = 0). */
+    KdNode *node;  /**< Nodes; node 0 is the root. */
+    double *lo, *hi;  /**< nodes×dim bounding box of each cell. */
+    size_t *perm;  /**< Point indices, grouped by cell. */
+} KdTree;
 
-int stdin_validate_and_to_point_list(int *dim_out, int *n_out, Node *point_lst_head);
-static int read_and_check_row(int *dim, double **out_point);
-int linked_list_to_2d_array(Node *head, int n, int dim, double (**out_arr)[dim]);
-void free_list(Node *head);
+/**
+ * @brief One thread's share of parallel_chunks: run `run(ctx, c)` for the chunks c in [lo, hi).
+ */
+typedef struct ChunkShare {
+    void (*run)(void *ctx, size_t chunk);  /**< Work of one chunk. */
+    void *ctx;  /**< Context shared by all chunks. */
+    size_t lo, hi;  /**< Chunks of this share. */
+} ChunkShare;
+
+/**
+ * @brief Shared state of a threaded Lloyd iteration (see lloyd_chunk).
+ */
+typedef struct LloydCtx {
+    size_t n, k, dim;  /**< Sizes. */
+    const double *points;  /**< n×dim points. */
+    const double *centroids;  /**< k×dim centroids of this iteration (read only while chunks run). */
+    size_t *labels;  /**< n labels; each chunk writes only its own points. */
+    double *partial;  /**< nchunks blocks of `stride` doubles: k×dim sums, k counts, moved flag. */
+    size_t stride;  /**< Doubles per partial block (padded to a cache line). */
+    size_t chunk;  /**< Points per chunk. */
+    MinIdxKernel kernel;  /**< find_min_idx kernel of the run. */
+} LloydCtx;
+
+/**
+ * @brief Shared state of the k-means|| passes (see kpar_update_chunk / kpar_sample_chunk).
+ */
+typedef struct KparCtx {
+    size_t n, dim;  /**< Sizes. */
+    const double *points;  /**< n×dim points. */
+    const size_t *cand;  /**< Point index of each candidate centre. */
+    size_t new_lo, new_hi;  /**< Candidates added since the last update pass. */
+    double *d2;  /**< n squared distances to the nearest candidate. */
+    size_t *closest;  /**< n indices (into cand) of the nearest candidate. */
+    double *phi_part;  /**< Per-chunk sum of d2 (merged by tree_sum). */
+    unsigned char *sampled;  /**< n flags set by the sampling pass. */
+    uint64_t seed;  /**< --seed. */
+    uint64_t round;  /**< Sampling round (RNG stream). */
+    double oversample, phi;  /**< Expected picks per round, and the current cost. */
+    size_t chunk;  /**< Points per chunk. */
+} KparCtx;
+
+/**
+ * @brief Shared state of a silhouette pass (see sil_chunk): chunk c scores rows[c·SIL_TILE_ROWS ..] against all points.
+ */
+typedef struct SilCtx {
+    size_t n, k, dim;  /**< Sizes. */
+    const double *points;  /**< n×dim points. */
+    const size_t *labels;  /**< n labels in [0, k). */
+    const size_t *counts;  /**< k cluster sizes. */
+    const size_t *rows;  /**< m points to score (all of them, or the sample). */
+    size_t m, nchunks;  /**< Rows to score, and chunks of SIL_TILE_ROWS of them. */
+    double *part;  /**< nchunks sums of s(i), then nchunks sums of s(i)² (merged by tree_sum). */
+    unsigned char *failed;  /**< Per chunk: 1 if its accumulator could not be allocated. */
+} SilCtx;
+
+static const double BOUND_SLACK = 1e-10;  // relative slack on every stored distance bound, covers rounding so skips stay exact
+static const size_t ELKAN_MIN_K = 20;  // "auto" uses Elkan (n*k lower bounds) from this k and ELKAN_MIN_DIM on, Hamerly otherwise
+static const size_t ELKAN_MIN_DIM = 20;  // below this, Elkan's n*k bound updates cost more than the distances they save
+static const size_t CHUNK_POINTS = 8192;  // points per chunk of the threaded passes (grown so there are at most MAX_CHUNKS)
+static const size_t MAX_CHUNKS = 256;  // bounds the partial-sum memory to MAX_CHUNKS × (k×dim + k) doubles
+#ifndef KMEANS_LIBRARY
+static const int MAX_THREADS = 1024;  // upper bound of --threads
+#endif
+static const int KPAR_ROUNDS = 5;  // k-means|| sampling rounds (O(log phi) in theory; 5 suffices in practice)
+static const double KPAR_OVERSAMPLE = 2.0;  // k-means|| expected picks per round, times k
+static const int RECLUSTER_ITERS = 100;  // max weighted Lloyd iterations when reducing the k-means|| candidates to k
+static const size_t GEMM_TILE_POINTS = 8;  // points per tile of the gemm kernel
+static const size_t GEMM_TILE_CENTROIDS = 64;  // centroids per tile (k is padded to a multiple, so the inner loop has a fixed length)
+static const double GEMM_TIE_SLACK = 4.0;  // safety factor on the rounding bound under which a gemm argmin is recomputed exactly
+static const size_t KD_LEAF_POINTS = 16;  // a kd-tree cell with at most this many points is a leaf
+static const size_t SIL_TILE_ROWS = 64;  // silhouette: rows per chunk, each with its own k per-cluster distance sums
+static const size_t SIL_TILE_COLS = 512;  // silhouette: points per column tile, reused from cache by all rows of a chunk
+static const double SIL_Z = 1.959963984540054;  // normal quantile of the 95% confidence bound of the sampled silhouette
+
+static int read_and_check_row(size_t *dim, double **out_point);
+#ifndef KMEANS_LIBRARY  // the CLI: not built into the kmeans_c_api extension
+static int stdin_validate_and_to_point_list(size_t *dim_out, size_t *n_out, Node *point_lst_head);
+static int linked_list_to_2d_array(Node *head, size_t n, size_t dim, double (**out_arr)[dim]);
+static void free_list(Node *head);
 static void free_tail_and_point(Node *head);
-int argv_check(int argc, char **argv, int *k_and_iterations, int n);
-int kmeans(int n, int k, int iterations, int dim, const double (*points)[dim], double (**centroids_out)[dim]);
-static int find_min_idx(const double *point, int k, int dim, double (*centroids)[dim]);
-static void print_centroids(int k, int dim, double centroids[k][dim]);
+static int parse_options(int *argc, char **argv, KmeansOptions *opts);
+static int argv_check(int argc, char **argv, size_t *k_out, int *iterations_out, size_t n);
+static void print_centroids(size_t k, size_t dim, double centroids[k][dim]);
+#endif
+static int stream_lloyd_pass(off_t start, size_t n, size_t k, size_t dim, double *centroids, int *changed);
+static int kmeans_lloyd(size_t n, size_t k, int iterations, size_t dim, const double (*points)[dim], double (*centroids)[dim]);
+static int kmeans_hamerly(size_t n, size_t k, int iterations, size_t dim, const double (*points)[dim], double (*centroids)[dim]);
+static int kmeans_elkan(size_t n, size_t k, int iterations, size_t dim, const double (*points)[dim], double (*centroids)[dim]);
+static int kmeans_gemm(size_t n, size_t k, int iterations, size_t dim, const double (*points)[dim], double (*centroids)[dim]);
+static int kmeans_kdtree(size_t n, size_t k, int iterations, size_t dim, const double (*points)[dim], double (*centroids)[dim]);
+static int kd_build(size_t n, size_t dim, const double (*points)[dim], KdTree *tree);
+static size_t kd_build_node(KdTree *tree, size_t dim, const double (*points)[dim], size_t begin, size_t end, size_t depth);
+static void kd_select(size_t *perm, size_t dim, const double (*points)[dim], size_t axis, size_t begin, size_t end, size_t nth);
+static void kd_filter(const KdTree *tree, size_t id, size_t *cand, size_t ncand, size_t k, size_t dim, const double (*points)[dim], double (*centroids)[dim], size_t *labels, int *moved);
+static void kd_free(KdTree *tree);
+static int gemm_assign(size_t n, size_t k, size_t dim, const double (*points)[dim], const double *point_norms, double (*centroids)[dim], MinIdxKernel kernel, size_t *labels);
+static int kmeans_lloyd_threads(size_t n, size_t k, int iterations, size_t dim, const double (*points)[dim], double (*centroids)[dim], int threads);
+static void lloyd_chunk(void *ctx, size_t c);
+static int seed_centroids(size_t n, size_t k, size_t dim, const double (*points)[dim], const KmeansOptions *opts, double (*centroids)[dim]);
+static int kmeanspp_pick(size_t m, size_t k, size_t dim, const double (*pts)[dim], const double *weights, uint64_t seed, double (*centroids)[dim]);
+static int kmeans_par_seed(size_t n, size_t k, size_t dim, const double (*points)[dim], uint64_t seed, int threads, double (*centroids)[dim]);
+static void kpar_update_chunk(void *ctx, size_t c);
+static void kpar_sample_chunk(void *ctx, size_t c);
+static int weighted_lloyd(size_t m, size_t k, size_t dim, const double (*pts)[dim], const double *weights, double (*centroids)[dim]);
+static void sil_chunk(void *ctx, size_t c);
+static void parallel_chunks(int threads, size_t nchunks, void (*run)(void *ctx, size_t chunk), void *ctx);
+static void *chunk_share(void *arg);
+static size_t chunk_points(size_t n);
+static double tree_sum(double *v, size_t m);
+static double rng_unit(uint64_t seed, uint64_t stream, uint64_t i);
+static void update_centroids(size_t n, size_t k, size_t dim, const double (*points)[dim], const size_t *labels, size_t *counts, double (*sums)[dim], double (*centroids)[dim], double *drift);
+static size_t nearest_two(const double *point, size_t k, size_t dim, double (*centroids)[dim], double *best_out, double *second_out);
+static double sq_dist(const double *a, const double *b, size_t dim);
+static size_t find_min_idx(MinIdxKernel kernel, const double *point, size_t k, size_t dim, double (*centroids)[dim]);
+static MinIdxKernel min_idx_kernel(size_t k, size_t dim);
+static size_t find_min_idx_generic(const double *point, size_t k, size_t dim, const double *centroids);
+static int isa_supported(const char *name);
+#ifdef KMEANS_X86
+static size_t find_min_idx_avx2(const double *point, size_t k, size_t dim, const double *centroids);
+static size_t find_min_idx_avx512(const double *point, size_t k, size_t dim, const double *centroids);
+#endif
+static void *mat_alloc(size_t rows, size_t cols, size_t elem_size, int zeroed);
+
+static const EngineEntry ENGINES[] = {
+    {"lloyd", kmeans_lloyd},  // full scan of every centroid for every point
+    {"hamerly", kmeans_hamerly},  // one upper + one lower bound per point
+    {"elkan", kmeans_elkan},  // one upper + k lower bounds per point, centroid-centroid distances
+    {"gemm", kmeans_gemm},  // tiles of points against all centroids: ||c||² - 2 x·c as a blocked product, fused argmin
+    {"kdtree", kmeans_kdtree}  // kd-tree filtering: whole cells go to a centroid once it is the only candidate left
+};
+
+// Fixed-dimension variants of find_min_idx: the distance is written out term by term (no loop, fixed-stride loads),
+// adding the squares in the same order as sq_dist, so labels are bit-for-bit those of the generic loop.
+#define SQ_TERM(j) t = a[j] - b[j]; dist += t * t;
+#define SQ_TERMS_2 SQ_TERM(0) SQ_TERM(1)
+#define SQ_TERMS_3 SQ_TERMS_2 SQ_TERM(2)
+#define SQ_TERMS_4 SQ_TERMS_3 SQ_TERM(3)
+#define SQ_TERMS_5 SQ_TERMS_4 SQ_TERM(4)
+#define SQ_TERMS_8 SQ_TERMS_5 SQ_TERM(5) SQ_TERM(6) SQ_TERM(7)
+#define FIXED_DIM_MIN_IDX(D) \
+    static size_t find_min_idx_##D(const double *point, size_t k, size_t dim, const double *centroids) { \
+        const double *a = point, *b = centroids; \
+        (void)dim; \
+        double t, dist = 0.0; \
+        SQ_TERMS_##D \
+        double best = dist; \
+        size_t min_idx = 0; \
+        for (size_t c = 1; c < k; ++c) { \
+            b = centroids + c * D; \
+            dist = 0.0; \
+            SQ_TERMS_##D \
+            if (dist < best) {best = dist; min_idx = c;} \
+        } \
+        return min_idx; \
+    }
 
+FIXED_DIM_MIN_IDX(2)
+FIXED_DIM_MIN_IDX(3)
+FIXED_DIM_MIN_IDX(4)
+FIXED_DIM_MIN_IDX(5)
+FIXED_DIM_MIN_IDX(8)
+
+static const MinIdxKernel MIN_IDX_KERNELS[] = {  // indexed by dim; NULL: the ISA kernel or find_min_idx_generic
+    NULL, NULL, find_min_idx_2, find_min_idx_3, find_min_idx_4, find_min_idx_5, NULL, NULL, find_min_idx_8
+};
+
+static const IsaKernels ISA_KERNELS[] = {  // widest first: kmeans_isa_select takes the first one the CPU supports
+#ifdef KMEANS_X86
+    {"avx512", 8, find_min_idx_avx512},
+    {"avx2", 4, find_min_idx_avx2},
+#endif
+    {"generic", 1, NULL}
+};
+static const size_t ISA_KERNEL_COUNT = sizeof ISA_KERNELS / sizeof ISA_KERNELS[0];
+static const IsaKernels *isa = &ISA_KERNELS[sizeof ISA_KERNELS / sizeof ISA_KERNELS[0] - 1];  // generic until kmeans_isa_select runs
+
+#ifndef KMEANS_LIBRARY
 /**
  * @brief Program entry: read points, validate args, run k-means, print centroids.
  * @param argc Argument count.
- * @param argv Argument vector.
+ * @param argv Argument vector: k [iterations], plus optional "--engine=lloyd|hamerly|elkan|gemm|kdtree|auto", "--threads=T",
+ *             "--init=first|kmeans++|kmeans||", "--seed=S", "--minibatch=B" and "--passes=P" anywhere.
  * @return 0 on normal exit (errors print and exit(1)).
  */
 int main(int argc, char **argv) {
+    kmeans_isa_select();  // kernel set for this CPU (logged to stderr)
+
+    //Step 0: strip the --options first (the streaming mode must know before reading stdin).
+    KmeansOptions opts = {"lloyd", "first", 0, 0, 0, 0};
+    if (parse_options(&argc, argv, &opts) != 1) {printf("An Error Has Occurred\n"); exit(1);}
+    size_t k;
+    int iterations;
+    if (opts.minibatch > 0) { // k < n is only known at EOF, checked there
+        if (argv_check(argc, argv, &k, &iterations, SIZE_MAX) == -1) {exit(1);}
+        size_t dim = 0, n = 0;
+        double *centroids = NULL;
+        int status = kmeans_stream(k, &opts, &dim, &n, &centroids);
+        if (status == 0) {printf("Incorrect number of clusters!\n"); exit(1);}
+        if (status == -1) {printf("An Error Has Occurred\n"); exit(1);}
+        print_centroids(k, dim, (double (*)[dim])centroids);
+        free(centroids);
+        return 0;
+    }
 
     //Step 1: validate and create points list.
     Node *point_lst_head = malloc(sizeof(*point_lst_head));    //create list head.
     if(!point_lst_head) {exit(1);}
     *point_lst_head = (Node){0};
-    int dim = 0, n = 0;
+    size_t dim = 0, n = 0;
 
     int status = stdin_validate_and_to_point_list(&dim, &n,  point_lst_head); 
     if (status != 1 || n <= 1) { free(point_lst_head); printf("An Error Has Occurred\n"); exit(1);} // 0 empty or -1 error
@@ -46,15 +289,14 @@ int main(int argc, char **argv) {
     free_list(point_lst_head);
 
     //Step 3: check args (k and iterations).
-    int k_and_iterations[2];
-    status = argv_check(argc, argv, k_and_iterations, n);
+    status = argv_check(argc, argv, &k, &iterations, n);
     if (status == -1) {free(points); exit(1);}
 
     //step 4: run kmeans algo
     double (*centroids)[dim] = NULL;
-    status = kmeans(n, k_and_iterations[0], k_and_iterations[1], dim, (const double (*)[dim])points, &centroids);
+    status = kmeans(n, k, iterations, dim, (const double (*)[dim])points, &opts, &centroids);
     if (status == -1) {printf("An Error Has Occurred\n"); exit(1);}
-    else {print_centroids(k_and_iterations[0], dim, centroids);}
+    else {print_centroids(k, dim, centroids);}
 
     free(points);free(centroids);
     return 0;
@@ -75,13 +317,13 @@ int main(int argc, char **argv) {
  *
  * @note Caller must free the list (and points) when done.
  */
-int stdin_validate_and_to_point_list(int *dim_out, int *n_out, Node *point_lst_head) {
+static int stdin_validate_and_to_point_list(size_t *dim_out, size_t *n_out, Node *point_lst_head) {
     
     point_lst_head->next = NULL;   // ensure
     point_lst_head->point = NULL;  // ensure
     Node *curr_node = point_lst_head; 
 
-    int points_list_len = 0;
+    size_t points_list_len = 0;
 
     int status = read_and_check_row(dim_out, &point_lst_head->point); // read first row, define dim and add point to point_lst_head
     if (status == 0) {*n_out = points_list_len; return 0;} // 0 = empty (EOF at start)
@@ -104,6 +346,8 @@ int stdin_validate_and_to_point_list(int *dim_out, int *n_out, Node *point_lst_h
     }
 }
 
+#endif
+
 /**
  * @brief Read one CSV line, validate/parse to doubles, enforce dimension.
  * If *dim==0 (first row), sets *dim from parsed count.
@@ -111,7 +355,7 @@ int stdin_validate_and_to_point_list(int *dim_out, int *n_out, Node *point_lst_h
  * @param out_point Receives malloc'ed double[]; caller must free().
  * @return 1 ok, 0 EOF before any char, -1 invalid line/alloc failure.
  */
-static int read_and_check_row(int *dim, double **out_point) {
+static int read_and_check_row(size_t *dim, double **out_point) {
 
     //Step 1: read line to buffer.
     size_t point_cap = 64, len = 0;
@@ -153,7 +397,7 @@ static int read_and_check_row(int *dim, double **out_point) {
         if (!point) {free(buff); return -1;}
     }
 
-    int point_len = 0;
+    size_t point_len = 0;
     char *p = buff;
     while(1) {
         char *comma = strchr(p, ',');
@@ -169,7 +413,7 @@ static int read_and_check_row(int *dim, double **out_point) {
         if (*endptr != '\0' || errno == ERANGE) {free(buff); free(point); return -1;} // if couldnt convert
         
         //for first point - check if need to allocate more memory in buffer
-        if (*dim == 0 && point_len >= (int)max_dim) {          // simple grow (e.g., double)
+        if (*dim == 0 && point_len >= max_dim) {          // simple grow (e.g., double)
             max_dim *= 2;
             double *tmp = realloc(point, max_dim * sizeof(double));
             if(!tmp) {free(buff); free(point); return -1;}
@@ -200,6 +444,7 @@ static int read_and_check_row(int *dim, double **out_point) {
     return 1;
 } 
 
+#ifndef KMEANS_LIBRARY
 /**
  * @brief Convert a linked list of points to a contiguous [n][dim] array.
  * @param head First node (each node->point has length dim).
@@ -208,15 +453,15 @@ static int read_and_check_row(int *dim, double **out_point) {
  * @param out_arr Receives malloc'ed array; caller must free().
  * @return 1 on success, -1 on failure/invalid args.
  */
-int linked_list_to_2d_array(Node *head, int n, int dim, double (**out_arr)[dim]) {
-    if (!head || n <= 0 || dim <= 0 || !out_arr) return -1;
+static int linked_list_to_2d_array(Node *head, size_t n, size_t dim, double (**out_arr)[dim]) {
+    if (!head || n == 0 || dim == 0 || !out_arr) return -1;
 
-    double (*arr)[dim] = malloc(n * sizeof *arr);
+    double (*arr)[dim] = mat_alloc(n, dim, sizeof(double), 0);
     if (!arr) {return -1;}
 
     Node *p = head;
-    for (int i = 0; i < n; i++) {
-        for (int d = 0; d < dim; d++)
+    for (size_t i = 0; i < n; i++) {
+        for (size_t d = 0; d < dim; d++)
             arr[i][d] = p->point[d];
         p = p->next;
     }
@@ -228,7 +473,7 @@ int linked_list_to_2d_array(Node *head, int n, int dim, double (**out_arr)[dim])
  * @brief Free entire list: all nodes and their point arrays.
  * @param head Head of the list (may be NULL).
  */
-void free_list(Node *head) {
+static void free_list(Node *head) {
     while (head) {
         Node *next_node = head->next;
         free(head->point);
@@ -247,14 +492,61 @@ static void free_tail_and_point(Node *head) {
     if (head->point) { free(head->point); head->point = NULL; }
 }
 
+/**
+ * @brief Remove "--name=value" options from argv (compacting it in place) and store them in opts.
+ * @param argc In/out: argument count, reduced by the number of options removed.
+ * @param argv In/out: argument vector; the positional arguments keep their order.
+ * @param opts Out: options found (fields not given keep their value).
+ * @return 1 on success, -1 on an unknown option or value.
+ */
+static int parse_options(int *argc, char **argv, KmeansOptions *opts) {
+    int kept = 1;
+    for (int i = 1; i < *argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {argv[kept++] = argv[i]; continue;} // positional (k, iterations)
+        const char *value = strchr(argv[i], '=');
+        if (!value) {return -1;}
+        value++;
+        if (strncmp(argv[i], "--engine=", 9) == 0 && (strcmp(value, "auto") == 0 || kmeans_engine(value))) {opts->engine = value;}
+        else if (strncmp(argv[i], "--init=", 7) == 0 && (strcmp(value, "first") == 0 || strcmp(value, "kmeans++") == 0 || strcmp(value, "kmeans||") == 0)) {opts->init = value;}
+        else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            char *end;
+            errno = 0;
+            unsigned long seed = strtoul(value, &end, 10);
+            if (errno == ERANGE || end == value || *end != '\0' || !isdigit((unsigned char)*value)) {return -1;}
+            opts->seed = seed;
+        }
+        else if (strncmp(argv[i], "--minibatch=", 12) == 0 || strncmp(argv[i], "--passes=", 9) == 0) {
+            char *end;
+            errno = 0;
+            long count = strtol(value, &end, 10);
+            if (errno == ERANGE || end == value || *end != '\0') {return -1;}
+            if (argv[i][2] == 'm' && count >= 2) {opts->minibatch = (size_t)count;}
+            else if (argv[i][2] == 'p' && count >= 0 && count < 1000) {opts->passes = (int)count;}
+            else {return -1;}
+        }
+        else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            char *end;
+            errno = 0;
+            long threads = strtol(value, &end, 10);
+            if (errno == ERANGE || end == value || *end != '\0' || threads < 1 || threads > MAX_THREADS) {return -1;}
+            opts->threads = (int)threads;
+        }
+        else {return -1;}
+    }
+    argv[kept] = NULL;
+    *argc = kept;
+    return 1;
+}
+
 /**
  * @brief Validate CLI: k and optional iterations; sets outputs or exits on error.
  * @param argc Argument count.
  * @param argv Argument vector.
- * @param k_and_iterations Out: [0]=k, [1]=iterations (default 400).
+ * @param k_out Out: k.
+ * @param iterations_out Out: iterations (default 400).
  * @param n Number of points (for checking 1<k<n).
  */
-int argv_check(int argc, char **argv, int *k_and_iterations, int n) { 
+static int argv_check(int argc, char **argv, size_t *k_out, int *iterations_out, size_t n) { 
     /*
     checks if the command-line arguments are valid (as expected in Table 1)
     If invalid -> print an error and terminate
@@ -268,12 +560,12 @@ int argv_check(int argc, char **argv, int *k_and_iterations, int n) {
     char *end1;
     errno = 0;
     long k = strtol(argv[1],&end1, 10);
-    if (errno == ERANGE || k > INT_MAX || end1 == argv[1] || *end1 != '\0' || k <= 1 || k >= n) {printf("Incorrect number of clusters!\n"); return -1;}
+    if (errno == ERANGE || end1 == argv[1] || *end1 != '\0' || k <= 1 || (unsigned long)k >= n) {printf("Incorrect number of clusters!\n"); return -1;}
     
-    k_and_iterations[0] = (int)k;
+    *k_out = (size_t)k;
 
     if(argc == 2) { //iterations not provided -> default =400
-        k_and_iterations[1] = 400;
+        *iterations_out = 400;
     }
     
     else {
@@ -281,107 +573,1504 @@ int argv_check(int argc, char **argv, int *k_and_iterations, int n) {
         errno = 0;
         long iterations = strtol(argv[2],&end2, 10); 
         if (errno == ERANGE || iterations > INT_MAX || end2 == argv[2] || *end2 != '\0' || iterations <= 1 || iterations >= 1000) {printf("Incorrect number of clusters!\n"); return -1;}
-        k_and_iterations[1] = (int)iterations;
+        *iterations_out = (int)iterations;
     }
     return 1;
 }
 
+#endif
+
 /**
- * @brief Run Lloyd's k-means on points.
+ * @brief Run k-means on points: seed the centroids (first k points, k-means++ or k-means||), then run the chosen assignment engine.
+ * All engines return the same centroids (bit for bit); the bounded ones only skip distances that cannot change a label.
  * @param n Number of points.
  * @param k Number of clusters.
  * @param iterations Max iterations (>=2, <=999).
  * @param dim Dimension.
  * @param points Input n×dim points.
+ * @param opts Options (engine, init, seed, threads); NULL means serial Lloyd from the first k points.
  * @param centroids_out Receives malloc'ed k×dim centroids; caller must free().
- * @return 1 on success, -1 on allocation failure.
+ * @return 1 on success, -1 on allocation failure, unknown engine, or threads with an engine other than Lloyd.
  */
-int kmeans(int n, int k, int iterations, int dim, const double (*points)[dim], double (**centroids_out)[dim]) { // add arg that returns pointer to 2D arr malloced
-    
-    //step 1: label is the number of point and it says witch cluster it belongs to and counts is number of points in each cluster and sum is to sum later of
-    int *labels = calloc(n, sizeof(*labels));
-    int *counts = calloc(k, sizeof(*counts));
-    double (*sums)[dim] = calloc((size_t)k, sizeof *sums);
-    if (!labels || !counts || !sums) {free(labels); free(counts); free(sums); return -1;}
+int kmeans(size_t n, size_t k, int iterations, size_t dim, const double (*points)[dim], const KmeansOptions *opts, double (**centroids_out)[dim]) { // add arg that returns pointer to 2D arr malloced
+
+    //step 1: pick the engine ("auto" trades Elkan's n*k bounds for fewer distances once k and dim are large)
+    const char *name = opts && opts->engine ? opts->engine : "lloyd";
+    if (strcmp(name, "auto") == 0) {name = k >= ELKAN_MIN_K && dim >= ELKAN_MIN_DIM ? "elkan" : "hamerly";}
+    KmeansEngine run = kmeans_engine(name);
+    if (!run) {return -1;}
+    int threads = opts ? opts->threads : 0;
+    if (threads > 0 && run != kmeans_lloyd) {return -1;} // only the Lloyd step is threaded
 
-    double (*centroids)[dim] = malloc(k * sizeof *centroids);
-    if (!centroids) {free(labels); free(counts); free(sums); return -1;}
+    double (*centroids)[dim] = mat_alloc(k, dim, sizeof(double), 0);
+    if (!centroids) {return -1;}
 
     //step 2: initialize centroids
-    for (int c = 0; c < k; ++c) {
-        for (int d = 0; d < dim; ++d)
-            centroids[c][d] = points[c][d];
+    if (seed_centroids(n, k, dim, points, opts, centroids) != 1) {free(centroids); return -1;}
+
+    int status = threads > 0 ? kmeans_lloyd_threads(n, k, iterations, dim, points, centroids, threads)
+                             : run(n, k, iterations, dim, points, centroids);
+    if (status != 1) {free(centroids); return -1;}
+    *centroids_out = centroids; // hand off to caller
+    return 1;
+}
+
+/**
+ * @brief Lloyd with the stopping rule of kmeans.py's k_means_clusters, for the kmeans_c_api extension: each iteration
+ * assigns every point with find_min_idx, recomputes each mean as (1/|cluster|)·Σx in point order (an empty cluster
+ * keeps its centroid), and stops once no centroid moved more than eps (Euclidean). Same arithmetic as kmeans.py, so
+ * the labels agree with it.
+ * @param n Number of points.
+ * @param k Number of clusters.
+ * @param iterations Max iterations (>= 1).
+ * @param eps Convergence threshold on the shift of each centroid.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param centroids In: k×dim seeds; out: final centroids.
+ * @param labels Out: n labels of the last assignment step.
+ * @return 1 on success, -1 on allocation failure.
+ */
+int kmeans_fit(size_t n, size_t k, int iterations, double eps, size_t dim, const double (*points)[dim], double (*centroids)[dim], size_t *labels) {
+    size_t *counts = calloc(k, sizeof(*counts));
+    double (*sums)[dim] = mat_alloc(k, dim, sizeof(double), 1);
+    if (!counts || !sums) {free(counts); free(sums); return -1;}
+    MinIdxKernel kernel = min_idx_kernel(k, dim);
+
+    for (int it = 0; it < iterations; it++) {
+
+        //step 1: assign points and sum each cluster in point order.
+        memset(counts, 0, k * sizeof *counts);
+        memset(sums,   0, k * sizeof *sums); // zero k×dim
+        for (size_t i = 0; i < n; i++) {
+            size_t c = find_min_idx(kernel, points[i], k, dim, centroids);
+            labels[i] = c;
+            counts[c]++;
+            for (size_t j = 0; j < dim; j++) {sums[c][j] += points[i][j];}
+        }
+
+        //step 2: new means and their shift (EPS test of kmeans.py).
+        int small_shift = 1;
+        for (size_t c = 0; c < k; c++) {
+            if (counts[c] == 0) {continue;} // empty cluster keeps its centroid (shift 0)
+            double dist = 0.0;
+            for (size_t j = 0; j < dim; j++) {
+                double mean = (1.0 / counts[c]) * sums[c][j];
+                dist += (mean - centroids[c][j]) * (mean - centroids[c][j]);
+                centroids[c][j] = mean;
+            }
+            if (sqrt(dist) > eps) {small_shift = 0;}
+        }
+        if (small_shift) break;
     }
-    
+    free(counts); free(sums);
+    return 1;
+}
+
+/**
+ * @brief Mean silhouette (Euclidean, as sklearn's silhouette_score) of a labeling: s(i) = (b - a) / max(a, b), where
+ * a is the mean distance from i to the rest of its cluster and b the smallest mean distance to another cluster
+ * (s(i) = 0 in a singleton). Each scored row accumulates its distances per cluster (k sums), in tiles of SIL_TILE_ROWS
+ * rows × SIL_TILE_COLS points, so memory is O(n + T·SIL_TILE_ROWS·k) and never n×n. Chunks of rows run on `threads`
+ * threads and are merged in chunk order, so the result does not depend on the thread count.
+ * With 0 < samples < n, only `samples` rows drawn uniformly with replacement (rng_unit(seed, 0, r)) are scored, which
+ * costs samples·n distances instead of n². The mean of their s(i) is an unbiased estimate, and *halfwidth_out is the
+ * 95% normal confidence half-width SIL_Z·sd/sqrt(samples).
+ * @param n Number of points.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param labels n labels in [0, k).
+ * @param k Number of label values.
+ * @param samples 0 (or >= n): exact; otherwise the number of sampled rows.
+ * @param seed Seed of the sample.
+ * @param threads 0: serial; T >= 1: T threads.
+ * @param score_out Out: mean silhouette.
+ * @param halfwidth_out Out: confidence half-width (0 when exact).
+ * @return 1 on success, 0 if a label is >= k or fewer than 2 clusters are non-empty, -1 on allocation failure.
+ */
+int silhouette(size_t n, size_t dim, const double (*points)[dim], const size_t *labels, size_t k, size_t samples, unsigned long seed, int threads, double *score_out, double *halfwidth_out) {
+
+    //step 1: cluster sizes (at least two clusters must be non-empty).
+    size_t *counts = calloc(k, sizeof(*counts)), used = 0;
+    if (!counts) {return -1;}
+    for (size_t i = 0; i < n; i++) {
+        if (labels[i] >= k) {free(counts); return 0;}
+        counts[labels[i]]++;
+    }
+    for (size_t c = 0; c < k; c++) {used += counts[c] > 0;}
+    if (used < 2) {free(counts); return 0;}
+
+    //step 2: the rows to score: all points, or the sample.
+    int sampled = samples > 0 && samples < n;
+    size_t m = sampled ? samples : n, nchunks = (m + SIL_TILE_ROWS - 1) / SIL_TILE_ROWS;
+    size_t *rows = mat_alloc(m, 1, sizeof(size_t), 0);
+    double *part = mat_alloc(nchunks, 2, sizeof(double), 0);
+    unsigned char *failed = calloc(nchunks, 1);
+    if (!rows || !part || !failed) {free(counts); free(rows); free(part); free(failed); return -1;}
+    for (size_t r = 0; r < m; r++) {rows[r] = sampled ? (size_t)(rng_unit(seed, 0, r) * (double)n) % n : r;}
+
+    //step 3: score chunks of rows, then merge in chunk order.
+    SilCtx ctx = {n, k, dim, &points[0][0], labels, counts, rows, m, nchunks, part, failed};
+    if (threads > 0) {parallel_chunks(threads, nchunks, sil_chunk, &ctx);}
+    else {for (size_t c = 0; c < nchunks; c++) {sil_chunk(&ctx, c);}}
+    int status = 1;
+    for (size_t c = 0; c < nchunks; c++) {if (failed[c]) {status = -1;}}
+    if (status == 1) {
+        double mean = tree_sum(part, nchunks) / (double)m, var = 0.0;
+        if (sampled && m > 1) {var = (tree_sum(part + nchunks, nchunks) - (double)m * mean * mean) / (double)(m - 1);}
+        *score_out = mean;
+        *halfwidth_out = var > 0.0 ? SIL_Z * sqrt(var / (double)m) : 0.0;
+    }
+    free(counts); free(rows); free(part); free(failed);
+    return status;
+}
+
+/**
+ * @brief Silhouette chunk c: per-cluster distance sums of up to SIL_TILE_ROWS rows against all points, one column
+ * tile at a time, then s(i) of each row into part[c] (sum) and part[nchunks + c] (sum of squares).
+ * @param ctx SilCtx*.
+ * @param c Chunk index.
+ */
+static void sil_chunk(void *ctx, size_t c) {
+    SilCtx *x = ctx;
+    size_t n = x->n, k = x->k, dim = x->dim, lo = c * SIL_TILE_ROWS;
+    size_t hi = lo + SIL_TILE_ROWS < x->m ? lo + SIL_TILE_ROWS : x->m;
+    const double (*points)[dim] = (const double (*)[dim])x->points;
+    double *acc = mat_alloc(hi - lo, k, sizeof(double), 1), sum = 0.0, sum2 = 0.0;
+    if (!acc) {x->failed[c] = 1; return;}
+
+    //step 1: distance sums per (row, cluster); a tile of points is reused by every row of the chunk.
+    for (size_t j0 = 0; j0 < n; j0 += SIL_TILE_COLS) {
+        size_t j1 = j0 + SIL_TILE_COLS < n ? j0 + SIL_TILE_COLS : n;
+        for (size_t r = lo; r < hi; r++) {
+            const double *p = points[x->rows[r]];
+            double *a = acc + (r - lo) * k;
+            for (size_t j = j0; j < j1; j++) {a[x->labels[j]] += sqrt(sq_dist(p, points[j], dim));} // self adds 0
+        }
+    }
+
+    //step 2: s(i) = (b - a) / max(a, b); 0 in a singleton.
+    for (size_t r = lo; r < hi; r++) {
+        size_t i = x->rows[r], own = x->labels[i];
+        const double *a = acc + (r - lo) * k;
+        double s = 0.0;
+        if (x->counts[own] > 1) {
+            double intra = a[own] / (double)(x->counts[own] - 1), inter = HUGE_VAL;
+            for (size_t cl = 0; cl < k; cl++) {
+                if (cl == own || x->counts[cl] == 0) {continue;}
+                double mean = a[cl] / (double)x->counts[cl];
+                if (mean < inter) {inter = mean;}
+            }
+            double den = intra > inter ? intra : inter;
+            s = den > 0.0 ? (inter - intra) / den : 0.0;
+        }
+        sum += s;
+        sum2 += s * s;
+    }
+    x->part[c] = sum;
+    x->part[x->nchunks + c] = sum2;
+    free(acc);
+}
+
+/**
+ * @brief Streaming mini-batch k-means over stdin (Sculley, "Web-scale k-means clustering"): points are read in
+ * batches of opts->minibatch rows and never all held at once. The first batch seeds the centroids (opts->init);
+ * then for every batch each point is assigned to its nearest centroid, and each centroid c moves toward its points
+ * with its own learning rate 1/v(c), v(c) being the number of points it has absorbed so far. Memory is
+ * O(B·dim + k·dim), so stdin may be far larger than RAM. If opts->passes > 0 and stdin is a seekable file, up to
+ * that many exact Lloyd passes are streamed over it afterwards (stopping once the centroids stop changing).
+ * @param k Number of clusters (> 1).
+ * @param opts Options (minibatch > k, init, seed, passes); engine and threads must be left at their defaults.
+ * @param dim_out Out: point dimension.
+ * @param n_out Out: number of points read.
+ * @param centroids_out Receives malloc'ed k×dim centroids; caller must free().
+ * @return 1 on success, 0 if k >= n, -1 on invalid input, allocation failure or unsupported options.
+ */
+int kmeans_stream(size_t k, const KmeansOptions *opts, size_t *dim_out, size_t *n_out, double **centroids_out) {
+    if (opts->minibatch <= k || opts->threads > 0 || strcmp(opts->engine, "lloyd") != 0) {return -1;}
+    off_t start = ftello(stdin); // -1 on a pipe: no full passes
+
+    //step 1: the first row fixes dim; then the batch, labels, per-centroid counts and centroids.
+    size_t dim = 0, n = 0, m = 0, batch = opts->minibatch;
+    double *point = NULL;
+    int status = read_and_check_row(&dim, &point);
+    if (status != 1) {return -1;} // empty or invalid
+    double (*rows)[dim] = mat_alloc(batch, dim, sizeof(double), 0);
+    size_t *labels = mat_alloc(batch, 1, sizeof(size_t), 0);
+    double *absorbed = mat_alloc(k, 1, sizeof(double), 1);
+    double (*centroids)[dim] = mat_alloc(k, dim, sizeof(double), 0);
+    if (!rows || !labels || !absorbed || !centroids) {free(point); free(rows); free(labels); free(absorbed); free(centroids); return -1;}
+    memcpy(rows[m++], point, dim * sizeof(double));
+    free(point);
+    MinIdxKernel kernel = min_idx_kernel(k, dim);
+
+    //step 2: fill a batch, then assign all of it with the current centroids, then take the per-point steps.
+    while (status == 1) {
+        while (m < batch && (status = read_and_check_row(&dim, &point)) == 1) {
+            memcpy(rows[m++], point, dim * sizeof(double));
+            free(point);
+        }
+        if (status == -1) {free(rows); free(labels); free(absorbed); free(centroids); return -1;}
+        if (m == 0) {break;}
+        if (n == 0) { // first batch seeds the centroids
+            if (m <= k) {break;}
+            KmeansOptions seed_opts = *opts;
+            seed_opts.threads = 0;
+            if (seed_centroids(m, k, dim, (const double (*)[dim])rows, &seed_opts, centroids) != 1) {
+                free(rows); free(labels); free(absorbed); free(centroids); return -1;
+            }
+        }
+        for (size_t i = 0; i < m; i++) {labels[i] = find_min_idx(kernel, rows[i], k, dim, centroids);}
+        for (size_t i = 0; i < m; i++) {
+            size_t c = labels[i];
+            double eta = 1.0 / ++absorbed[c]; // per-centroid learning rate
+            for (size_t d = 0; d < dim; d++) {centroids[c][d] += eta * (rows[i][d] - centroids[c][d]);}
+        }
+        n += m;
+        m = 0;
+    }
+    n += m; // a first batch too small to seed
+    free(rows); free(labels); free(absorbed);
+    if (n <= 1) {free(centroids); return -1;}
+    if (k >= n) {free(centroids); return 0;}
+
+    //step 3: optional exact passes over a seekable input.
+    if (opts->passes > 0 && start == -1) {fprintf(stderr, "kmeans: stdin is not seekable, --passes skipped\n");}
+    for (int p = 0; p < opts->passes && start != -1; p++) {
+        int changed = 0;
+        if (stream_lloyd_pass(start, n, k, dim, &centroids[0][0], &changed) != 1) {free(centroids); return -1;}
+        if (!changed) break;
+    }
+
+    *dim_out = dim;
+    *n_out = n;
+    *centroids_out = &centroids[0][0];
+    return 1;
+}
+
+/**
+ * @brief One exact Lloyd pass for kmeans_stream: rewind stdin, stream every row into per-centroid sums, replace the
+ * centroids by the means (an empty cluster keeps its centroid). Uses O(k·dim) memory.
+ * @param start Offset of the first row in stdin.
+ * @param n Number of rows expected (the file must not have changed since the mini-batch pass).
+ * @param k Number of clusters.
+ * @param dim Dimension.
+ * @param centroids In/out: k×dim centroids.
+ * @param changed Out: 1 if any centroid changed.
+ * @return 1 on success, -1 on seek/read error, invalid row, or a different row count.
+ */
+static int stream_lloyd_pass(off_t start, size_t n, size_t k, size_t dim, double *centroids, int *changed) {
+    double (*cents)[dim] = (double (*)[dim])centroids;
+    double (*sums)[dim] = mat_alloc(k, dim, sizeof(double), 1);
+    size_t *counts = mat_alloc(k, 1, sizeof(size_t), 1);
+    if (!sums || !counts || fseeko(stdin, start, SEEK_SET) != 0) {free(sums); free(counts); return -1;}
+    clearerr(stdin);
+    MinIdxKernel kernel = min_idx_kernel(k, dim);
+
+    size_t rows = 0, d = dim;
+    double *point;
+    int status;
+    while ((status = read_and_check_row(&d, &point)) == 1) {
+        size_t c = find_min_idx(kernel, point, k, dim, cents);
+        counts[c]++;
+        for (size_t j = 0; j < dim; j++) {sums[c][j] += point[j];}
+        free(point);
+        rows++;
+    }
+    if (status == -1 || rows != n) {free(sums); free(counts); return -1;}
+
+    *changed = 0;
+    for (size_t c = 0; c < k; c++) {
+        if (counts[c] == 0) {continue;}
+        for (size_t j = 0; j < dim; j++) {
+            double mean = sums[c][j] / counts[c];
+            if (mean != cents[c][j]) {*changed = 1;}
+            cents[c][j] = mean;
+        }
+    }
+    free(sums); free(counts);
+    return 1;
+}
+
+/**
+ * @brief Look up an assignment engine by name.
+ * @param name "lloyd", "hamerly", "elkan", "gemm" or "kdtree".
+ * @return The engine, or NULL if the name is unknown.
+ */
+KmeansEngine kmeans_engine(const char *name) {
+    for (size_t i = 0; i < sizeof ENGINES / sizeof ENGINES[0]; i++) {
+        if (strcmp(ENGINES[i].name, name) == 0) {return ENGINES[i].run;}
+    }
+    return NULL;
+}
+
+/**
+ * @brief Lloyd engine: assign every point to its nearest centroid, recompute the means, stop when no label moves.
+ * @param n Number of points.
+ * @param k Number of clusters.
+ * @param iterations Max iterations.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param centroids In: seeds; out: final k×dim centroids.
+ * @return 1 on success, -1 on allocation failure.
+ */
+static int kmeans_lloyd(size_t n, size_t k, int iterations, size_t dim, const double (*points)[dim], double (*centroids)[dim]) {
+
+    //step 1: label is the number of point and it says witch cluster it belongs to and counts is number of points in each cluster and sum is to sum later of
+    size_t *labels = calloc(n, sizeof(*labels));
+    size_t *counts = calloc(k, sizeof(*counts));
+    double (*sums)[dim] = mat_alloc(k, dim, sizeof(double), 1);
+    if (!labels || !counts || !sums) {free(labels); free(counts); free(sums); return -1;}
+    MinIdxKernel kernel = min_idx_kernel(k, dim);
+
     for (int it = 0; it < iterations; it++) {
-        memset(counts, 0, (size_t)k * sizeof *counts);
-        memset(sums,   0, (size_t)k * sizeof *sums); // zero k×dim
         int moved = 0;
-        
-        for (int i = 0; i < n; i++) { // assign points to clusters
-            int min_idx = find_min_idx(points[i], k, dim, centroids);
+
+        for (size_t i = 0; i < n; i++) { // assign points to clusters
+            size_t min_idx = find_min_idx(kernel, points[i], k, dim, centroids);
             if (labels[i] != min_idx) {moved = 1;}
             labels[i] = min_idx; // sort point to cluster
-            counts[min_idx]++;
-            for (int j = 0; j < dim; j++) {
-                sums[min_idx][j] += points[i][j];
+        }
+        update_centroids(n, k, dim, points, labels, counts, sums, centroids, NULL);
+        if(!moved) break;
+    }
+    free(sums); free(counts); free(labels);
+    return 1;
+}
+
+/**
+ * @brief Lloyd on several threads. The points are cut into fixed chunks (the chunk size depends only on n), every
+ * chunk gets its own cache-line padded block of sums, counts and moved flag, and each thread fills the blocks of a
+ * contiguous run of chunks. The blocks are then merged by a pairwise tree in chunk order, so the centroids are the
+ * same for every thread count (but may differ from the serial Lloyd in the last bits, which sums in point order).
+ * @param n Number of points.
+ * @param k Number of clusters.
+ * @param iterations Max iterations.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param centroids In: seeds; out: final k×dim centroids.
+ * @param threads Number of threads (>= 1); the calling thread runs the first share.
+ * @return 1 on success, -1 on allocation failure.
+ */
+static int kmeans_lloyd_threads(size_t n, size_t k, int iterations, size_t dim, const double (*points)[dim], double (*centroids)[dim], int threads) {
+
+    //step 1: chunking (from n only), padded partial blocks and labels.
+    size_t chunk = chunk_points(n), nchunks = (n + chunk - 1) / chunk;
+    if (k > (SIZE_MAX - 8) / (dim + 1)) {return -1;}
+    size_t stride = (k * dim + k + 1 + 7) / 8 * 8; // sums, counts, moved; 8 doubles = 64-byte line
+
+    size_t *labels = calloc(n, sizeof(*labels));
+    double *partial = mat_alloc(nchunks, stride, sizeof(double), 0);
+    if (!labels || !partial) {free(labels); free(partial); return -1;}
+    LloydCtx ctx = {n, k, dim, &points[0][0], &centroids[0][0], labels, partial, stride, chunk, min_idx_kernel(k, dim)};
+
+    for (int it = 0; it < iterations; it++) {
+        //step 2: every thread assigns its chunks.
+        parallel_chunks(threads, nchunks, lloyd_chunk, &ctx);
+
+        //step 3: pairwise tree over the chunk blocks (fixed shape for a given n), result in block 0.
+        for (size_t step = 1; step < nchunks; step *= 2) {
+            for (size_t c = 0; c + step < nchunks; c += 2 * step) {
+                double *dst = partial + c * stride;
+                const double *src = partial + (c + step) * stride;
+                for (size_t j = 0; j < k * dim + k + 1; j++) {dst[j] += src[j];}
             }
         }
-            for (int i = 0; i < k; i++) {
-                if (counts[i] == 0) {continue;}
-                for (int j = 0; j < dim; j++) {centroids[i][j] = sums[i][j] / counts[i];}
+
+        //step 4: new means (empty clusters keep their centroid); stop when no label moved.
+        const double *sums = partial, *counts = partial + k * dim;
+        for (size_t c = 0; c < k; c++) {
+            if (counts[c] == 0.0) {continue;}
+            for (size_t j = 0; j < dim; j++) {centroids[c][j] = sums[c * dim + j] / counts[c];}
+        }
+        if (counts[k] == 0.0) break;
+    }
+    free(labels); free(partial);
+    return 1;
+}
+
+/**
+ * @brief Chunk body of kmeans_lloyd_threads: assign the chunk's points and fill the chunk's block.
+ * @param ctx LloydCtx*.
+ * @param c Chunk index.
+ */
+static void lloyd_chunk(void *ctx, size_t c) {
+    const LloydCtx *task = ctx;
+    size_t k = task->k, dim = task->dim;
+    const double (*points)[dim] = (const double (*)[dim])task->points;
+    double (*centroids)[dim] = (double (*)[dim])task->centroids;
+
+    double *sums = task->partial + c * task->stride, *counts = sums + k * dim;
+    size_t end = (c + 1) * task->chunk < task->n ? (c + 1) * task->chunk : task->n;
+    memset(sums, 0, (k * dim + k + 1) * sizeof(double));
+    for (size_t i = c * task->chunk; i < end; i++) {
+        size_t min_idx = find_min_idx(task->kernel, points[i], k, dim, centroids);
+        if (task->labels[i] != min_idx) {counts[k] = 1.0;} // moved flag, summed by the tree
+        task->labels[i] = min_idx;
+        counts[min_idx] += 1.0;
+        for (size_t j = 0; j < dim; j++) {sums[min_idx * dim + j] += points[i][j];}
+    }
+}
+
+/**
+ * @brief Seed the k centroids as opts->init asks: the first k points (default), k-means++, or k-means||.
+ * @param n Number of points.
+ * @param k Number of clusters.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param opts Options (init, seed, threads); NULL means the first k points.
+ * @param centroids Out: k×dim seeds.
+ * @return 1 on success, -1 on allocation failure.
+ */
+static int seed_centroids(size_t n, size_t k, size_t dim, const double (*points)[dim], const KmeansOptions *opts, double (*centroids)[dim]) {
+    const char *init = opts && opts->init ? opts->init : "first";
+    if (strcmp(init, "kmeans++") == 0) {return kmeanspp_pick(n, k, dim, points, NULL, opts->seed, centroids);}
+    if (strcmp(init, "kmeans||") == 0) {return kmeans_par_seed(n, k, dim, points, opts->seed, opts->threads > 0 ? opts->threads : 1, centroids);}
+
+    for (size_t c = 0; c < k; ++c) {
+        for (size_t d = 0; d < dim; ++d)
+            centroids[c][d] = points[c][d];
+    }
+    return 1;
+}
+
+/**
+ * @brief (Weighted) k-means++: the first centre is drawn with probability proportional to the weight, each next one
+ * proportional to weight × squared distance to the nearest centre drawn so far.
+ * @param m Number of points.
+ * @param k Number of centres to draw (k <= m).
+ * @param dim Dimension.
+ * @param pts Input m×dim points.
+ * @param weights m weights, or NULL for all 1.
+ * @param seed RNG seed.
+ * @param centroids Out: k×dim centres.
+ * @return 1 on success, -1 on allocation failure.
+ */
+static int kmeanspp_pick(size_t m, size_t k, size_t dim, const double (*pts)[dim], const double *weights, uint64_t seed, double (*centroids)[dim]) {
+    double *d2 = mat_alloc(m, 1, sizeof(double), 0);
+    if (!d2) {return -1;}
+    for (size_t i = 0; i < m; i++) {d2[i] = 1.0;} // first draw: by weight alone
+
+    for (size_t c = 0; c < k; c++) {
+        //step 1: draw index pick with probability weight*d2 / total (all zero: every point is a centre already, take any).
+        double total = 0.0;
+        for (size_t i = 0; i < m; i++) {total += (weights ? weights[i] : 1.0) * d2[i];}
+        size_t pick = (size_t)(rng_unit(seed, 1, c) * (double)m) % m;
+        if (total > 0.0) {
+            double target = rng_unit(seed, 1, c) * total, run = 0.0;
+            for (size_t i = 0; i < m; i++) {
+                double p = (weights ? weights[i] : 1.0) * d2[i];
+                if (p <= 0.0) {continue;}
+                pick = i; // last positive point, in case rounding leaves target past the end
+                run += p;
+                if (run > target) {break;}
             }
-            if(!moved) break;
         }
-    *centroids_out = centroids; // hand off to caller
-    free(sums); free(counts); free(labels);
+        for (size_t d = 0; d < dim; d++) {centroids[c][d] = pts[pick][d];}
+
+        //step 2: distances to the nearest centre so far.
+        for (size_t i = 0; i < m; i++) {
+            double dist = sq_dist(pts[i], centroids[c], dim);
+            if (c == 0 || dist < d2[i]) {d2[i] = dist;}
+        }
+    }
+    free(d2);
     return 1;
 }
 
 /**
- * @brief Index of closest centroid to a point (squared Euclidean).
- * @param point Point of length dim.
- * @param k Number of centroids.
+ * @brief k-means|| (Bahmani et al.): start from one uniform point, then for KPAR_ROUNDS rounds keep every point
+ * independently with probability KPAR_OVERSAMPLE·k·d²(x)/phi, where phi is the total cost. The ~2k·rounds candidates
+ * are weighted by how many points they are nearest to and reduced to k by weighted k-means++ and weighted Lloyd.
+ * The passes over the points run on `threads` threads by chunk; each point's draw comes from rng_unit(seed, round, i)
+ * and phi is merged by tree_sum, so the seeds do not depend on the thread count.
+ * @param n Number of points.
+ * @param k Number of centres.
  * @param dim Dimension.
- * @param centroids k×dim centroid matrix.
- * @return Index in [0, k-1].
+ * @param points Input n×dim points.
+ * @param seed RNG seed.
+ * @param threads Threads for the passes over the points (>= 1).
+ * @param centroids Out: k×dim seeds.
+ * @return 1 on success, -1 on allocation failure.
  */
-static int find_min_idx(const double *point, int k, int dim, double (*centroids)[dim])
-{
-    int min_idx = 0;
-    double best = 0.0;
+static int kmeans_par_seed(size_t n, size_t k, size_t dim, const double (*points)[dim], uint64_t seed, int threads, double (*centroids)[dim]) {
+
+    //step 1: per-point state, per-chunk cost, and the candidate list (grown as needed).
+    size_t chunk = chunk_points(n), nchunks = (n + chunk - 1) / chunk;
+    size_t cap = k * (size_t)(KPAR_OVERSAMPLE * KPAR_ROUNDS) + 1, m = 0;
+    double *d2 = mat_alloc(n, 1, sizeof(double), 0);
+    size_t *closest = mat_alloc(n, 1, sizeof(size_t), 0);
+    unsigned char *sampled = calloc(n, 1);
+    double *phi_part = mat_alloc(nchunks, 1, sizeof(double), 0);
+    size_t *cand = mat_alloc(cap, 1, sizeof(size_t), 0);
+    if (!d2 || !closest || !sampled || !phi_part || !cand) {free(d2); free(closest); free(sampled); free(phi_part); free(cand); return -1;}
+    for (size_t i = 0; i < n; i++) {d2[i] = HUGE_VAL; closest[i] = 0;}
 
-    // distance to first centroid
-    for (int d = 0; d < dim; ++d) {
-        double t = point[d] - centroids[0][d];
-        best += t * t;
+    KparCtx ctx = {n, dim, &points[0][0], cand, 0, 1, d2, closest, phi_part, sampled, seed, 0, KPAR_OVERSAMPLE * (double)k, 0.0, chunk};
+    cand[m++] = (size_t)(rng_unit(seed, 2, 0) * (double)n) % n;
+    parallel_chunks(threads, nchunks, kpar_update_chunk, &ctx);
+    ctx.phi = tree_sum(phi_part, nchunks);
+
+    //step 2: sampling rounds; the new candidates are appended in point order.
+    for (int r = 1; r <= KPAR_ROUNDS && ctx.phi > 0.0; r++) {
+        ctx.round = 2 + (uint64_t)r;
+        parallel_chunks(threads, nchunks, kpar_sample_chunk, &ctx);
+        size_t before = m;
+        for (size_t i = 0; i < n; i++) {
+            if (!sampled[i]) {continue;}
+            if (m == cap) {
+                size_t *tmp = cap <= SIZE_MAX / 2 / sizeof(size_t) ? realloc(cand, 2 * cap * sizeof(size_t)) : NULL;
+                if (!tmp) {free(d2); free(closest); free(sampled); free(phi_part); free(cand); return -1;}
+                cand = tmp;
+                cap *= 2;
+            }
+            cand[m++] = i;
+        }
+        ctx.cand = cand;
+        ctx.new_lo = before;
+        ctx.new_hi = m;
+        if (m == before) {continue;}
+        parallel_chunks(threads, nchunks, kpar_update_chunk, &ctx);
+        ctx.phi = tree_sum(phi_part, nchunks);
     }
 
-    // check the rest
-    for (int c = 1; c < k; ++c) {
-        double dist = 0.0;
-        for (int d = 0; d < dim; ++d) {
-            double t = point[d] - centroids[c][d];
-            dist += t * t;
+    //step 3: weight each candidate by the points nearest to it, then reduce to k.
+    double *weights = mat_alloc(m, 1, sizeof(double), 1);
+    double (*cpts)[dim] = mat_alloc(m, dim, sizeof(double), 0);
+    int status = weights && cpts ? 1 : -1;
+    if (status == 1) {
+        for (size_t i = 0; i < n; i++) {weights[closest[i]] += 1.0;}
+        for (size_t c = 0; c < m; c++) {memcpy(cpts[c], points[cand[c]], dim * sizeof(double));}
+        if (m <= k) { // too few distinct candidates (e.g. many duplicate points): pad with the first points
+            for (size_t c = 0; c < k; c++) {memcpy(centroids[c], c < m ? cpts[c] : points[c - m], dim * sizeof(double));}
         }
-        if (dist < best) {
-            best = dist;
-            min_idx = c;
+        else {
+            status = kmeanspp_pick(m, k, dim, (const double (*)[dim])cpts, weights, seed, centroids);
+            if (status == 1) {status = weighted_lloyd(m, k, dim, (const double (*)[dim])cpts, weights, centroids);}
         }
     }
-    return min_idx;
+    free(d2); free(closest); free(sampled); free(phi_part); free(cand); free(weights); free(cpts);
+    return status;
 }
 
 /**
- * @brief Print k centroids (space-separated per row).
- * @param k Number of centroids.
- * @param dim Dimension per centroid.
- * @param centroids Centroid matrix.
+ * @brief Chunk body of kmeans_par_seed: fold the candidates [new_lo, new_hi) into d2/closest and sum the chunk's cost.
+ * @param ctx KparCtx*.
+ * @param c Chunk index.
  */
-static void print_centroids(int k, int dim, double centroids[k][dim]) {
-    for (int c = 0; c < k; ++c) {
-        for (int d = 0; d < dim; ++d) {
-            printf("%.4f%c", centroids[c][d], d == dim - 1 ? '\n' : ' ');
+static void kpar_update_chunk(void *ctx, size_t c) {
+    const KparCtx *task = ctx;
+    size_t dim = task->dim;
+    const double (*points)[dim] = (const double (*)[dim])task->points;
+    size_t end = (c + 1) * task->chunk < task->n ? (c + 1) * task->chunk : task->n;
+    double phi = 0.0;
+
+    for (size_t i = c * task->chunk; i < end; i++) {
+        for (size_t j = task->new_lo; j < task->new_hi; j++) {
+            double dist = sq_dist(points[i], points[task->cand[j]], dim);
+            if (dist < task->d2[i]) {task->d2[i] = dist; task->closest[i] = j;}
+        }
+        phi += task->d2[i];
+    }
+    task->phi_part[c] = phi;
+}
+
+/**
+ * @brief Chunk body of kmeans_par_seed: keep point i with probability min(1, oversample·d2[i]/phi).
+ * @param ctx KparCtx*.
+ * @param c Chunk index.
+ */
+static void kpar_sample_chunk(void *ctx, size_t c) {
+    const KparCtx *task = ctx;
+    size_t end = (c + 1) * task->chunk < task->n ? (c + 1) * task->chunk : task->n;
+    for (size_t i = c * task->chunk; i < end; i++) {
+        task->sampled[i] = task->d2[i] > 0.0 && rng_unit(task->seed, task->round, i) * task->phi < task->oversample * task->d2[i];
+    }
+}
+
+/**
+ * @brief Weighted Lloyd on a small point set (the k-means|| candidates), until no label moves or RECLUSTER_ITERS.
+ * @param m Number of points.
+ * @param k Number of clusters.
+ * @param dim Dimension.
+ * @param pts Input m×dim points.
+ * @param weights m weights.
+ * @param centroids In: seeds; out: weighted means.
+ * @return 1 on success, -1 on allocation failure.
+ */
+static int weighted_lloyd(size_t m, size_t k, size_t dim, const double (*pts)[dim], const double *weights, double (*centroids)[dim]) {
+    size_t *labels = mat_alloc(m, 1, sizeof(size_t), 1);
+    double *mass = mat_alloc(k, 1, sizeof(double), 0);
+    double (*sums)[dim] = mat_alloc(k, dim, sizeof(double), 0);
+    if (!labels || !mass || !sums) {free(labels); free(mass); free(sums); return -1;}
+    MinIdxKernel kernel = min_idx_kernel(k, dim);
+
+    for (int it = 0; it < RECLUSTER_ITERS; it++) {
+        int moved = 0;
+        memset(mass, 0, k * sizeof *mass);
+        memset(sums, 0, k * sizeof *sums);
+        for (size_t i = 0; i < m; i++) {
+            size_t min_idx = find_min_idx(kernel, pts[i], k, dim, centroids);
+            if (labels[i] != min_idx) {moved = 1;}
+            labels[i] = min_idx;
+            mass[min_idx] += weights[i];
+            for (size_t d = 0; d < dim; d++) {sums[min_idx][d] += weights[i] * pts[i][d];}
         }
+        for (size_t c = 0; c < k; c++) {
+            if (mass[c] == 0.0) {continue;}
+            for (size_t d = 0; d < dim; d++) {centroids[c][d] = sums[c][d] / mass[c];}
+        }
+        if (!moved && it > 0) break;
+    }
+    free(labels); free(mass); free(sums);
+    return 1;
+}
+
+/**
+ * @brief Run `run(ctx, c)` for every chunk c on up to `threads` threads, each taking a contiguous run of chunks.
+ * The calling thread takes the first run; a run whose thread cannot be started (or if the bookkeeping cannot be
+ * allocated) is run on the calling thread, which changes nothing since chunks are independent.
+ * @param threads Number of threads (>= 1).
+ * @param nchunks Number of chunks.
+ * @param run Work of one chunk.
+ * @param ctx Context passed to run.
+ */
+static void parallel_chunks(int threads, size_t nchunks, void (*run)(void *ctx, size_t chunk), void *ctx) {
+    if ((size_t)threads > nchunks) {threads = (int)nchunks;}
+    ChunkShare *shares = threads > 1 ? calloc((size_t)threads, sizeof(*shares)) : NULL;
+    pthread_t *ids = threads > 1 ? calloc((size_t)threads, sizeof(*ids)) : NULL;
+    int *started = threads > 1 ? calloc((size_t)threads, sizeof(*started)) : NULL;
+    if (!shares || !ids || !started) { // serial
+        for (size_t c = 0; c < nchunks; c++) {run(ctx, c);}
+        free(shares); free(ids); free(started);
+        return;
+    }
+
+    for (int t = 0; t < threads; t++) {
+        shares[t] = (ChunkShare){run, ctx, nchunks * (size_t)t / (size_t)threads, nchunks * (size_t)(t + 1) / (size_t)threads};
+    }
+    for (int t = 1; t < threads; t++) {started[t] = pthread_create(&ids[t], NULL, chunk_share, &shares[t]) == 0;}
+    chunk_share(&shares[0]);
+    for (int t = 1; t < threads; t++) {
+        if (started[t]) {pthread_join(ids[t], NULL);}
+        else {chunk_share(&shares[t]);}
     }
+    free(shares); free(ids); free(started);
+}
+
+/**
+ * @brief Thread body of parallel_chunks.
+ * @param arg ChunkShare*.
+ * @return NULL.
+ */
+static void *chunk_share(void *arg) {
+    const ChunkShare *share = arg;
+    for (size_t c = share->lo; c < share->hi; c++) {share->run(share->ctx, c);}
+    return NULL;
+}
+
+/**
+ * @brief Points per chunk of the threaded passes: CHUNK_POINTS, grown so there are at most MAX_CHUNKS chunks.
+ * Depends only on n, which keeps chunked sums independent of the thread count.
+ * @param n Number of points.
+ * @return Chunk size (>= 1).
+ */
+static size_t chunk_points(size_t n) {
+    size_t chunk = (n + MAX_CHUNKS - 1) / MAX_CHUNKS;
+    return chunk < CHUNK_POINTS ? CHUNK_POINTS : chunk;
+}
+
+/**
+ * @brief Sum v[0..m) by a pairwise tree in index order (in place), so the result depends only on m and the values.
+ * @param v Values (overwritten).
+ * @param m Count.
+ * @return The sum (0 for m == 0).
+ */
+static double tree_sum(double *v, size_t m) {
+    if (m == 0) {return 0.0;}
+    for (size_t step = 1; step < m; step *= 2) {
+        for (size_t c = 0; c + step < m; c += 2 * step) {v[c] += v[c + step];}
+    }
+    return v[0];
+}
+
+/**
+ * @brief Counter-based uniform draw in [0, 1): a splitmix64 hash of (seed, stream, i). Any draw can be made by any
+ * thread in any order and still come out the same.
+ * @param seed Seed.
+ * @param stream Which sequence (k-means++ draws, k-means|| rounds).
+ * @param i Index within the sequence.
+ * @return Uniform double in [0, 1) with 53 random bits.
+ */
+static double rng_unit(uint64_t seed, uint64_t stream, uint64_t i) {
+    uint64_t x = seed ^ (stream * 0x9E3779B97F4A7C15u) ^ (i * 0xD1B54A32D192ED03u);
+    for (int r = 0; r < 2; r++) { // splitmix64 finalizer, twice
+        x += 0x9E3779B97F4A7C15u;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9u;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBu;
+        x ^= x >> 31;
+    }
+    return (double)(x >> 11) / 9007199254740992.0; // 2^53
+}
+
+/**
+ * @brief Hamerly engine: per point an upper bound u on the distance to its centroid and a lower bound l on the
+ * distance to every other one. The point keeps its label without any distance when u < max(l, s(a)), where s(a)
+ * is half the distance from its centroid a to the nearest other centroid; otherwise u is tightened and, if needed,
+ * the point is rescanned like Lloyd. Bounds follow the centroid drift between iterations.
+ * @param n Number of points.
+ * @param k Number of clusters.
+ * @param iterations Max iterations.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param centroids In: seeds; out: final k×dim centroids (identical to kmeans_lloyd).
+ * @return 1 on success, -1 on allocation failure.
+ */
+static int kmeans_hamerly(size_t n, size_t k, int iterations, size_t dim, const double (*points)[dim], double (*centroids)[dim]) {
+
+    //step 1: labels/counts/sums as in Lloyd, plus the bounds and per-centroid drift and half-gap.
+    size_t *labels = calloc(n, sizeof(*labels));
+    size_t *counts = calloc(k, sizeof(*counts));
+    double (*sums)[dim] = mat_alloc(k, dim, sizeof(double), 1);
+    double *upper = mat_alloc(n, 1, sizeof(double), 0);
+    double *lower = mat_alloc(n, 1, sizeof(double), 0);
+    double *drift = mat_alloc(k, 1, sizeof(double), 0);
+    double *half_gap = mat_alloc(k, 1, sizeof(double), 0);
+    if (!labels || !counts || !sums || !upper || !lower || !drift || !half_gap) {
+        free(labels); free(counts); free(sums); free(upper); free(lower); free(drift); free(half_gap); return -1;
+    }
+
+    for (int it = 0; it < iterations; it++) {
+        int moved = 0;
+
+        //step 2: half distance from each centroid to its nearest other centroid.
+        for (size_t c = 0; c < k; c++) {half_gap[c] = HUGE_VAL;}
+        for (size_t c = 0; c < k; c++) {
+            for (size_t c2 = c + 1; c2 < k; c2++) {
+                double h = 0.5 * sqrt(sq_dist(centroids[c], centroids[c2], dim)) * (1.0 - BOUND_SLACK);
+                if (h < half_gap[c]) {half_gap[c] = h;}
+                if (h < half_gap[c2]) {half_gap[c2] = h;}
+            }
+        }
+
+        //step 3: assign, skipping points whose bounds prove the label cannot change.
+        for (size_t i = 0; i < n; i++) {
+            size_t a = labels[i];
+            if (it > 0) {
+                double bound = lower[i] > half_gap[a] ? lower[i] : half_gap[a];
+                if (upper[i] < bound) {continue;}
+                upper[i] = sqrt(sq_dist(points[i], centroids[a], dim)) * (1.0 + BOUND_SLACK); // tighten
+                if (upper[i] < bound) {continue;}
+            }
+            double best, second;
+            size_t min_idx = nearest_two(points[i], k, dim, centroids, &best, &second);
+            if (min_idx != a) {moved = 1;}
+            labels[i] = min_idx;
+            upper[i] = sqrt(best) * (1.0 + BOUND_SLACK);
+            lower[i] = sqrt(second) * (1.0 - BOUND_SLACK);
+        }
+
+        //step 4: new means, then move the bounds by how far the centroids went.
+        update_centroids(n, k, dim, points, labels, counts, sums, centroids, drift);
+        if(!moved) break;
+
+        size_t far = 0; // the centroid that moved most, and the largest move among the others
+        for (size_t c = 1; c < k; c++) {if (drift[c] > drift[far]) {far = c;}}
+        double far_other = 0.0;
+        for (size_t c = 0; c < k; c++) {if (c != far && drift[c] > far_other) {far_other = drift[c];}}
+        for (size_t i = 0; i < n; i++) {
+            double fall = labels[i] == far ? far_other : drift[far];
+            upper[i] = (upper[i] + drift[labels[i]]) * (1.0 + BOUND_SLACK);
+            lower[i] = lower[i] - fall - BOUND_SLACK * (lower[i] + fall);
+        }
+    }
+    free(labels); free(counts); free(sums); free(upper); free(lower); free(drift); free(half_gap);
+    return 1;
+}
+
+/**
+ * @brief Elkan engine: like Hamerly but with a lower bound per point and centroid, and the full centroid-centroid
+ * distance table, so a rescan only computes the distances to centroids c with u >= l(c) and u >= d(a, c) / 2.
+ * Costs n×k doubles of bounds, which is why "auto" only picks it for k >= ELKAN_MIN_K and dim >= ELKAN_MIN_DIM.
+ * @param n Number of points.
+ * @param k Number of clusters.
+ * @param iterations Max iterations.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param centroids In: seeds; out: final k×dim centroids (identical to kmeans_lloyd).
+ * @return 1 on success, -1 on allocation failure.
+ */
+static int kmeans_elkan(size_t n, size_t k, int iterations, size_t dim, const double (*points)[dim], double (*centroids)[dim]) {
+
+    //step 1: labels/counts/sums as in Lloyd, plus the bounds, drift, and the half centroid-centroid distances.
+    size_t *labels = calloc(n, sizeof(*labels));
+    size_t *counts = calloc(k, sizeof(*counts));
+    double (*sums)[dim] = mat_alloc(k, dim, sizeof(double), 1);
+    double *upper = mat_alloc(n, 1, sizeof(double), 0);
+    double (*lower)[k] = mat_alloc(n, k, sizeof(double), 0);
+    double *drift = mat_alloc(k, 1, sizeof(double), 0);
+    double *half_gap = mat_alloc(k, 1, sizeof(double), 0);
+    double (*half_dist)[k] = mat_alloc(k, k, sizeof(double), 0);
+    if (!labels || !counts || !sums || !upper || !lower || !drift || !half_gap || !half_dist) {
+        free(labels); free(counts); free(sums); free(upper); free(lower); free(drift); free(half_gap); free(half_dist); return -1;
+    }
+
+    for (int it = 0; it < iterations; it++) {
+        int moved = 0;
+
+        //step 2: half distances between centroids, and to the nearest other one.
+        for (size_t c = 0; c < k; c++) {half_gap[c] = HUGE_VAL; half_dist[c][c] = 0.0;}
+        for (size_t c = 0; c < k; c++) {
+            for (size_t c2 = c + 1; c2 < k; c2++) {
+                double h = 0.5 * sqrt(sq_dist(centroids[c], centroids[c2], dim)) * (1.0 - BOUND_SLACK);
+                half_dist[c][c2] = half_dist[c2][c] = h;
+                if (h < half_gap[c]) {half_gap[c] = h;}
+                if (h < half_gap[c2]) {half_gap[c2] = h;}
+            }
+        }
+
+        //step 3: assign. The first pass computes everything; later passes visit only centroids the bounds cannot rule out,
+        //in index order, and take c over a on a tie only when c < a, which is find_min_idx's tie rule.
+        for (size_t i = 0; i < n; i++) {
+            size_t a = labels[i];
+            if (it == 0) {
+                double best = HUGE_VAL;
+                for (size_t c = 0; c < k; c++) {
+                    double dist = sq_dist(points[i], centroids[c], dim);
+                    lower[i][c] = sqrt(dist) * (1.0 - BOUND_SLACK);
+                    if (dist < best) {best = dist; a = c;}
+                }
+                upper[i] = sqrt(best) * (1.0 + BOUND_SLACK);
+            }
+            else {
+                if (upper[i] < half_gap[a]) {continue;}
+                double best = 0.0;
+                int tight = 0;
+                for (size_t c = 0; c < k; c++) {
+                    if (c == a || upper[i] < lower[i][c] || upper[i] < half_dist[a][c]) {continue;}
+                    if (!tight) { // tighten u once, then re-check this centroid
+                        best = sq_dist(points[i], centroids[a], dim);
+                        upper[i] = sqrt(best) * (1.0 + BOUND_SLACK);
+                        lower[i][a] = sqrt(best) * (1.0 - BOUND_SLACK);
+                        tight = 1;
+                        if (upper[i] < lower[i][c] || upper[i] < half_dist[a][c]) {continue;}
+                    }
+                    double dist = sq_dist(points[i], centroids[c], dim);
+                    lower[i][c] = sqrt(dist) * (1.0 - BOUND_SLACK);
+                    if (dist < best || (dist == best && c < a)) {
+                        a = c;
+                        best = dist;
+                        upper[i] = sqrt(dist) * (1.0 + BOUND_SLACK);
+                    }
+                }
+            }
+            if (labels[i] != a) {moved = 1;}
+            labels[i] = a;
+        }
+
+        //step 4: new means, then move the bounds by how far the centroids went.
+        update_centroids(n, k, dim, points, labels, counts, sums, centroids, drift);
+        if(!moved) break;
+
+        for (size_t i = 0; i < n; i++) {
+            upper[i] = (upper[i] + drift[labels[i]]) * (1.0 + BOUND_SLACK);
+            for (size_t c = 0; c < k; c++) {lower[i][c] = lower[i][c] - drift[c] - BOUND_SLACK * (lower[i][c] + drift[c]);}
+        }
+    }
+    free(labels); free(counts); free(sums); free(upper); free(lower); free(drift); free(half_gap); free(half_dist);
+    return 1;
+}
+
+/**
+ * @brief GEMM engine: Lloyd with the assignment done by gemm_assign (tiles of points against all centroids at once)
+ * instead of one find_min_idx per point. Labels, and therefore centroids, are identical to kmeans_lloyd.
+ * @param n Number of points.
+ * @param k Number of clusters.
+ * @param iterations Max iterations.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param centroids In: seeds; out: final k×dim centroids (identical to kmeans_lloyd).
+ * @return 1 on success, -1 on allocation failure.
+ */
+static int kmeans_gemm(size_t n, size_t k, int iterations, size_t dim, const double (*points)[dim], double (*centroids)[dim]) {
+
+    //step 1: labels/counts/sums as in Lloyd, plus the point norms (fixed, only used for the tie bound).
+    size_t *labels = calloc(n, sizeof(*labels));
+    size_t *counts = calloc(k, sizeof(*counts));
+    size_t *prev = mat_alloc(n, 1, sizeof(size_t), 0);
+    double (*sums)[dim] = mat_alloc(k, dim, sizeof(double), 1);
+    double *point_norms = mat_alloc(n, 1, sizeof(double), 0);
+    if (!labels || !counts || !prev || !sums || !point_norms) {free(labels); free(counts); free(prev); free(sums); free(point_norms); return -1;}
+    for (size_t i = 0; i < n; i++) {
+        double norm = 0.0;
+        for (size_t d = 0; d < dim; d++) {norm += points[i][d] * points[i][d];}
+        point_norms[i] = sqrt(norm);
+    }
+    MinIdxKernel kernel = min_idx_kernel(k, dim);
+
+    for (int it = 0; it < iterations; it++) {
+        memcpy(prev, labels, n * sizeof(*labels));
+        if (gemm_assign(n, k, dim, points, point_norms, centroids, kernel, labels) != 1) {
+            free(labels); free(counts); free(prev); free(sums); free(point_norms); return -1;
+        }
+        int moved = memcmp(prev, labels, n * sizeof(*labels)) != 0;
+        update_centroids(n, k, dim, points, labels, counts, sums, centroids, NULL);
+        if(!moved) break;
+    }
+    free(labels); free(counts); free(prev); free(sums); free(point_norms);
+    return 1;
+}
+
+/**
+ * @brief Blocked assignment: argmin over c of ||c||² - 2 x·c (the squared distance minus the constant ||x||²).
+ * Centroids are stored transposed (dim×k, k padded with +inf norms to a multiple of GEMM_TILE_CENTROIDS) so the inner
+ * loop runs over consecutive centroids and vectorizes; each tile of GEMM_TILE_POINTS points accumulates its
+ * point·centroid products for a whole centroid tile over dim, and the best and second-best values are tracked while the
+ * tile is scanned. The expansion rounds differently from sq_dist, so when best and second best are closer than the
+ * rounding bound GEMM_TIE_SLACK·(dim+3)·eps·(||x||+max||c||)², the point is recomputed with find_min_idx. Labels are
+ * thus exactly find_min_idx's, including its lowest-index rule on exact ties.
+ * @param n Number of points.
+ * @param k Number of centroids.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param point_norms n Euclidean norms of the points.
+ * @param centroids k×dim centroids.
+ * @param kernel find_min_idx kernel of the run (min_idx_kernel(k, dim)), for the near ties.
+ * @param labels Out: n labels.
+ * @return 1 on success, -1 on allocation failure.
+ */
+static int gemm_assign(size_t n, size_t k, size_t dim, const double (*points)[dim], const double *point_norms, double (*centroids)[dim], MinIdxKernel kernel, size_t *labels) {
+    const size_t tp = GEMM_TILE_POINTS, tc = GEMM_TILE_CENTROIDS;
+    size_t kp = (k + tc - 1) / tc * tc;
+
+    //step 1: transposed centroids and their squared norms (+inf in the padding so it never wins).
+    double *ct = mat_alloc(dim, kp, sizeof(double), 1);
+    double *cnorm = mat_alloc(kp, 1, sizeof(double), 0);
+    if (!ct || !cnorm) {free(ct); free(cnorm); return -1;}
+    double cmax = 0.0;
+    for (size_t c = 0; c < kp; c++) {
+        if (c >= k) {cnorm[c] = HUGE_VAL; continue;}
+        double norm = 0.0;
+        for (size_t d = 0; d < dim; d++) {
+            ct[d * kp + c] = centroids[c][d];
+            norm += centroids[c][d] * centroids[c][d];
+        }
+        cnorm[c] = norm;
+        if (sqrt(norm) > cmax) {cmax = sqrt(norm);}
+    }
+
+    //step 2: tiles of points × tiles of centroids, argmin fused into the scan of each accumulator tile.
+    double acc[tp][tc], best[tp], second[tp];
+    size_t arg[tp];
+    for (size_t i0 = 0; i0 < n; i0 += tp) {
+        size_t ip = n - i0 < tp ? n - i0 : tp;
+        for (size_t p = 0; p < ip; p++) {best[p] = second[p] = HUGE_VAL; arg[p] = 0;}
+
+        for (size_t c0 = 0; c0 < kp; c0 += tc) {
+            for (size_t p = 0; p < ip; p++) {
+                for (size_t c = 0; c < tc; c++) {acc[p][c] = cnorm[c0 + c];}
+            }
+            for (size_t d = 0; d < dim; d++) {
+                const double *row = ct + d * kp + c0;
+                for (size_t p = 0; p < ip; p++) {
+                    double x = -2.0 * points[i0 + p][d];
+                    for (size_t c = 0; c < tc; c++) {acc[p][c] += x * row[c];}
+                }
+            }
+            for (size_t p = 0; p < ip; p++) {
+                for (size_t c = 0; c < tc; c++) {
+                    double v = acc[p][c];
+                    if (v < best[p]) {second[p] = best[p]; best[p] = v; arg[p] = c0 + c;}
+                    else if (v < second[p]) {second[p] = v;}
+                }
+            }
+        }
+
+        //step 3: take the argmin unless the runner-up is within rounding of it.
+        for (size_t p = 0; p < ip; p++) {
+            double scale = point_norms[i0 + p] + cmax;
+            double tol = GEMM_TIE_SLACK * (double)(dim + 3) * DBL_EPSILON * scale * scale;
+            labels[i0 + p] = second[p] - best[p] > tol ? arg[p] : find_min_idx(kernel, points[i0 + p], k, dim, centroids);
+        }
+    }
+    free(ct); free(cnorm);
+    return 1;
+}
+
+/**
+ * @brief kd-tree filtering engine (Kanungo et al., "An efficient k-means clustering algorithm"): a kd-tree with per-cell
+ * bounding boxes is built once; every iteration pushes the candidate centroids down the tree, dropping at each cell
+ * those that are farther than the candidate nearest the cell's midpoint from every point of the cell. A cell left with
+ * one candidate is labeled whole, without computing a distance for its points. The labels of each iteration equal
+ * find_min_idx's for the same centroids, and update_centroids recomputes the means from them, so the centroids equal
+ * kmeans_lloyd's bit for bit. Pays off in low dimension (roughly dim <= 8).
+ * @param n Number of points.
+ * @param k Number of clusters.
+ * @param iterations Max iterations.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param centroids In: seeds; out: final k×dim centroids.
+ * @return 1 on success, -1 on allocation failure.
+ */
+static int kmeans_kdtree(size_t n, size_t k, int iterations, size_t dim, const double (*points)[dim], double (*centroids)[dim]) {
+
+    //step 1: the tree, labels/counts/sums as in Lloyd, and one candidate list per tree level.
+    KdTree tree;
+    if (kd_build(n, dim, points, &tree) != 1) {return -1;}
+    size_t *labels = calloc(n, sizeof(*labels));
+    size_t *counts = calloc(k, sizeof(*counts));
+    double (*sums)[dim] = mat_alloc(k, dim, sizeof(double), 1);
+    size_t *cand = mat_alloc(tree.depth + 2, k, sizeof(size_t), 0); // a leaf at depth D still fills row D + 1
+    if (!labels || !counts || !sums || !cand) {free(labels); free(counts); free(sums); free(cand); kd_free(&tree); return -1;}
+
+    for (int it = 0; it < iterations; it++) {
+        int moved = 0;
+
+        //step 2: filter all centroids down from the root.
+        for (size_t c = 0; c < k; c++) {cand[c] = c;}
+        kd_filter(&tree, 0, cand, k, k, dim, points, centroids, labels, &moved);
+
+        //step 3: new means in point order, as the other engines (empty clusters keep their centroid).
+        update_centroids(n, k, dim, points, labels, counts, sums, centroids, NULL);
+        if(!moved) break;
+    }
+    free(labels); free(counts); free(sums); free(cand); kd_free(&tree);
+    return 1;
+}
+
+/**
+ * @brief Build the kd-tree: cells split at the median of their widest side until at most KD_LEAF_POINTS points remain.
+ * @param n Number of points.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param tree Out: the tree; release with kd_free.
+ * @return 1 on success, -1 on allocation failure.
+ */
+static int kd_build(size_t n, size_t dim, const double (*points)[dim], KdTree *tree) {
+    size_t cap = 2 * (n / (KD_LEAF_POINTS / 2) + 1); // median splits leave every leaf at least half full
+    *tree = (KdTree){dim, 0, 0, NULL, NULL, NULL, NULL};
+    tree->node = mat_alloc(cap, 1, sizeof(KdNode), 0);
+    tree->lo = mat_alloc(cap, dim, sizeof(double), 0);
+    tree->hi = mat_alloc(cap, dim, sizeof(double), 0);
+    tree->perm = mat_alloc(n, 1, sizeof(size_t), 0);
+    if (!tree->node || !tree->lo || !tree->hi || !tree->perm) {kd_free(tree); return -1;}
+    for (size_t i = 0; i < n; i++) {tree->perm[i] = i;}
+    kd_build_node(tree, dim, points, 0, n, 0);
+    return 1;
+}
+
+/**
+ * @brief Build the cell of perm[begin..end) and, unless it is a leaf, its two halves.
+ * @param tree Tree being built.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param begin First index into perm.
+ * @param end One past the last index into perm.
+ * @param depth Depth of this cell.
+ * @return Index of the new node.
+ */
+static size_t kd_build_node(KdTree *tree, size_t dim, const double (*points)[dim], size_t begin, size_t end, size_t depth) {
+    size_t id = tree->nodes++;
+    double *lo = tree->lo + id * dim, *hi = tree->hi + id * dim;
+    tree->node[id] = (KdNode){begin, end, 0, 0};
+    if (depth > tree->depth) {tree->depth = depth;}
+
+    //step 1: tight bounding box.
+    for (size_t d = 0; d < dim; d++) {lo[d] = hi[d] = points[tree->perm[begin]][d];}
+    for (size_t i = begin; i < end; i++) {
+        const double *p = points[tree->perm[i]];
+        for (size_t d = 0; d < dim; d++) {
+            if (p[d] < lo[d]) {lo[d] = p[d];}
+            if (p[d] > hi[d]) {hi[d] = p[d];}
+        }
+    }
+
+    //step 2: split at the median of the widest side (a cell of identical points stays a leaf).
+    size_t axis = 0;
+    for (size_t d = 1; d < dim; d++) {if (hi[d] - lo[d] > hi[axis] - lo[axis]) {axis = d;}}
+    if (end - begin <= KD_LEAF_POINTS || hi[axis] == lo[axis]) {return id;}
+    size_t mid = begin + (end - begin) / 2;
+    kd_select(tree->perm, dim, points, axis, begin, end, mid);
+    size_t left = kd_build_node(tree, dim, points, begin, mid, depth + 1);
+    size_t right = kd_build_node(tree, dim, points, mid, end, depth + 1);
+    tree->node[id].left = left;
+    tree->node[id].right = right;
+    return id;
+}
+
+/**
+ * @brief Quickselect: reorder perm[begin..end) so that perm[nth] has the nth smallest coordinate `axis`, with smaller or
+ * equal ones before it and greater or equal ones after.
+ * @param perm Point indices.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param axis Coordinate to order by.
+ * @param begin First index.
+ * @param end One past the last index.
+ * @param nth Position to fix (begin <= nth < end).
+ */
+static void kd_select(size_t *perm, size_t dim, const double (*points)[dim], size_t axis, size_t begin, size_t end, size_t nth) {
+    while (end - begin > 1) {
+        double pivot = points[perm[begin + (end - begin) / 2]][axis];
+        size_t i = begin, j = end - 1;
+        while (i <= j) { // Hoare partition
+            while (points[perm[i]][axis] < pivot) {i++;}
+            while (points[perm[j]][axis] > pivot) {j--;}
+            if (i <= j) {
+                size_t t = perm[i]; perm[i] = perm[j]; perm[j] = t;
+                i++;
+                if (j == 0) {break;}
+                j--;
+            }
+        }
+        if (nth <= j) {end = j + 1;}
+        else if (nth >= i) {begin = i;}
+        else {return;}
+    }
+}
+
+/**
+ * @brief Filter the candidates `cand` (ascending centroid indices) through cell `id`. The candidate z* nearest the cell
+ * midpoint stays; another z is dropped when even the box corner v most favourable to it (the one furthest along z-z*)
+ * is strictly closer to z*, since then every point of the cell is. The test keeps a BOUND_SLACK margin and never drops
+ * on an exact tie, so the lowest-index winner of find_min_idx always survives. One candidate left: the whole cell
+ * is labeled with it; at a leaf, each point takes its nearest candidate.
+ * @param tree Tree.
+ * @param id Cell.
+ * @param cand Candidates for this cell; cand + k is free scratch for the next level.
+ * @param ncand Number of candidates (>= 1).
+ * @param k Number of centroids (row length of the candidate lists).
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param centroids k×dim centroids.
+ * @param labels In/out: n labels.
+ * @param moved Out: set to 1 if a label changes.
+ */
+static void kd_filter(const KdTree *tree, size_t id, size_t *cand, size_t ncand, size_t k, size_t dim, const double (*points)[dim], double (*centroids)[dim], size_t *labels, int *moved) {
+    const KdNode *node = &tree->node[id];
+    const double *lo = tree->lo + id * dim, *hi = tree->hi + id * dim;
+
+    //step 1: leaf -> nearest candidate per point (same sums and tie rule as find_min_idx).
+    if (node->left == 0 && ncand > 1) {
+        for (size_t i = node->begin; i < node->end; i++) {
+            size_t p = tree->perm[i], min_idx = cand[0];
+            double best = sq_dist(points[p], centroids[cand[0]], dim);
+            for (size_t j = 1; j < ncand; j++) {
+                double dist = sq_dist(points[p], centroids[cand[j]], dim);
+                if (dist < best) {best = dist; min_idx = cand[j];}
+            }
+            if (labels[p] != min_idx) {*moved = 1;}
+            labels[p] = min_idx;
+        }
+        return;
+    }
+
+    //step 2: z* = candidate nearest the midpoint; keep the others unless the far corner test drops them.
+    size_t star = cand[0], *next = cand + k, nnext = 0;
+    if (ncand > 1) {
+        double best = HUGE_VAL;
+        for (size_t j = 0; j < ncand; j++) {
+            double dist = 0.0;
+            for (size_t d = 0; d < dim; d++) {
+                double t = 0.5 * (lo[d] + hi[d]) - centroids[cand[j]][d];
+                dist += t * t;
+            }
+            if (dist < best) {best = dist; star = cand[j];}
+        }
+        for (size_t j = 0; j < ncand; j++) {
+            size_t z = cand[j];
+            if (z != star) {
+                double dz = 0.0, ds = 0.0;
+                for (size_t d = 0; d < dim; d++) {
+                    double v = centroids[z][d] > centroids[star][d] ? hi[d] : lo[d];
+                    dz += (v - centroids[z][d]) * (v - centroids[z][d]);
+                    ds += (v - centroids[star][d]) * (v - centroids[star][d]);
+                }
+                if (dz - ds > BOUND_SLACK * (dz + ds)) {continue;} // farther than z* from the whole cell
+            }
+            next[nnext++] = z;
+        }
+    }
+    else {next[nnext++] = star;}
+
+    //step 3: one candidate -> label the whole cell; otherwise recurse.
+    if (nnext == 1) {
+        size_t c = next[0];
+        for (size_t i = node->begin; i < node->end; i++) {
+            if (labels[tree->perm[i]] != c) {*moved = 1;}
+            labels[tree->perm[i]] = c;
+        }
+        return;
+    }
+    kd_filter(tree, node->left, next, nnext, k, dim, points, centroids, labels, moved);
+    kd_filter(tree, node->right, next, nnext, k, dim, points, centroids, labels, moved);
+}
+
+/**
+ * @brief Free the arrays of a kd-tree (the struct itself is the caller's).
+ * @param tree Tree (fields may be NULL).
+ */
+static void kd_free(KdTree *tree) {
+    free(tree->node); free(tree->lo); free(tree->hi); free(tree->perm);
+    *tree = (KdTree){0};
+}
+
+/**
+ * @brief Recompute every centroid as the mean of its points (summed in point order, so all engines agree bit for bit).
+ * A centroid with no points keeps its position.
+ * @param n Number of points.
+ * @param k Number of clusters.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param labels Cluster of each point.
+ * @param counts Scratch k counts.
+ * @param sums Scratch k×dim sums.
+ * @param centroids In/out: k×dim centroids.
+ * @param drift Out (may be NULL): distance each centroid moved.
+ */
+static void update_centroids(size_t n, size_t k, size_t dim, const double (*points)[dim], const size_t *labels, size_t *counts, double (*sums)[dim], double (*centroids)[dim], double *drift) {
+    memset(counts, 0, k * sizeof *counts);
+    memset(sums,   0, k * sizeof *sums); // zero k×dim
+    for (size_t i = 0; i < n; i++) {
+        counts[labels[i]]++;
+        for (size_t j = 0; j < dim; j++) {
+            sums[labels[i]][j] += points[i][j];
+        }
+    }
+    for (size_t i = 0; i < k; i++) {
+        double moved = 0.0;
+        if (counts[i] != 0) {
+            for (size_t j = 0; j < dim; j++) {
+                double c = sums[i][j] / counts[i];
+                moved += (c - centroids[i][j]) * (c - centroids[i][j]);
+                centroids[i][j] = c;
+            }
+        }
+        if (drift) {drift[i] = sqrt(moved) * (1.0 + BOUND_SLACK);}
+    }
+}
+
+/**
+ * @brief Nearest and second-nearest centroid distances of a point (squared), with find_min_idx's tie rule.
+ * @param point Point of length dim.
+ * @param k Number of centroids.
+ * @param dim Dimension.
+ * @param centroids k×dim centroid matrix.
+ * @param best_out Out: squared distance to the nearest centroid.
+ * @param second_out Out: squared distance to the second nearest (HUGE_VAL when k == 1).
+ * @return Index of the nearest centroid (same as find_min_idx).
+ */
+static size_t nearest_two(const double *point, size_t k, size_t dim, double (*centroids)[dim], double *best_out, double *second_out) {
+    size_t min_idx = 0;
+    double best = HUGE_VAL, second = HUGE_VAL;
+    for (size_t c = 0; c < k; ++c) {
+        double dist = sq_dist(point, centroids[c], dim);
+        if (dist < best) {second = best; best = dist; min_idx = c;}
+        else if (dist < second) {second = dist;}
+    }
+    *best_out = best;
+    *second_out = second;
+    return min_idx;
+}
+
+/**
+ * @brief Squared Euclidean distance (the one sum every engine uses, so their comparisons agree exactly).
+ * @param a Point of length dim.
+ * @param b Point of length dim.
+ * @param dim Dimension.
+ * @return sum of (a[d]-b[d])^2.
+ */
+static double sq_dist(const double *a, const double *b, size_t dim) {
+    double dist = 0.0;
+    for (size_t d = 0; d < dim; ++d) {
+        double t = a[d] - b[d];
+        dist += t * t;
+    }
+    return dist;
+}
+
+/**
+ * @brief Index of closest centroid to a point (squared Euclidean), with the kernel min_idx_kernel picked for the run.
+ * @param kernel min_idx_kernel(k, dim).
+ * @param point Point of length dim.
+ * @param k Number of centroids.
+ * @param dim Dimension.
+ * @param centroids k×dim centroid matrix.
+ * @return Index in [0, k-1].
+ */
+static size_t find_min_idx(MinIdxKernel kernel, const double *point, size_t k, size_t dim, double (*centroids)[dim])
+{
+    return kernel(point, k, dim, &centroids[0][0]);
+}
+
+/**
+ * @brief Pick the find_min_idx kernel once per run: the unrolled variant for the dimensions in MIN_IDX_KERNELS
+ * (2, 3, 4, 5, 8), else the ISA kernel when k exceeds its lanes, else find_min_idx_generic. All return the same index.
+ * @param k Number of centroids.
+ * @param dim Dimension.
+ * @return The kernel.
+ */
+static MinIdxKernel min_idx_kernel(size_t k, size_t dim) {
+    if (dim < sizeof MIN_IDX_KERNELS / sizeof MIN_IDX_KERNELS[0] && MIN_IDX_KERNELS[dim]) {return MIN_IDX_KERNELS[dim];}
+    if (isa->find_min_idx && k > isa->lanes) {return isa->find_min_idx;}  // other dimensions: several centroids per vector
+    return find_min_idx_generic;
+}
+
+/**
+ * @brief Scalar find_min_idx kernel: the lowest index among the nearest centroids.
+ * @param point Point of length dim.
+ * @param k Number of centroids.
+ * @param dim Dimension.
+ * @param centroids Flat k×dim centroids.
+ * @return Index in [0, k-1].
+ */
+static size_t find_min_idx_generic(const double *point, size_t k, size_t dim, const double *centroids)
+{
+    size_t min_idx = 0;
+    double best = sq_dist(point, centroids, dim); // distance to first centroid
+
+    // check the rest
+    for (size_t c = 1; c < k; ++c) {
+        double dist = sq_dist(point, centroids + c * dim, dim);
+        if (dist < best) {
+            best = dist;
+            min_idx = c;
+        }
+    }
+    return min_idx;
+}
+
+/**
+ * @brief Select the kernel set once at startup: the widest level the CPU supports (CPUID via __builtin_cpu_supports),
+ * or the level named by the KMEANS_ISA environment variable ("avx512", "avx2", "generic") if the CPU has it. Logs the
+ * choice to stderr. Until it runs, the scalar kernels are used.
+ * @return Name of the selected set.
+ */
+const char *kmeans_isa_select(void) {
+    const char *want = getenv("KMEANS_ISA");
+    size_t s = 0, from = 0;
+    if (want && *want == '\0') {want = NULL;}
+    for (; want && s < ISA_KERNEL_COUNT; s++) {
+        if (strcmp(want, ISA_KERNELS[s].name) == 0) {from = s; break;}
+    }
+    for (s = from; s < ISA_KERNEL_COUNT - 1 && !isa_supported(ISA_KERNELS[s].name); s++) {}
+    isa = &ISA_KERNELS[s];
+    fprintf(stderr, "kmeans: %s kernels", isa->name);
+    if (want && strcmp(want, isa->name) != 0) {fprintf(stderr, " (KMEANS_ISA=%s not available)", want);}
+    fprintf(stderr, "\n");
+    return isa->name;
+}
+
+/**
+ * @brief Whether this CPU (and OS) can run a kernel set.
+ * @param name Set name.
+ * @return Non-zero if supported.
+ */
+static int isa_supported(const char *name) {
+#ifdef KMEANS_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "avx512") == 0) {return __builtin_cpu_supports("avx512f");}
+    if (strcmp(name, "avx2") == 0) {return __builtin_cpu_supports("avx2");}
+#endif
+    return strcmp(name, "generic") == 0;
+}
+
+#ifdef KMEANS_X86
+/**
+ * @brief find_min_idx with AVX2: the distances to 4 centroids at a time, one per lane (coordinates gathered at stride
+ * dim). Each lane adds its squares in sq_dist's order with no fused multiply-add, and the lanes are compared in index
+ * order with the same strict test, so the label is find_min_idx's.
+ * @param point Point of length dim.
+ * @param k Number of centroids.
+ * @param dim Dimension.
+ * @param centroids Flat k×dim centroids.
+ * @return Index in [0, k-1].
+ */
+__attribute__((target("avx2"), optimize("fp-contract=off")))
+static size_t find_min_idx_avx2(const double *point, size_t k, size_t dim, const double *centroids) {
+    const long long s = (long long)dim;
+    const __m256i stride = _mm256_set_epi64x(3 * s, 2 * s, s, 0);
+    double lane[4], best = sq_dist(point, centroids, dim);
+    size_t min_idx = 0, c = 1;
+    for (; c + 4 <= k; c += 4) {
+        const double *block = centroids + c * dim;
+        __m256d acc = _mm256_setzero_pd();
+        for (size_t d = 0; d < dim; ++d) {
+            __m256d t = _mm256_sub_pd(_mm256_set1_pd(point[d]), _mm256_i64gather_pd(block + d, stride, 8));
+            acc = _mm256_add_pd(acc, _mm256_mul_pd(t, t));
+        }
+        _mm256_storeu_pd(lane, acc);
+        for (size_t q = 0; q < 4; ++q) {
+            if (lane[q] < best) {best = lane[q]; min_idx = c + q;}
+        }
+    }
+    for (; c < k; ++c) {
+        double dist = sq_dist(point, centroids + c * dim, dim);
+        if (dist < best) {best = dist; min_idx = c;}
+    }
+    return min_idx;
+}
+
+/**
+ * @brief find_min_idx with AVX-512: as find_min_idx_avx2 with 8 centroids per vector.
+ * @param point Point of length dim.
+ * @param k Number of centroids.
+ * @param dim Dimension.
+ * @param centroids Flat k×dim centroids.
+ * @return Index in [0, k-1].
+ */
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+static size_t find_min_idx_avx512(const double *point, size_t k, size_t dim, const double *centroids) {
+    const long long s = (long long)dim;
+    const __m512i stride = _mm512_set_epi64(7 * s, 6 * s, 5 * s, 4 * s, 3 * s, 2 * s, s, 0);
+    double lane[8], best = sq_dist(point, centroids, dim);
+    size_t min_idx = 0, c = 1;
+    for (; c + 8 <= k; c += 8) {
+        const double *block = centroids + c * dim;
+        __m512d acc = _mm512_setzero_pd();
+        for (size_t d = 0; d < dim; ++d) {
+            __m512d t = _mm512_sub_pd(_mm512_set1_pd(point[d]), _mm512_i64gather_pd(stride, block + d, 8));
+            acc = _mm512_add_pd(acc, _mm512_mul_pd(t, t));
+        }
+        _mm512_storeu_pd(lane, acc);
+        for (size_t q = 0; q < 8; ++q) {
+            if (lane[q] < best) {best = lane[q]; min_idx = c + q;}
+        }
+    }
+    for (; c < k; ++c) {
+        double dist = sq_dist(point, centroids + c * dim, dim);
+        if (dist < best) {best = dist; min_idx = c;}
+    }
+    return min_idx;
+}
+#endif
+
+#ifndef KMEANS_LIBRARY
+/**
+ * @brief Print k centroids (space-separated per row).
+ * @param k Number of centroids.
+ * @param dim Dimension per centroid.
+ * @param centroids Centroid matrix.
+ */
+static void print_centroids(size_t k, size_t dim, double centroids[k][dim]) {
+    for (size_t c = 0; c < k; ++c) {
+        for (size_t d = 0; d < dim; ++d) {
+            printf("%.4f%c", centroids[c][d], d == dim - 1 ? '\n' : ' ');
+        }
+    }
+}
+
+#endif
+
+/**
+ * @brief Allocate a rows×cols array, failing instead of wrapping around when the byte size overflows size_t.
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @param elem_size Size of one entry in bytes.
+ * @param zeroed Non-zero to zero-fill (calloc semantics).
+ * @return Pointer to release with free(), or NULL on overflow or allocation failure.
+ */
+static void *mat_alloc(size_t rows, size_t cols, size_t elem_size, int zeroed) {
+    if (rows == 0 || cols == 0 || elem_size == 0) {return NULL;}
+    if (cols > SIZE_MAX / elem_size || rows > SIZE_MAX / elem_size / cols) {return NULL;} // rows * cols * elem_size would wrap
+    return zeroed ? calloc(rows * cols, elem_size) : malloc(rows * cols * elem_size);
 }
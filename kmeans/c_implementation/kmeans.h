@@ -0,0 +1,95 @@
+#ifndef KMEANS_H
+#define KMEANS_H
+
+#include <stddef.h>
+
+/* Public interface: k-means core routines (kmeans.c), shared by the CLI and the kmeans_c_api extension.
+   The CLI itself (main and its stdin/argv helpers) is compiled out when KMEANS_LIBRARY is defined. */
+
+/**
+ * @brief Run-time options of the k-means driver, parsed from "--name=value" arguments.
+ */
+typedef struct KmeansOptions {
+    const char *engine;  /**< Assignment engine: "lloyd" (default), "hamerly", "elkan", "gemm", "kdtree" or "auto". */
+    const char *init;  /**< Seeding: "first" (default, the first k points), "kmeans++" or "kmeans||". */
+    unsigned long seed;  /**< Seed of the k-means++ / k-means|| draws (same seed, same centroids). */
+    int threads;  /**< 0 (default): serial; T >= 1: Lloyd on T threads with chunked partial sums (same result for every T). */
+    size_t minibatch;  /**< 0 (default): load all points; B > k: stream stdin in batches of B (see kmeans_stream). */
+    int passes;  /**< Streaming only: full Lloyd passes to run after the mini-batch pass when stdin is a seekable file. */
+} KmeansOptions;
+
+/**
+ * @brief Assignment engine: runs the iterations on centroids already seeded by kmeans(), updating them in place.
+ */
+typedef int (*KmeansEngine)(size_t n, size_t k, int iterations, size_t dim, const double (*points)[*], double (*centroids)[*]);
+
+/**
+ * @brief Run k-means on points: seed the centroids (opts->init), then run the chosen assignment engine until no label moves.
+ * @param n Number of points.
+ * @param k Number of clusters.
+ * @param iterations Max iterations.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param opts Options (engine, init, seed, threads); NULL means serial Lloyd from the first k points.
+ * @param centroids_out Receives malloc'ed k×dim centroids; caller must free().
+ * @return 1 on success, -1 on allocation failure, unknown engine, or threads with an engine other than Lloyd.
+ */
+int kmeans(size_t n, size_t k, int iterations, size_t dim, const double (*points)[dim], const KmeansOptions *opts, double (**centroids_out)[dim]);
+
+/**
+ * @brief Lloyd with the stopping rule of kmeans.py's k_means_clusters: stop once no centroid moved more than eps.
+ * @param n Number of points.
+ * @param k Number of clusters.
+ * @param iterations Max iterations (>= 1).
+ * @param eps Convergence threshold on the Euclidean shift of each centroid.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param centroids In: k×dim seeds; out: final centroids.
+ * @param labels Out: n labels of the last assignment step.
+ * @return 1 on success, -1 on allocation failure.
+ */
+int kmeans_fit(size_t n, size_t k, int iterations, double eps, size_t dim, const double (*points)[dim], double (*centroids)[dim], size_t *labels);
+
+/**
+ * @brief Mean silhouette (Euclidean) of a labeling, exact or estimated from a uniform sample of rows.
+ * @param n Number of points.
+ * @param dim Dimension.
+ * @param points Input n×dim points.
+ * @param labels n labels in [0, k).
+ * @param k Number of label values.
+ * @param samples 0 (or >= n): exact, O(n²·dim) time; otherwise rows to sample, O(samples·n·dim) time.
+ * @param seed Seed of the sample.
+ * @param threads 0: serial; T >= 1: T threads (same result for every T).
+ * @param score_out Out: mean silhouette.
+ * @param halfwidth_out Out: 95% confidence half-width of a sampled score (0 when exact).
+ * @return 1 on success, 0 if a label is >= k or fewer than 2 clusters are non-empty, -1 on allocation failure.
+ */
+int silhouette(size_t n, size_t dim, const double (*points)[dim], const size_t *labels, size_t k, size_t samples, unsigned long seed, int threads, double *score_out, double *halfwidth_out);
+
+/**
+ * @brief Streaming mini-batch k-means over stdin (see kmeans.c).
+ * @param k Number of clusters (> 1).
+ * @param opts Options (minibatch > k, init, seed, passes).
+ * @param dim_out Out: point dimension.
+ * @param n_out Out: number of points read.
+ * @param centroids_out Receives malloc'ed k×dim centroids; caller must free().
+ * @return 1 on success, 0 if k >= n, -1 on invalid input, allocation failure or unsupported options.
+ */
+int kmeans_stream(size_t k, const KmeansOptions *opts, size_t *dim_out, size_t *n_out, double **centroids_out);
+
+/**
+ * @brief Look up an assignment engine by name.
+ * @param name "lloyd", "hamerly", "elkan", "gemm" or "kdtree".
+ * @return The engine, or NULL if the name is unknown.
+ */
+KmeansEngine kmeans_engine(const char *name);
+
+/**
+ * @brief Select the widest kernel set (avx512, avx2 or generic) the CPU supports, or the one named by the KMEANS_ISA
+ * environment variable, and log the choice to stderr. Call once at startup, before any threads are started.
+ * @return Name of the selected set.
+ * @note All sets give the same labels and centroids; without a call the scalar kernels are used.
+ */
+const char *kmeans_isa_select(void);
+
+#endif